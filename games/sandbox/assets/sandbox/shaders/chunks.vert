@@ -0,0 +1,38 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+struct ChunkDraw {
+    vec3 center;
+    float radius;
+    uint index_count;
+    uint first_index;
+    int vertex_offset;
+    uint user_index;
+};
+
+layout(set = 0, binding = 2) readonly buffer ChunkBuffer {
+    ChunkDraw chunks[];
+} chunk_buffers[];
+
+layout(set = 1, binding = 0) uniform FrameUniforms {
+    mat4 view_projection;
+    float time;
+} frame;
+
+layout(push_constant) uniform ChunkConstants {
+    uint chunk_buffer_index;
+} constants;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    // Each chunk's user index is its own index, which the indirect draw passes through as its instance.
+    ChunkDraw chunk = chunk_buffers[constants.chunk_buffer_index].chunks[gl_InstanceIndex];
+
+    // A quad inside the chunk's bounding circle, with corners from its indices 0 to 3.
+    vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1) * 2.0 - 1.0;
+    vec3 position = chunk.center + vec3(corner * chunk.radius * 0.7, 0.0);
+
+    gl_Position = frame.view_projection * vec4(position, 1.0);
+    fragColor = 0.5 + 0.5 * cos(6.283 * (vec3(0.0, 0.33, 0.67) + float(gl_InstanceIndex) * 0.001));
+}
@@ -1,5 +1,14 @@
 #version 450
 
+layout(set = 1, binding = 0) uniform FrameUniforms {
+    mat4 view_projection;
+    float time;
+} frame;
+
+layout(set = 1, binding = 1) uniform DrawUniforms {
+    mat4 models[256];
+} draw;
+
 layout(location = 0) out vec3 fragColor;
 
 vec2 positions[3] = vec2[](
@@ -15,6 +24,6 @@ vec3 colors[3] = vec3[](
 );
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
+    gl_Position = frame.view_projection * draw.models[gl_InstanceIndex] * vec4(positions[gl_VertexIndex], 0.0, 1.0);
     fragColor = colors[gl_VertexIndex];
 }
@@ -15,13 +15,19 @@ public:
     
     void process(Engine &engine) override
     {
+        // Changed assets are reloaded by the engine automatically; this forces everything to reload.
         // TODO: Move to a command.
-        if (engine.get_platform_ptr()->reload_pressed())
+        const bool reload_pressed = engine.get_platform_ptr()->reload_pressed();
+        if (reload_pressed && !m_reload_was_pressed)
         {
             MH_TRACE("Reload all assets.");
             engine.get_asset_manager_ptr()->reload_all();
         }
+        m_reload_was_pressed = reload_pressed;
     }
+    
+private:
+    bool m_reload_was_pressed = false;
 };
 
 int main()
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <deque>
 #include <mutex>
 
 #include "mellohi/core/assets/asset_id.hpp"
@@ -12,6 +13,7 @@ namespace mellohi
         Asset(std::shared_ptr<class AssetManager> asset_manager_ptr, const AssetId &asset_id);
         virtual ~Asset();
         
+        // Reloads this asset and rebuilds everything that depends on it.
         void reload();
         
         usize register_reload_callback(const std::function<void()> &callback);
@@ -26,11 +28,27 @@ namespace mellohi
         std::shared_ptr<class AssetManager> m_asset_manager_ptr;
         AssetId m_id;
         
-        std::unordered_map<usize, std::function<void()>> m_reload_callbacks;
+        struct ReloadCallback
+        {
+            usize id;
+            std::function<void()> callback;
+        };
+        
+        // A deque so that callbacks registered during dispatch don't move the one being run. Deregistering during
+        // dispatch only clears the callback; the entry is removed once dispatch finishes.
+        std::deque<ReloadCallback> m_reload_callbacks;
         usize m_next_reload_callback_id = 0;
-        std::mutex m_reload_callback_mutex;
+        bool m_dispatching_reload_callbacks = false;
+        std::recursive_mutex m_reload_callback_mutex;
         
+        // Reads and parses the asset. May run on an AssetManager worker thread.
         virtual void load() = 0;
+        // Creates anything that must be made on the main thread (e.g. GPU objects) from what load() produced.
+        virtual void finalize();
+        
+        void notify_reloaded();
+        
+        friend class AssetManager;
     };
     
     class TextAsset : public Asset
@@ -51,10 +69,12 @@ namespace mellohi
     public:
         BinaryAsset(std::shared_ptr<class AssetManager> asset_manager, const AssetId &asset_id);
         
-        const std::vector<u8> & get_bytes() const;
+        // Points straight into the asset archive when the file is archived. Invalidated by reload().
+        std::span<const u8> get_bytes() const;
         
     private:
         std::vector<u8> m_bytes;
+        std::span<const u8> m_bytes_view;
         
         void load() override;
     };
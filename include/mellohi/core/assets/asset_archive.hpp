@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include "mellohi/core/types.hpp"
+
+namespace mellohi
+{
+    // On-disk layout of a packed asset archive. All values are little-endian.
+    //
+    //   ArchiveHeader
+    //   ArchiveTocEntry[entry_count], sorted by (hash, fully qualified path)
+    //   fully qualified paths, concatenated without terminators
+    //   file contents, each starting on an ARCHIVE_BLOB_ALIGNMENT boundary
+    struct ArchiveHeader
+    {
+        std::array<char, 4> magic;
+        u32 version;
+        u64 entry_count;
+        u64 toc_offset;
+    };
+    
+    struct ArchiveTocEntry
+    {
+        u64 hash;
+        u64 path_offset;
+        u64 path_size;
+        u64 data_offset;
+        u64 data_size;
+    };
+    
+    constexpr std::array<char, 4> ARCHIVE_MAGIC{'M', 'H', 'P', 'K'};
+    constexpr u32 ARCHIVE_VERSION = 1;
+    constexpr u64 ARCHIVE_BLOB_ALIGNMENT = 16;
+    
+    // Read-only view of an archive file, memory mapped in one piece so that lookups return spans straight into it.
+    class AssetArchive
+    {
+    public:
+        explicit AssetArchive(const std::filesystem::path &file_path);
+        ~AssetArchive();
+        
+        AssetArchive(const AssetArchive &) = delete;
+        AssetArchive & operator=(const AssetArchive &) = delete;
+        
+        [[nodiscard]] bool is_open() const;
+        [[nodiscard]] usize get_entry_count() const;
+        
+        [[nodiscard]] std::optional<std::span<const u8>> find(std::string_view fully_qualified_path) const;
+        
+    private:
+        const u8 *m_data_ptr = nullptr;
+        usize m_size = 0;
+        std::span<const ArchiveTocEntry> m_toc;
+        
+        bool validate(const std::filesystem::path &file_path);
+        void unmap();
+    };
+}
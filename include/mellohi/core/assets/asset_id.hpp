@@ -1,12 +1,17 @@
 #pragma once
 
 #include <filesystem>
+#include <optional>
+#include <span>
 #include <string>
 
+#include "mellohi/core/hash.hpp"
 #include "mellohi/core/types.hpp"
 
 namespace mellohi
 {
+    // AssetIds are interned: every distinct id is stored once in a global table, so copying, comparing and hashing
+    // one never touches its strings.
     class AssetId
     {
     public:
@@ -15,6 +20,7 @@ namespace mellohi
         
         bool operator==(const AssetId &other) const;
         bool operator!=(const AssetId &other) const;
+        // Orders by interning order, which is stable for the lifetime of the process but not alphabetical.
         bool operator<(const AssetId &other) const;
         bool operator>(const AssetId &other) const;
         bool operator<=(const AssetId &other) const;
@@ -23,16 +29,40 @@ namespace mellohi
         
         const std::string & get_package() const;
         const std::string & get_path() const;
-        std::string get_fully_qualified_path() const;
+        const std::string & get_fully_qualified_path() const;
+        u32 get_handle() const;
+        u64 get_hash() const;
         
         std::filesystem::path as_file_path() const;
         bool file_exists() const;
         std::string read_file_as_string() const;
         std::vector<u8> read_file_as_bytes() const;
+        // Returns the file's bytes directly from the mounted asset archive, or std::nullopt if it is not archived
+        // or is overridden by a loose file.
+        std::optional<std::span<const u8>> get_archived_bytes() const;
+        
+        // Stable across builds and platforms, so it can be stored in asset archives.
+        static constexpr u64 hash_fully_qualified_path(std::string_view fully_qualified_path);
         
     private:
-        std::string m_package, m_path;
+        struct Entry
+        {
+            std::string package, path, fully_qualified_path;
+            u32 handle;
+            u64 hash;
+        };
+        
+        const Entry *m_entry_ptr;
+        
+        static std::string make_fully_qualified_path(std::string_view package, std::string_view path);
+        // The package is everything before delimiter_pos, and the path everything after it.
+        static const Entry & intern(std::string_view fully_qualified_path, usize delimiter_pos);
     };
+    
+    constexpr u64 AssetId::hash_fully_qualified_path(const std::string_view fully_qualified_path)
+    {
+        return fnv1a_64(fully_qualified_path);
+    }
 }
 
 template<>
@@ -40,6 +70,6 @@ struct std::hash<mellohi::AssetId>
 {
     mellohi::usize operator()(const mellohi::AssetId &asset_id) const noexcept
     {
-        return std::hash<string>{}(asset_id.get_fully_qualified_path());
+        return static_cast<mellohi::usize>(asset_id.get_hash());
     }
 };
@@ -1,40 +1,257 @@
 #pragma once
 
+#include <atomic>
+#include <future>
+
 #include "mellohi/core/assets/asset.hpp"
+#include "mellohi/core/assets/asset_watcher.hpp"
+#include "mellohi/core/assets/virtual_file_system.hpp"
 #include "mellohi/core/logger.hpp"
+#include "mellohi/core/thread_pool.hpp"
 
 namespace mellohi
 {
+    class AssetManager;
+    
+    template<typename T>
+    class AssetFuture
+    {
+    public:
+        // The manager is only needed while the asset may still have to be finalized.
+        explicit AssetFuture(std::shared_future<std::shared_ptr<Asset>> future,
+                             std::shared_ptr<AssetManager> asset_manager_ptr = nullptr);
+        
+        [[nodiscard]] bool is_ready() const;
+        // Blocks until the asset has been finalized. On the main thread, which finalizes assets, this processes the
+        // manager's main thread tasks while waiting.
+        [[nodiscard]] std::shared_ptr<T> get() const;
+    
+    private:
+        std::shared_future<std::shared_ptr<Asset>> m_future;
+        std::shared_ptr<AssetManager> m_asset_manager_ptr;
+    };
+    
     class AssetManager : public std::enable_shared_from_this<AssetManager>
     {
     public:
         AssetManager();
-    
+        
         template<typename T, typename... Args>
         std::shared_ptr<T> load(const AssetId &asset_id, Args&&... args);
+        template<typename T, typename... Args>
+        AssetFuture<T> load_async(const AssetId &asset_id, Args&&... args);
+        // Loads several assets of the same type in parallel on the worker threads, with the calling thread helping.
+        template<typename T, typename... Args>
+        std::vector<std::shared_ptr<T>> load_all(const std::vector<AssetId> &asset_ids, const Args&... args);
+        
+        // Finalizes assets that finished loading on worker threads. Called once per frame on the main thread.
+        void process_main_thread_tasks();
         
+        // Reloads only the loaded assets whose files changed on disk since the last call. Called once per frame.
+        void reload_changed();
         void reload_all();
+        void reload(const AssetId &asset_id);
+        
+        // Records that the dependent asset is built from the given dependencies, replacing what was recorded before.
+        // Reloading a dependency rebuilds the dependent (finalize() and reload callbacks) once per batch, after it.
+        void set_dependencies(const AssetId &dependent_id, const std::vector<AssetId> &dependency_ids);
+        
+        // Runs work on the asset worker threads, e.g. rebuilding GPU objects for a reloaded asset off the main thread.
+        void submit_background_task(std::function<void()> &&task);
+        
+        [[nodiscard]] bool is_main_thread() const;
     
     private:
+        struct PendingLoad
+        {
+            AssetId asset_id;
+            std::function<std::shared_ptr<Asset>()> construct;
+            std::atomic_flag claimed;
+            
+            std::promise<std::shared_ptr<Asset>> constructed_promise;
+            std::shared_future<std::shared_ptr<Asset>> constructed_future = constructed_promise.get_future().share();
+            std::promise<std::shared_ptr<Asset>> loaded_promise;
+            std::shared_future<std::shared_ptr<Asset>> loaded_future = loaded_promise.get_future().share();
+        };
+        
         std::unordered_map<AssetId, std::weak_ptr<Asset>> m_assets;
+        std::unordered_map<AssetId, std::shared_ptr<PendingLoad>> m_pending_loads;
+        std::mutex m_assets_mutex;
+        
+        std::unordered_map<AssetId, std::vector<AssetId>> m_dependencies;
+        std::unordered_map<AssetId, std::vector<AssetId>> m_dependents;
+        std::mutex m_dependencies_mutex;
+        
+        std::thread::id m_main_thread_id;
+        std::deque<std::function<void()>> m_main_thread_tasks;
+        std::mutex m_main_thread_tasks_mutex;
+        
+        AssetWatcher m_asset_watcher;
+        
+        // Declared last so workers are joined before anything they reference is destroyed.
+        ThreadPool m_thread_pool;
+        
+        std::shared_ptr<Asset> find_loaded_asset(const AssetId &asset_id) const;
+        void run_pending_load(const std::shared_ptr<PendingLoad> &pending_load_ptr);
+        std::shared_ptr<Asset> wait_for_pending_load(const std::shared_ptr<PendingLoad> &pending_load_ptr);
+        void push_main_thread_task(std::function<void()> &&task);
+        void reload_assets(const std::vector<std::shared_ptr<Asset>> &assets);
+        std::vector<std::shared_ptr<Asset>> sort_reload_batch(const std::vector<std::shared_ptr<Asset>> &assets);
+        
+        template<typename T>
+        static std::shared_ptr<T> cast_asset(const std::shared_ptr<Asset> &asset_ptr, const AssetId &asset_id);
+        template<typename T, typename... Args>
+        std::shared_ptr<PendingLoad> find_or_create_pending_load(const AssetId &asset_id,
+                                                                 std::shared_ptr<Asset> &loaded_asset_ptr,
+                                                                 bool &created, Args&&... args);
     };
     
+    template<typename T>
+    AssetFuture<T>::AssetFuture(std::shared_future<std::shared_ptr<Asset>> future,
+                                std::shared_ptr<AssetManager> asset_manager_ptr)
+        : m_future(std::move(future)), m_asset_manager_ptr(std::move(asset_manager_ptr))
+    {
+        
+    }
+    
+    template<typename T>
+    bool AssetFuture<T>::is_ready() const
+    {
+        return m_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+    
+    template<typename T>
+    std::shared_ptr<T> AssetFuture<T>::get() const
+    {
+        // Blocking the main thread would keep the asset from ever being finalized.
+        if (m_asset_manager_ptr && m_asset_manager_ptr->is_main_thread())
+        {
+            while (!is_ready())
+            {
+                m_asset_manager_ptr->process_main_thread_tasks();
+                std::this_thread::yield();
+            }
+        }
+        
+        const auto asset = std::dynamic_pointer_cast<T>(m_future.get());
+        MH_ASSERT(asset, "Loaded asset '{}' cannot be cast to requested type.", m_future.get()->get_id());
+        return asset;
+    }
+    
     template<typename T, typename... Args>
     std::shared_ptr<T> AssetManager::load(const AssetId &asset_id, Args&&... args)
     {
-        const auto asset_it = m_assets.find(asset_id);
-        if (asset_it != m_assets.end())
+        // Every load goes through a pending load, which claims the id under the lock before anything is constructed.
+        // That deduplicates loads across the main thread, the workers (e.g. a material loading its shaders) and
+        // asynchronous loads, and assets loaded on workers are finalized on the main thread like asynchronous ones.
+        std::shared_ptr<Asset> loaded_asset_ptr;
+        bool created = false;
+        const auto pending_load_ptr = find_or_create_pending_load<T>(asset_id, loaded_asset_ptr, created,
+                                                                     std::forward<Args>(args)...);
+        if (!pending_load_ptr)
+        {
+            return cast_asset<T>(loaded_asset_ptr, asset_id);
+        }
+        
+        return cast_asset<T>(wait_for_pending_load(pending_load_ptr), asset_id);
+    }
+    
+    template<typename T, typename... Args>
+    AssetFuture<T> AssetManager::load_async(const AssetId &asset_id, Args&&... args)
+    {
+        std::shared_ptr<Asset> loaded_asset_ptr;
+        bool created = false;
+        const auto pending_load_ptr = find_or_create_pending_load<T>(asset_id, loaded_asset_ptr, created,
+                                                                     std::forward<Args>(args)...);
+        if (!pending_load_ptr)
+        {
+            std::promise<std::shared_ptr<Asset>> loaded_promise;
+            loaded_promise.set_value(cast_asset<T>(loaded_asset_ptr, asset_id));
+            return AssetFuture<T>(loaded_promise.get_future().share());
+        }
+        
+        if (created)
         {
-            if (const auto asset_ptr = asset_it->second.lock())
+            m_thread_pool.submit([this, pending_load_ptr] { run_pending_load(pending_load_ptr); });
+        }
+        
+        return AssetFuture<T>(pending_load_ptr->loaded_future, shared_from_this());
+    }
+    
+    template<typename T, typename... Args>
+    std::vector<std::shared_ptr<T>> AssetManager::load_all(const std::vector<AssetId> &asset_ids, const Args&... args)
+    {
+        std::vector<std::shared_ptr<Asset>> loaded_asset_ptrs(asset_ids.size());
+        std::vector<std::shared_ptr<PendingLoad>> pending_load_ptrs(asset_ids.size());
+        
+        for (usize i = 0; i < asset_ids.size(); ++i)
+        {
+            bool created = false;
+            pending_load_ptrs[i] = find_or_create_pending_load<T>(asset_ids[i], loaded_asset_ptrs[i], created, args...);
+            
+            // The first load is left for the calling thread so that it does not sit idle.
+            if (created && i > 0)
             {
-                const auto asset = std::dynamic_pointer_cast<T>(asset_ptr);
-                MH_ASSERT(asset, "Loaded asset '{}' cannot be cast to requested type.", asset_id);
-                return asset;
+                m_thread_pool.submit([this, pending_load_ptr = pending_load_ptrs[i]]
+                {
+                    run_pending_load(pending_load_ptr);
+                });
             }
         }
         
-        const auto asset = std::make_shared<T>(shared_from_this(), asset_id, std::forward<Args>(args)...);
-        m_assets[asset_id] = asset;
+        std::vector<std::shared_ptr<T>> assets;
+        assets.reserve(asset_ids.size());
+        
+        for (usize i = 0; i < asset_ids.size(); ++i)
+        {
+            if (pending_load_ptrs[i])
+            {
+                loaded_asset_ptrs[i] = wait_for_pending_load(pending_load_ptrs[i]);
+            }
+            
+            assets.push_back(cast_asset<T>(loaded_asset_ptrs[i], asset_ids[i]));
+        }
+        
+        return assets;
+    }
+    
+    template<typename T>
+    std::shared_ptr<T> AssetManager::cast_asset(const std::shared_ptr<Asset> &asset_ptr, const AssetId &asset_id)
+    {
+        const auto asset = std::dynamic_pointer_cast<T>(asset_ptr);
+        MH_ASSERT(asset, "Loaded asset '{}' cannot be cast to requested type.", asset_id);
         return asset;
     }
+    
+    // Returns nullptr and sets loaded_asset_ptr if the asset is already loaded.
+    template<typename T, typename... Args>
+    std::shared_ptr<AssetManager::PendingLoad> AssetManager::find_or_create_pending_load(
+        const AssetId &asset_id, std::shared_ptr<Asset> &loaded_asset_ptr, bool &created, Args&&... args)
+    {
+        const std::lock_guard<std::mutex> lock(m_assets_mutex);
+        
+        loaded_asset_ptr = find_loaded_asset(asset_id);
+        if (loaded_asset_ptr)
+        {
+            return nullptr;
+        }
+        
+        const auto pending_load_it = m_pending_loads.find(asset_id);
+        if (pending_load_it != m_pending_loads.end())
+        {
+            return pending_load_it->second;
+        }
+        
+        const auto pending_load_ptr = std::make_shared<PendingLoad>(asset_id);
+        pending_load_ptr->construct = [this, asset_id, ...args = std::forward<Args>(args)]() mutable
+        {
+            return std::static_pointer_cast<Asset>(
+                std::make_shared<T>(shared_from_this(), asset_id, std::move(args)...)
+            );
+        };
+        
+        m_pending_loads.emplace(asset_id, pending_load_ptr);
+        created = true;
+        return pending_load_ptr;
+    }
 }
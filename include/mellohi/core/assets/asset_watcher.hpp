@@ -0,0 +1,43 @@
+#pragma once
+
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "mellohi/core/assets/asset_id.hpp"
+
+namespace mellohi
+{
+    // Watches the asset directories for modified files and keeps the VirtualFileSystem index up to date. Only
+    // implemented with inotify on Linux; elsewhere it never reports changes.
+    class AssetWatcher
+    {
+    public:
+        explicit AssetWatcher(const std::vector<std::filesystem::path> &root_dirs);
+        ~AssetWatcher();
+        
+        AssetWatcher(const AssetWatcher &) = delete;
+        AssetWatcher & operator=(const AssetWatcher &) = delete;
+        
+        // Returns every asset modified since the last poll, each listed once. Returns std::nullopt if events were
+        // dropped, in which case any asset may have changed. Never blocks.
+        [[nodiscard]] std::optional<std::vector<AssetId>> poll_changed_asset_ids();
+        
+    private:
+        struct WatchedDir
+        {
+            std::filesystem::path root_dir;
+            std::filesystem::path dir;
+        };
+        
+        i32 m_inotify_fd = -1;
+        std::unordered_map<i32, WatchedDir> m_watched_dirs;
+        
+        void add_watch_recursive(const std::filesystem::path &root_dir, const std::filesystem::path &dir);
+        void add_watch(const std::filesystem::path &root_dir, const std::filesystem::path &dir);
+        
+        // Updates the index for a file and returns its asset if it still exists.
+        static std::optional<AssetId> refresh_file(const std::filesystem::path &root_dir,
+                                                   const std::filesystem::path &file_path);
+    };
+}
@@ -5,6 +5,15 @@
 
 namespace mellohi
 {
+    enum class LatencyMode
+    {
+        LowLatency,
+        Balanced,
+        Throughput,
+    };
+    
+    std::optional<LatencyMode> latency_mode_from_string(std::string_view str);
+    
     class GameConfigAsset : public TomlAsset
     {
     public:
@@ -18,6 +27,9 @@ namespace mellohi
         std::optional<bool> get_window_resizable_opt() const;
         std::optional<std::string> get_window_title_opt() const;
         std::optional<bool> get_window_vsync_opt() const;
+        
+        std::optional<u32> get_graphics_frames_in_flight_opt() const;
+        std::optional<LatencyMode> get_graphics_latency_mode_opt() const;
     
     private:
         struct
@@ -34,6 +46,12 @@ namespace mellohi
             std::optional<std::string> title_opt;
             std::optional<bool> vsync_opt;
         } m_window{};
+        
+        struct
+        {
+            std::optional<u32> frames_in_flight_opt;
+            std::optional<LatencyMode> latency_mode_opt;
+        } m_graphics{};
     
         void load() override;
     };
@@ -55,6 +73,9 @@ namespace mellohi
         std::string get_window_title() const;
         bool get_window_vsync() const;
         
+        u32 get_graphics_frames_in_flight() const;
+        LatencyMode get_graphics_latency_mode() const;
+        
     private:
         struct
         {
@@ -71,6 +92,12 @@ namespace mellohi
             bool vsync;
         } m_window{};
         
+        struct
+        {
+            u32 frames_in_flight;
+            LatencyMode latency_mode;
+        } m_graphics{};
+        
         std::shared_ptr<GameConfigAsset> m_game_config;
         
         void load() override;
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mellohi/core/assets/asset_archive.hpp"
+#include "mellohi/core/types.hpp"
+
+namespace mellohi
+{
+    // Allows std::string keyed maps to be searched with a std::string_view without allocating.
+    struct TransparentStringHash
+    {
+        using is_transparent = void;
+        
+        usize operator()(const std::string_view string) const noexcept
+        {
+            return std::hash<std::string_view>{}(string);
+        }
+    };
+    
+    // In-memory index from fully qualified asset paths to files on disk, built by scanning the asset directories
+    // once. Files in the game assets directory override files with the same path in the engine assets directory.
+    // When built with MH_ASSET_ARCHIVE_PATH, files missing from both directories are read from that archive.
+    class VirtualFileSystem
+    {
+    public:
+        // Scans the game and engine asset directories on first use.
+        static VirtualFileSystem & get();
+        
+        [[nodiscard]] std::optional<std::filesystem::path> resolve(std::string_view fully_qualified_path) const;
+        [[nodiscard]] std::optional<std::span<const u8>> find_archived(std::string_view fully_qualified_path) const;
+        
+        // Updates the index for a single asset after its file was created, modified or deleted.
+        void refresh(std::string_view fully_qualified_path);
+        // Rebuilds the whole index, for when changes may have been missed.
+        void rescan();
+        
+        [[nodiscard]] const std::vector<std::filesystem::path> & get_root_dirs() const;
+        
+        // Maps a file inside a root directory to its fully qualified asset path. The first directory is the package;
+        // files directly in the root belong to the unnamed package.
+        [[nodiscard]] static std::optional<std::string> to_fully_qualified_path(const std::filesystem::path &root_dir,
+                                                                              const std::filesystem::path &file_path);
+        
+    private:
+        explicit VirtualFileSystem(std::vector<std::filesystem::path> root_dirs);
+        
+        // Ordered from highest to lowest priority.
+        std::vector<std::filesystem::path> m_root_dirs;
+        std::unordered_map<std::string, std::filesystem::path, TransparentStringHash, std::equal_to<>> m_files;
+        mutable std::shared_mutex m_files_mutex;
+        
+        std::unique_ptr<AssetArchive> m_archive_ptr;
+    };
+}
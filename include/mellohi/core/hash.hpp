@@ -0,0 +1,31 @@
+#pragma once
+
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+#include "mellohi/core/types.hpp"
+
+namespace mellohi
+{
+    constexpr u64 FNV1A_64_OFFSET_BASIS = 0xcbf29ce484222325;
+    
+    // FNV-1a. Stable across builds and platforms, so it is safe to persist. Pass a previous result as the seed to hash
+    // several values together.
+    constexpr u64 fnv1a_64(const std::string_view data, u64 hash = FNV1A_64_OFFSET_BASIS)
+    {
+        for (const char c : data)
+        {
+            hash ^= static_cast<u8>(c);
+            hash *= 0x100000001b3;
+        }
+        return hash;
+    }
+    
+    template<typename T>
+    u64 fnv1a_64_value(const T &value, const u64 hash = FNV1A_64_OFFSET_BASIS)
+    {
+        static_assert(std::has_unique_object_representations_v<T>, "Value must not contain padding.");
+        return fnv1a_64(std::string_view(reinterpret_cast<const char *>(&value), sizeof(T)), hash);
+    }
+}
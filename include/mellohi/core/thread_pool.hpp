@@ -0,0 +1,38 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mellohi/core/types.hpp"
+
+namespace mellohi
+{
+    class ThreadPool
+    {
+    public:
+        explicit ThreadPool(usize thread_count = get_default_thread_count());
+        ~ThreadPool();
+        
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool & operator=(const ThreadPool &) = delete;
+        
+        void submit(std::function<void()> &&task);
+        
+        [[nodiscard]] usize get_thread_count() const;
+        
+        // Leaves one hardware thread free for the main thread.
+        [[nodiscard]] static usize get_default_thread_count();
+    
+    private:
+        std::vector<std::jthread> m_threads;
+        std::deque<std::function<void()>> m_tasks;
+        std::mutex m_tasks_mutex;
+        std::condition_variable_any m_tasks_condition;
+        
+        void worker_loop(std::stop_token stop_token);
+    };
+}
@@ -2,6 +2,7 @@
 
 #include "mellohi/graphics/assets/material.hpp"
 #include "mellohi/graphics/vulkan/assets/vulkan_shader.hpp"
+#include "mellohi/graphics/vulkan/graphics_pipeline_cache.hpp"
 #include "mellohi/graphics/vulkan/render_pass.hpp"
 
 namespace mellohi
@@ -10,24 +11,43 @@ namespace mellohi
     {
     public:
         VulkanMaterial(std::shared_ptr<AssetManager> asset_manager_ptr, const AssetId &asset_id,
-                       std::shared_ptr<Device> device_ptr, std::shared_ptr<RenderPass> render_pass_ptr);
+                       std::shared_ptr<Device> device_ptr, std::shared_ptr<RenderPass> render_pass_ptr,
+                       std::shared_ptr<GraphicsPipelineCache> graphics_pipeline_cache_ptr);
         virtual ~VulkanMaterial() override;
         
         void bind();
+        // For command buffers recorded on worker threads, e.g. in RenderPass::record_parallel(). Binds the pipeline
+        // swapped in by the last bind() or update_graphics_pipeline() on the main thread.
+        void bind(vk::CommandBuffer command_buffer) const;
+        // Swaps in a rebuilt pipeline once it is ready; until then the old one keeps being used. bind() does this
+        // itself.
+        void update_graphics_pipeline();
+        
+        [[nodiscard]] const GraphicsPipeline &get_graphics_pipeline() const;
+        // Unique for the lifetime of the process, and small enough to sort draws by.
+        [[nodiscard]] u32 get_material_id() const;
         
     private:
         std::shared_ptr<Device> m_device_ptr;
         std::shared_ptr<RenderPass> m_render_pass_ptr;
+        std::shared_ptr<GraphicsPipelineCache> m_graphics_pipeline_cache_ptr;
         
         std::shared_ptr<VulkanShader> m_vert_shader_ptr;
         std::shared_ptr<VulkanShader> m_frag_shader_ptr;
-        usize m_on_vert_shader_reloaded_id, m_on_frag_shader_reloaded_id;
-        bool m_should_be_recreated;
+        vk::CullModeFlags m_cull_mode = vk::CullModeFlagBits::eBack;
+        BlendMode m_blend_mode = BlendMode::Opaque;
+        bool m_depth_test = false;
+        bool m_depth_write = false;
+        u32 m_material_id;
         
-        vk::Pipeline m_graphics_pipeline;
+        // Shared with every other material built from the same state.
+        std::shared_ptr<GraphicsPipeline> m_graphics_pipeline_ptr;
+        // A pipeline being looked up or built on a worker thread after a reload.
+        std::future<std::shared_ptr<GraphicsPipeline>> m_pending_graphics_pipeline;
         
         void load() override;
+        void finalize() override;
         
-        void on_shader_reloaded();
+        [[nodiscard]] GraphicsPipelineKey get_graphics_pipeline_key() const;
     };
 }
@@ -13,12 +13,17 @@ namespace mellohi
         virtual ~VulkanShader() override;
         
         vk::ShaderModule get_shader_module() const;
+        // Unique for every module created, unlike the handle, which may be reused once the module is destroyed.
+        u64 get_shader_module_id() const;
         
     private:
         std::shared_ptr<Device> m_device_ptr;
         
+        std::vector<u32> m_spirv_code;
         vk::ShaderModule m_shader_module;
+        u64 m_shader_module_id = 0;
         
         void load() override;
+        void finalize() override;
     };
 }
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <deque>
+#include <limits>
+
+#include "mellohi/graphics/vulkan/device.hpp"
+
+namespace mellohi
+{
+    // Bindings of the bindless descriptor set, which shaders declare as
+    //   layout(set = 0, binding = 0) uniform texture2D textures[];
+    //   layout(set = 0, binding = 1) uniform sampler samplers[];
+    //   layout(set = 0, binding = 2) buffer Buffers { ... } buffers[];
+    enum class BindlessResourceType
+    {
+        SampledImage,
+        Sampler,
+        StorageBuffer,
+    };
+    
+    constexpr u32 INVALID_BINDLESS_INDEX = std::numeric_limits<u32>::max();
+    
+    // The index shaders look the resource up by, typically passed to them through push constants.
+    template<BindlessResourceType Type>
+    struct BindlessHandle
+    {
+        u32 index = INVALID_BINDLESS_INDEX;
+        
+        bool operator==(const BindlessHandle &other) const = default;
+        
+        [[nodiscard]] bool is_valid() const
+        {
+            return index != INVALID_BINDLESS_INDEX;
+        }
+    };
+    
+    using BindlessImageHandle = BindlessHandle<BindlessResourceType::SampledImage>;
+    using BindlessSamplerHandle = BindlessHandle<BindlessResourceType::Sampler>;
+    using BindlessBufferHandle = BindlessHandle<BindlessResourceType::StorageBuffer>;
+    
+    // One large, update-after-bind descriptor set holding every texture, sampler and storage buffer, which the render
+    // pass binds as set 0 once per command buffer. Draws switch resources by pushing indices instead of binding
+    // descriptor sets.
+    class BindlessDescriptors
+    {
+    public:
+        // Upper bounds; the device's limits may lower them.
+        static constexpr u32 MAX_SAMPLED_IMAGES = 16384;
+        static constexpr u32 MAX_SAMPLERS = 256;
+        static constexpr u32 MAX_STORAGE_BUFFERS = 16384;
+        
+        explicit BindlessDescriptors(std::shared_ptr<Device> device_ptr);
+        ~BindlessDescriptors();
+        
+        BindlessDescriptors(const BindlessDescriptors &) = delete;
+        BindlessDescriptors & operator=(const BindlessDescriptors &) = delete;
+        
+        // These are safe to call from any thread. A removed handle's index is reused once the GPU has finished the
+        // frame being recorded, so the resource itself must stay alive until then too, e.g. through the deletion queue.
+        [[nodiscard]] BindlessImageHandle add_image(vk::ImageView image_view,
+                                                    vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal);
+        [[nodiscard]] BindlessSamplerHandle add_sampler(vk::Sampler sampler);
+        [[nodiscard]] BindlessBufferHandle add_buffer(const Buffer &buffer, vk::DeviceSize offset = 0,
+                                                      vk::DeviceSize range = VK_WHOLE_SIZE);
+        void remove(BindlessImageHandle handle);
+        void remove(BindlessSamplerHandle handle);
+        void remove(BindlessBufferHandle handle);
+        
+        [[nodiscard]] vk::DescriptorSetLayout get_descriptor_set_layout() const;
+        [[nodiscard]] vk::DescriptorSet get_descriptor_set() const;
+    
+    private:
+        // Hands out the indices of one binding's array.
+        struct IndexAllocator
+        {
+            struct RetiredIndex
+            {
+                u64 frame;
+                u32 index;
+            };
+            
+            u32 capacity = 0;
+            u32 next_index = 0;
+            std::vector<u32> free_indices;
+            // Ordered by frame.
+            std::deque<RetiredIndex> retired_indices;
+        };
+        
+        std::shared_ptr<Device> m_device_ptr;
+        
+        vk::DescriptorSetLayout m_descriptor_set_layout;
+        vk::DescriptorPool m_descriptor_pool;
+        vk::DescriptorSet m_descriptor_set;
+        
+        // Indexed by BindlessResourceType, which is also the binding.
+        std::array<IndexAllocator, 3> m_index_allocators;
+        std::mutex m_mutex;
+        
+        void create_descriptor_set(const std::array<u32, 3> &capacities);
+        
+        [[nodiscard]] u32 allocate_index(BindlessResourceType type);
+        void retire_index(BindlessResourceType type, u32 index);
+        void write_descriptor(BindlessResourceType type, u32 index, const vk::DescriptorImageInfo *image_info_ptr,
+                              const vk::DescriptorBufferInfo *buffer_info_ptr);
+    };
+}
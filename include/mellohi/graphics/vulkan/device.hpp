@@ -1,5 +1,10 @@
 #pragma once
 
+#include <atomic>
+#include <bit>
+#include <mutex>
+
+#include "mellohi/graphics/vulkan/memory_allocator.hpp"
 #include "mellohi/graphics/vulkan/vulkan.hpp"
 #include "mellohi/platform/platform.hpp"
 
@@ -9,6 +14,20 @@ namespace mellohi
     {
         Graphics,
         Present,
+        // Compute-only and transfer-only families are preferred when the GPU has them, so that work on these queues
+        // runs alongside rendering. Otherwise they fall back to the graphics family.
+        Compute,
+        Transfer,
+    };
+    
+    // A buffer or image barrier that moves a resource between the queues of two capabilities.
+    template<typename Barrier>
+    struct QueueOwnershipTransfer
+    {
+        // Recorded on the source queue. When both queues share a family this is the whole barrier.
+        Barrier release;
+        // Recorded on the destination queue, in a submission that waits for the release's.
+        std::optional<Barrier> acquire_opt;
     };
     
     class Device
@@ -17,40 +36,105 @@ namespace mellohi
         Device(const EngineConfigAsset &engine_config, const Platform &platform);
         ~Device();
         
+        [[nodiscard]] bool is_fence_signaled(vk::Fence fence) const;
         void reset_fence(vk::Fence fence) const;
         void wait_for_fence(vk::Fence fence, u64 timeout = std::numeric_limits<u64>::max()) const;
         void wait_idle() const;
         
-        void push_to_deletion_queue(std::function<void()>&& deletor);
+        [[nodiscard]] u64 get_semaphore_counter_value(vk::Semaphore semaphore) const;
+        void wait_for_semaphore(vk::Semaphore semaphore, u64 value,
+                                u64 timeout = std::numeric_limits<u64>::max()) const;
+        
+        // Capabilities may share a queue, so all queue access goes through these.
+        void submit(QueueCapability capability, const vk::SubmitInfo2 &submit_info) const;
+        void submit(QueueCapability capability, std::span<const vk::CommandBuffer> command_buffers,
+                    std::span<const vk::SemaphoreSubmitInfo> wait_semaphore_infos = {},
+                    std::span<const vk::SemaphoreSubmitInfo> signal_semaphore_infos = {}) const;
+        [[nodiscard]] vk::Result present(const vk::PresentInfoKHR &present_info) const;
+        
+        [[nodiscard]] bool shares_queue_family(QueueCapability capability, QueueCapability other_capability) const;
+        // Whether one indirect draw call may draw several commands, each with its own first instance.
+        [[nodiscard]] bool supports_multi_draw_indirect() const;
+        // Whether indirect draw calls may read their draw count from a buffer. Implies multi-draw indirect.
+        [[nodiscard]] bool supports_draw_indirect_count() const;
+        // Whether presents can signal a fence once presentation has finished with the swapchain and the semaphores
+        // it waited on.
+        [[nodiscard]] bool supports_present_fences() const;
+        // Splits the barrier into the release and acquire halves of a queue family ownership transfer. The source
+        // half keeps the barrier's source scope and the destination half its destination scope.
+        template<typename Barrier>
+        [[nodiscard]] QueueOwnershipTransfer<Barrier> make_ownership_transfer(QueueCapability src_capability,
+                                                                              QueueCapability dst_capability,
+                                                                              const Barrier &barrier) const;
+        
+        // Frames are numbered in submission order. The GPU signals the frame timeline semaphore with N + 1 once it has
+        // finished frame N, so the semaphore's value is the number of completed frames.
+        [[nodiscard]] u64 get_frame() const;
+        [[nodiscard]] u64 get_completed_frame_count() const;
+        [[nodiscard]] bool is_frame_complete(u64 frame) const;
+        void wait_for_frame(u64 frame, u64 timeout = std::numeric_limits<u64>::max()) const;
+        // Called once the current frame has been submitted with a signal of the frame timeline semaphore.
+        void advance_frame();
+        [[nodiscard]] vk::Semaphore get_frame_timeline_semaphore() const;
+        
+        // Destroys the handle once the GPU has finished every frame that could still be using it, i.e. the frame
+        // currently being recorded.
+        template<typename Handle>
+        void push_to_deletion_queue(Handle handle);
+        // Also frees the resource's memory.
+        void push_to_deletion_queue(const Buffer &buffer);
+        void push_to_deletion_queue(const Image &image);
+        // Destroys everything retired during frames that have completed.
         void flush_deletion_queue();
         
         [[nodiscard]] std::vector<vk::CommandBuffer> allocate_command_buffers(
             const vk::CommandBufferAllocateInfo &allocate_info) const;
+        [[nodiscard]] std::vector<vk::DescriptorSet> allocate_descriptor_sets(
+            const vk::DescriptorSetAllocateInfo &allocate_info) const;
+        [[nodiscard]] Buffer create_buffer(const vk::BufferCreateInfo &create_info,
+                                           const AllocationCreateInfo &allocation_create_info) const;
         [[nodiscard]] vk::CommandPool create_command_pool(const vk::CommandPoolCreateInfo &create_info) const;
+        [[nodiscard]] vk::Pipeline create_compute_pipeline(const vk::ComputePipelineCreateInfo &create_info) const;
+        [[nodiscard]] vk::DescriptorPool create_descriptor_pool(const vk::DescriptorPoolCreateInfo &create_info) const;
+        [[nodiscard]] vk::DescriptorSetLayout create_descriptor_set_layout(
+            const vk::DescriptorSetLayoutCreateInfo &create_info) const;
         [[nodiscard]] vk::Fence create_fence(const vk::FenceCreateInfo &create_info) const;
-        [[nodiscard]] vk::Framebuffer create_framebuffer(const vk::FramebufferCreateInfo &create_info) const;
         [[nodiscard]] vk::Pipeline create_graphics_pipeline(const vk::GraphicsPipelineCreateInfo &create_info) const;
+        [[nodiscard]] Image create_image(const vk::ImageCreateInfo &create_info,
+                                         const AllocationCreateInfo &allocation_create_info) const;
+        // Binds every image to the same memory, which only one of them may be in use in at a time. The memory is
+        // owned by the first image and freed along with it.
+        [[nodiscard]] std::vector<Image> create_aliased_images(std::span<const vk::ImageCreateInfo> create_infos,
+                                                               const AllocationCreateInfo &allocation_create_info) const;
         [[nodiscard]] vk::ImageView create_image_view(const vk::ImageViewCreateInfo &create_info) const;
         [[nodiscard]] vk::PipelineLayout create_pipeline_layout(const vk::PipelineLayoutCreateInfo &create_info) const;
-        [[nodiscard]] vk::RenderPass create_render_pass(const vk::RenderPassCreateInfo &create_info) const;
         [[nodiscard]] vk::Semaphore create_semaphore(const vk::SemaphoreCreateInfo &create_info) const;
+        [[nodiscard]] vk::Semaphore create_timeline_semaphore(u64 initial_value = 0) const;
         [[nodiscard]] vk::ShaderModule create_shader_module(const vk::ShaderModuleCreateInfo &create_info) const;
         [[nodiscard]] vk::SwapchainKHR create_swapchain(const vk::SwapchainCreateInfoKHR &create_info) const;
         
+        void destroy_buffer(const Buffer &buffer) const;
         void destroy_command_pool(vk::CommandPool command_pool) const;
+        void destroy_descriptor_pool(vk::DescriptorPool descriptor_pool) const;
+        void destroy_descriptor_set_layout(vk::DescriptorSetLayout descriptor_set_layout) const;
         void destroy_fence(vk::Fence fence) const;
-        void destroy_framebuffer(vk::Framebuffer framebuffer) const;
+        void destroy_image(const Image &image) const;
         void destroy_image_view(vk::ImageView image_view) const;
         void destroy_pipeline(vk::Pipeline pipeline) const;
         void destroy_pipeline_layout(vk::PipelineLayout pipeline_layout) const;
-        void destroy_render_pass(vk::RenderPass render_pass) const;
         void destroy_semaphore(vk::Semaphore semaphore) const;
         void destroy_shader_module(vk::ShaderModule shader_module) const;
         void destroy_swapchain(vk::SwapchainKHR swapchain) const;
         
+        void free_command_buffers(vk::CommandPool command_pool, std::span<const vk::CommandBuffer> command_buffers) const;
+        
         [[nodiscard]] vk::Device get_device() const;
+        [[nodiscard]] vk::MemoryRequirements get_image_memory_requirements(const vk::ImageCreateInfo &create_info) const;
         [[nodiscard]] vk::Instance get_instance() const;
+        [[nodiscard]] MemoryAllocator &get_memory_allocator() const;
         [[nodiscard]] vk::PhysicalDevice get_physical_device() const;
+        [[nodiscard]] vk::PhysicalDeviceProperties get_physical_device_properties() const;
+        [[nodiscard]] vk::PhysicalDeviceVulkan12Properties get_physical_device_vulkan_12_properties() const;
         [[nodiscard]] vk::SurfaceFormatKHR get_preferred_surface_format() const;
         [[nodiscard]] vk::Queue get_queue(QueueCapability capability) const;
         [[nodiscard]] u32 get_queue_family_index(QueueCapability capability) const;
@@ -59,7 +143,10 @@ namespace mellohi
         [[nodiscard]] std::vector<vk::SurfaceFormatKHR> get_surface_formats() const;
         [[nodiscard]] std::vector<vk::PresentModeKHR> get_surface_present_modes() const;
         [[nodiscard]] std::vector<vk::Image> get_swapchain_images(vk::SwapchainKHR swapchain) const;
-        [[nodiscard]] std::vector<u32> get_unique_queue_family_indices() const;
+        
+        void reset_command_pool(vk::CommandPool command_pool) const;
+        
+        void update_descriptor_sets(std::span<const vk::WriteDescriptorSet> descriptor_writes) const;
     
     private:
         vk::Instance m_instance;
@@ -68,18 +155,83 @@ namespace mellohi
         vk::PhysicalDevice m_physical_device;
         vk::Device m_device;
         std::unordered_map<QueueCapability, u32> m_queue_family_indices;
-        std::unordered_map<u32, vk::Queue> m_queues;
+        std::unordered_map<QueueCapability, vk::Queue> m_queues;
+        mutable std::unordered_map<VkQueue, std::mutex> m_queue_mutexes;
         vk::SurfaceFormatKHR m_preferred_surface_format;
-        std::deque<std::function<void()>> m_deletion_queue;
+        bool m_memory_budget_supported = false;
+        bool m_multi_draw_indirect_supported = false;
+        bool m_draw_indirect_count_supported = false;
+        bool m_surface_maintenance_supported = false;
+        bool m_present_fences_supported = false;
+        std::unique_ptr<MemoryAllocator> m_memory_allocator_ptr;
+        struct DeletionEntry
+        {
+            u64 frame;
+            vk::ObjectType object_type;
+            u64 handle;
+            // Freed after the handle is destroyed, for buffers and images.
+            Allocation allocation;
+        };
+        
+        // Ordered by frame, since entries are only ever tagged with the current one. Its capacity is kept between
+        // flushes so that retiring a handle does not allocate.
+        std::vector<DeletionEntry> m_deletion_queue;
+        std::mutex m_deletion_queue_mutex;
+        std::atomic<u64> m_frame = 0;
+        vk::Semaphore m_frame_timeline_semaphore;
+        vk::PipelineCache m_pipeline_cache;
         
         void create_instance(const EngineConfigAsset &engine_config, const Platform &platform);
         void create_debug_utils_messenger();
         void choose_physical_device();
         void create_device();
+        void create_memory_allocator();
         void choose_preferred_surface_format();
+        void create_pipeline_cache();
+        void create_frame_timeline_semaphore();
+        void save_pipeline_cache() const;
+        
+        void push_to_deletion_queue(vk::ObjectType object_type, u64 handle, const Allocation &allocation = {});
+        void flush_deletion_queue(u64 completed_frame_count);
+        void destroy_handle(vk::ObjectType object_type, u64 handle) const;
         
         static std::vector<const char *> get_required_instance_extensions(const Platform &platform);
         static std::vector<const char *> get_required_device_extensions();
         static std::vector<const char *> get_required_validation_layers();
     };
+    
+    template<typename Handle>
+    void Device::push_to_deletion_queue(const Handle handle)
+    {
+        if (handle)
+        {
+            push_to_deletion_queue(Handle::objectType, std::bit_cast<u64>(static_cast<typename Handle::CType>(handle)));
+        }
+    }
+    
+    template<typename Barrier>
+    QueueOwnershipTransfer<Barrier> Device::make_ownership_transfer(const QueueCapability src_capability,
+                                                                    const QueueCapability dst_capability,
+                                                                    const Barrier &barrier) const
+    {
+        if (shares_queue_family(src_capability, dst_capability))
+        {
+            auto release = barrier;
+            release.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            release.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            return { .release = release, .acquire_opt = std::nullopt };
+        }
+        
+        auto release = barrier;
+        release.srcQueueFamilyIndex = get_queue_family_index(src_capability);
+        release.dstQueueFamilyIndex = get_queue_family_index(dst_capability);
+        
+        auto acquire = release;
+        release.dstStageMask = vk::PipelineStageFlagBits2::eNone;
+        release.dstAccessMask = vk::AccessFlagBits2::eNone;
+        acquire.srcStageMask = vk::PipelineStageFlagBits2::eNone;
+        acquire.srcAccessMask = vk::AccessFlagBits2::eNone;
+        
+        return { .release = release, .acquire_opt = acquire };
+    }
 };
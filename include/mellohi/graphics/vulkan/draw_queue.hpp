@@ -0,0 +1,98 @@
+#pragma once
+
+#include "mellohi/graphics/vulkan/assets/vulkan_material.hpp"
+
+namespace mellohi
+{
+    struct DrawPacket
+    {
+        // Draws of lower passes are recorded first.
+        u8 pass = 0;
+        // Has to stay alive until the queue has been recorded.
+        VulkanMaterial *material_ptr = nullptr;
+        u32 vertex_count = 0;
+        u32 first_vertex = 0;
+        // View depth normalized to [0, 1]. Draws sharing state are recorded front to back.
+        f32 depth = 0.0f;
+    };
+    
+    // Collects the frame's draws from any number of threads, then records them sorted by pass, pipeline, material and
+    // depth. Consecutive draws of a material are merged into one call: instanced if they share a vertex range, and
+    // multi-draw indirect otherwise. Pipelines are only bound when they change.
+    //
+    // A draw may come with per-instance data, which is gathered into the draw uniforms of its merged call. Shaders
+    // index it with gl_InstanceIndex:
+    //   layout(set = 1, binding = 1) uniform DrawUniforms { Instance instances[N]; } draw;
+    // Draws of a material must all have the same size of instance data, which must be a multiple of 16 bytes so that
+    // it matches the std140 array stride.
+    class DrawQueue
+    {
+    public:
+        static constexpr u32 MAX_DRAW_PACKETS = 65536;
+        static constexpr usize INSTANCE_DATA_CAPACITY = 2 * 1024 * 1024;
+        // Also bounded by how many instances' data fits in the draw uniforms.
+        static constexpr u32 MAX_DRAWS_PER_BATCH = 1024;
+        
+        explicit DrawQueue(std::shared_ptr<RenderPass> render_pass_ptr);
+        
+        DrawQueue(const DrawQueue &) = delete;
+        DrawQueue & operator=(const DrawQueue &) = delete;
+        
+        // Safe to call from any thread, but not while the queue is being recorded.
+        void submit(const DrawPacket &packet, std::span<const std::byte> instance_data = {});
+        template<typename T> requires std::is_trivially_copyable_v<T>
+        void submit(const DrawPacket &packet, const T &instance_data);
+        
+        // Records everything submitted since the last call and clears the queue. Called on the main thread while the
+        // render pass is rendering. Many batches are recorded in parallel, into secondary command buffers.
+        void record(vk::CommandBuffer command_buffer);
+        
+        // Ids wider than 16 bits are truncated, which only costs merges between the draws whose ids collide.
+        [[nodiscard]] static u64 make_sort_key(u8 pass, u32 pipeline_id, u32 material_id, f32 depth);
+    
+    private:
+        struct QueuedPacket
+        {
+            DrawPacket packet;
+            u32 instance_data_offset;
+            u32 instance_data_size;
+        };
+        
+        struct SortEntry
+        {
+            u64 key;
+            u32 packet_index;
+        };
+        
+        // Sorted draws recorded with one call.
+        struct Batch
+        {
+            usize first_entry_index;
+            usize entry_count;
+        };
+        
+        std::shared_ptr<RenderPass> m_render_pass_ptr;
+        
+        std::vector<QueuedPacket> m_packets;
+        std::atomic<u32> m_packet_count = 0;
+        std::vector<std::byte> m_instance_data;
+        std::atomic<usize> m_instance_data_size = 0;
+        
+        // Kept between frames so that recording does not allocate.
+        std::vector<SortEntry> m_sort_entries;
+        std::vector<SortEntry> m_sort_scratch;
+        std::vector<Batch> m_batches;
+        
+        static void radix_sort(std::vector<SortEntry> &entries, std::vector<SortEntry> &scratch);
+        
+        void build_batches();
+        void record_batches(vk::CommandBuffer command_buffer, usize begin, usize end);
+        [[nodiscard]] static bool can_merge(const QueuedPacket &batch_packet, const QueuedPacket &packet);
+    };
+    
+    template<typename T> requires std::is_trivially_copyable_v<T>
+    void DrawQueue::submit(const DrawPacket &packet, const T &instance_data)
+    {
+        submit(packet, std::as_bytes(std::span(&instance_data, 1)));
+    }
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <future>
+
+#include "mellohi/graphics/vulkan/device.hpp"
+
+namespace mellohi
+{
+    enum class BlendMode
+    {
+        Opaque,
+        Alpha,
+        Additive,
+    };
+    
+    std::optional<BlendMode> blend_mode_from_string(std::string_view str);
+    
+    struct PipelineLayoutKey
+    {
+        std::vector<vk::DescriptorSetLayout> descriptor_set_layouts;
+        std::vector<vk::PushConstantRange> push_constant_ranges;
+        
+        bool operator==(const PipelineLayoutKey &other) const = default;
+        
+        [[nodiscard]] u64 get_hash() const;
+    };
+    
+    // Everything a graphics pipeline is built from. Shader modules are identified by VulkanShader's module ids rather
+    // than by their handles, since a handle may be reused once a retired module is destroyed.
+    struct GraphicsPipelineKey
+    {
+        vk::ShaderModule vert_shader_module;
+        u64 vert_shader_module_id = 0;
+        vk::ShaderModule frag_shader_module;
+        u64 frag_shader_module_id = 0;
+        
+        std::vector<vk::VertexInputBindingDescription> vertex_bindings;
+        std::vector<vk::VertexInputAttributeDescription> vertex_attributes;
+        vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+        
+        vk::PolygonMode polygon_mode = vk::PolygonMode::eFill;
+        vk::CullModeFlags cull_mode = vk::CullModeFlagBits::eBack;
+        vk::FrontFace front_face = vk::FrontFace::eClockwise;
+        
+        bool depth_test = false;
+        bool depth_write = false;
+        vk::CompareOp depth_compare_op = vk::CompareOp::eLessOrEqual;
+        
+        BlendMode blend_mode = BlendMode::Opaque;
+        
+        vk::Format color_attachment_format = vk::Format::eUndefined;
+        vk::Format depth_attachment_format = vk::Format::eUndefined;
+        
+        PipelineLayoutKey layout_key;
+        
+        [[nodiscard]] bool operator==(const GraphicsPipelineKey &other) const;
+        
+        [[nodiscard]] u64 get_hash() const;
+    };
+}
+
+template<>
+struct std::hash<mellohi::PipelineLayoutKey>
+{
+    mellohi::usize operator()(const mellohi::PipelineLayoutKey &key) const noexcept
+    {
+        return static_cast<mellohi::usize>(key.get_hash());
+    }
+};
+
+template<>
+struct std::hash<mellohi::GraphicsPipelineKey>
+{
+    mellohi::usize operator()(const mellohi::GraphicsPipelineKey &key) const noexcept
+    {
+        return static_cast<mellohi::usize>(key.get_hash());
+    }
+};
+
+namespace mellohi
+{
+    // A pipeline shared by every material built from the same state. It is retired once the last of them lets go.
+    class GraphicsPipeline
+    {
+    public:
+        GraphicsPipeline(std::shared_ptr<Device> device_ptr, vk::Pipeline pipeline, vk::PipelineLayout layout);
+        ~GraphicsPipeline();
+        
+        GraphicsPipeline(const GraphicsPipeline &) = delete;
+        GraphicsPipeline & operator=(const GraphicsPipeline &) = delete;
+        
+        [[nodiscard]] vk::Pipeline get_pipeline() const;
+        [[nodiscard]] vk::PipelineLayout get_layout() const;
+        // Unique for the lifetime of the process, and small enough to sort draws by.
+        [[nodiscard]] u32 get_id() const;
+    
+    private:
+        std::shared_ptr<Device> m_device_ptr;
+        
+        vk::Pipeline m_pipeline;
+        vk::PipelineLayout m_layout;
+        u32 m_id;
+    };
+    
+    // Deduplicates graphics pipelines and pipeline layouts by the state they are built from. Pipelines are held weakly
+    // so that unused ones are not kept alive; layouts are small and live as long as the cache.
+    class GraphicsPipelineCache
+    {
+    public:
+        explicit GraphicsPipelineCache(std::shared_ptr<Device> device_ptr);
+        ~GraphicsPipelineCache();
+        
+        GraphicsPipelineCache(const GraphicsPipelineCache &) = delete;
+        GraphicsPipelineCache & operator=(const GraphicsPipelineCache &) = delete;
+        
+        // Thread-safe. Concurrent requests for a pipeline that is being built wait for that build.
+        [[nodiscard]] std::shared_ptr<GraphicsPipeline> get_or_create_pipeline(const GraphicsPipelineKey &key);
+        [[nodiscard]] vk::PipelineLayout get_or_create_layout(const PipelineLayoutKey &key);
+        
+        [[nodiscard]] usize get_hit_count() const;
+        [[nodiscard]] usize get_miss_count() const;
+    
+    private:
+        std::shared_ptr<Device> m_device_ptr;
+        
+        std::unordered_map<GraphicsPipelineKey, std::weak_ptr<GraphicsPipeline>> m_pipelines;
+        std::unordered_map<GraphicsPipelineKey, std::shared_future<std::shared_ptr<GraphicsPipeline>>> m_pending_pipelines;
+        std::mutex m_pipelines_mutex;
+        
+        std::unordered_map<PipelineLayoutKey, vk::PipelineLayout> m_layouts;
+        std::mutex m_layouts_mutex;
+        
+        std::atomic<usize> m_hit_count = 0;
+        std::atomic<usize> m_miss_count = 0;
+        
+        [[nodiscard]] vk::Pipeline create_pipeline(const GraphicsPipelineKey &key, vk::PipelineLayout layout) const;
+    };
+}
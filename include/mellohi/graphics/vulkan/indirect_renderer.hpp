@@ -0,0 +1,78 @@
+#pragma once
+
+#include "mellohi/graphics/vulkan/assets/vulkan_shader.hpp"
+#include "mellohi/graphics/vulkan/render_pass.hpp"
+
+namespace mellohi
+{
+    // Matches ChunkDraw in the shaders, with the std430 layout.
+    struct ChunkDraw
+    {
+        // Bounding sphere in world space.
+        fvec3 center;
+        f32 radius;
+        // Range of the shared index buffer, as in vk::DrawIndexedIndirectCommand.
+        u32 index_count;
+        u32 first_index;
+        i32 vertex_offset;
+        // Drawn as the first instance, so shaders read it as gl_InstanceIndex, e.g. to look the chunk up again.
+        u32 user_index;
+    };
+    
+    static_assert(sizeof(ChunkDraw) == 32, "ChunkDraw must match its std430 layout.");
+    
+    // Draws large numbers of chunks without the CPU visiting them each frame. Their draw metadata lives in a storage
+    // buffer, which a compute shader culls against the view frustum into a compacted buffer of indexed indirect
+    // commands and a draw count. A single vkCmdDrawIndexedIndirectCount then draws whatever survived.
+    //
+    // The buffers are registered with the bindless descriptor set, so shaders can read the chunks through the index
+    // of get_chunk_buffer_handle(). Requires Device::supports_draw_indirect_count().
+    class IndirectRenderer
+    {
+    public:
+        // Matches local_size_x in the culling shader.
+        static constexpr u32 CULL_WORKGROUP_SIZE = 64;
+        
+        IndirectRenderer(std::shared_ptr<AssetManager> asset_manager_ptr, std::shared_ptr<Device> device_ptr,
+                         std::shared_ptr<RenderPass> render_pass_ptr,
+                         std::shared_ptr<UploadScheduler> upload_scheduler_ptr,
+                         std::shared_ptr<BindlessDescriptors> bindless_descriptors_ptr);
+        ~IndirectRenderer();
+        
+        IndirectRenderer(const IndirectRenderer &) = delete;
+        IndirectRenderer & operator=(const IndirectRenderer &) = delete;
+        
+        // Replaces every chunk. Called between frames, since the chunks are uploaded for the next frame that begins.
+        void set_chunks(std::span<const ChunkDraw> chunks);
+        // Records the culling dispatch and the barriers around it. Called outside rendering, before draw().
+        void cull(vk::CommandBuffer command_buffer, const fmat4x4 &view_projection);
+        // Draws the chunks that survived the last cull() with the bound pipeline, indexing them with 32-bit indices.
+        // Called while rendering.
+        void draw(vk::CommandBuffer command_buffer, vk::Buffer index_buffer) const;
+        
+        [[nodiscard]] BindlessBufferHandle get_chunk_buffer_handle() const;
+        [[nodiscard]] u32 get_chunk_count() const;
+    
+    private:
+        std::shared_ptr<Device> m_device_ptr;
+        std::shared_ptr<RenderPass> m_render_pass_ptr;
+        std::shared_ptr<UploadScheduler> m_upload_scheduler_ptr;
+        std::shared_ptr<BindlessDescriptors> m_bindless_descriptors_ptr;
+        
+        std::shared_ptr<VulkanShader> m_cull_shader_ptr;
+        vk::Pipeline m_cull_pipeline;
+        // The module the pipeline was created from, so that it is rebuilt when the shader is reloaded.
+        u64 m_cull_shader_module_id = 0;
+        
+        Buffer m_chunk_buffer;
+        Buffer m_draw_command_buffer;
+        Buffer m_draw_count_buffer;
+        BindlessBufferHandle m_chunk_buffer_handle;
+        BindlessBufferHandle m_draw_command_buffer_handle;
+        BindlessBufferHandle m_draw_count_buffer_handle;
+        u32 m_chunk_count = 0;
+        
+        void update_cull_pipeline();
+        void retire_buffers();
+    };
+}
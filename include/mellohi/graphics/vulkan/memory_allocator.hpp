@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <mutex>
+
+#include "mellohi/graphics/vulkan/vulkan.hpp"
+
+namespace mellohi
+{
+    struct MemoryBlock;
+    
+    enum class MemoryUsage
+    {
+        // Device-local memory only the GPU touches, e.g. meshes and textures.
+        GpuOnly,
+        // Host-visible memory the CPU writes and the GPU reads, e.g. staging and uniform buffers.
+        CpuToGpu,
+        // Host-visible, preferably cached memory the GPU writes and the CPU reads back.
+        GpuToCpu,
+    };
+    
+    enum class AllocationStrategy
+    {
+        // First fit from a coalescing free list, for resources with independent lifetimes.
+        FreeList,
+        // Bump allocation, for resources released together. A block is reused once all of its allocations are freed.
+        Linear,
+    };
+    
+    struct AllocationCreateInfo
+    {
+        MemoryUsage usage = MemoryUsage::GpuOnly;
+        AllocationStrategy strategy = AllocationStrategy::FreeList;
+        // Gives the resource its own vk::DeviceMemory. Large resources and those the driver asks for get one anyway.
+        bool dedicated = false;
+    };
+    
+    struct Allocation
+    {
+        vk::DeviceMemory memory;
+        vk::DeviceSize offset = 0;
+        vk::DeviceSize size = 0;
+        // Host-visible memory stays mapped for its whole lifetime.
+        void *mapped_ptr = nullptr;
+        u32 memory_type_index = 0;
+        // nullptr for dedicated allocations.
+        MemoryBlock *block_ptr = nullptr;
+    };
+    
+    struct Buffer
+    {
+        vk::Buffer buffer;
+        vk::DeviceSize size = 0;
+        Allocation allocation;
+    };
+    
+    struct Image
+    {
+        vk::Image image;
+        vk::Format format = vk::Format::eUndefined;
+        vk::Extent3D extent;
+        Allocation allocation;
+    };
+    
+    struct MemoryHeapBudget
+    {
+        vk::MemoryHeapFlags flags;
+        // Bytes in vk::DeviceMemory objects made by this allocator, and how much of that is handed out.
+        vk::DeviceSize block_bytes = 0;
+        vk::DeviceSize allocation_bytes = 0;
+        // What the whole process uses and may use on the heap, from VK_EXT_memory_budget. Without the extension these
+        // fall back to block_bytes and the heap size.
+        vk::DeviceSize usage = 0;
+        vk::DeviceSize budget = 0;
+    };
+    
+    // Sub-allocates device memory for buffers and images from large blocks, kept in one pool per memory type and
+    // strategy, so that the number of vk::DeviceMemory objects stays far below the driver's limit.
+    class MemoryAllocator
+    {
+    public:
+        MemoryAllocator(vk::PhysicalDevice physical_device, vk::Device device, bool memory_budget_supported);
+        ~MemoryAllocator();
+        
+        [[nodiscard]] Allocation allocate_for_buffer(vk::Buffer buffer, const AllocationCreateInfo &create_info);
+        [[nodiscard]] Allocation allocate_for_image(vk::Image image, const AllocationCreateInfo &create_info);
+        // For memory that several resources are bound to, e.g. transient attachments that alias each other.
+        [[nodiscard]] Allocation allocate(const vk::MemoryRequirements &requirements,
+                                          const AllocationCreateInfo &create_info);
+        void free(const Allocation &allocation);
+        
+        [[nodiscard]] std::vector<MemoryHeapBudget> get_heap_budgets() const;
+        void log_heap_budgets() const;
+    
+    private:
+        vk::PhysicalDevice m_physical_device;
+        vk::Device m_device;
+        bool m_memory_budget_supported;
+        
+        vk::PhysicalDeviceMemoryProperties m_memory_properties;
+        vk::DeviceSize m_buffer_image_granularity;
+        vk::DeviceSize m_max_allocation_size;
+        u32 m_max_device_memory_count;
+        
+        // Indexed by memory type index * 2 + strategy.
+        std::array<std::vector<std::unique_ptr<MemoryBlock>>, VK_MAX_MEMORY_TYPES * 2> m_block_pools;
+        std::array<vk::DeviceSize, VK_MAX_MEMORY_HEAPS> m_heap_block_bytes{};
+        std::array<vk::DeviceSize, VK_MAX_MEMORY_HEAPS> m_heap_allocation_bytes{};
+        u32 m_device_memory_count = 0;
+        mutable std::mutex m_mutex;
+        
+        Allocation allocate(const vk::MemoryRequirements &requirements, const AllocationCreateInfo &create_info,
+                            const vk::MemoryDedicatedAllocateInfo &dedicated_allocate_info, bool dedicated);
+        std::optional<Allocation> allocate_from_block(MemoryBlock &block, vk::DeviceSize size,
+                                                      vk::DeviceSize alignment);
+        void free_to_block(MemoryBlock &block, const Allocation &allocation);
+        
+        std::pair<vk::DeviceMemory, void *> allocate_device_memory(vk::DeviceSize size, u32 memory_type_index,
+                                                                   const void *next_ptr);
+        void free_device_memory(vk::DeviceMemory memory, vk::DeviceSize size, u32 memory_type_index);
+        
+        [[nodiscard]] u32 find_memory_type_index(u32 memory_type_bits, MemoryUsage usage) const;
+        [[nodiscard]] vk::DeviceSize get_block_size(u32 memory_type_index) const;
+        [[nodiscard]] bool is_host_visible(u32 memory_type_index) const;
+        [[nodiscard]] u32 get_heap_index(u32 memory_type_index) const;
+    };
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <functional>
+
+#include "mellohi/graphics/vulkan/render_pass.hpp"
+
+namespace mellohi
+{
+    enum class RenderGraphAccess
+    {
+        ColorAttachmentWrite,
+        DepthAttachmentWrite,
+        // Depth testing without writes.
+        DepthAttachmentRead,
+        FragmentShaderRead,
+        ComputeShaderRead,
+        ComputeShaderWrite,
+        TransferRead,
+        TransferWrite,
+    };
+    
+    struct RenderGraphImageInfo
+    {
+        vk::Format format = vk::Format::eUndefined;
+        // Sized like the swapchain if not set, and resized along with it.
+        std::optional<vk::Extent2D> extent_opt;
+    };
+    
+    class RenderGraph;
+    
+    // Declares what a pass reads and writes. Each resource may be used once per pass.
+    class RenderGraphPassBuilder
+    {
+    public:
+        // The load op decides whether the attachment keeps what earlier passes wrote to it.
+        void write_color_attachment(std::string_view name, vk::AttachmentLoadOp load_op = vk::AttachmentLoadOp::eClear);
+        void write_depth_attachment(std::string_view name, vk::AttachmentLoadOp load_op = vk::AttachmentLoadOp::eClear);
+        void read_depth_attachment(std::string_view name);
+        void read(std::string_view name, RenderGraphAccess access);
+        // Shader and transfer writes may cover only part of the image, so they keep what earlier passes wrote.
+        void write(std::string_view name, RenderGraphAccess access);
+        // Keeps the pass even if nothing in the graph reads what it writes, e.g. if it writes buffers outside it.
+        void set_side_effects();
+    
+    private:
+        friend class RenderGraph;
+        
+        RenderGraphPassBuilder(RenderGraph &render_graph, usize pass_index);
+        
+        RenderGraph &m_render_graph;
+        usize m_pass_index;
+        
+        void use(std::string_view name, RenderGraphAccess access, vk::AttachmentLoadOp load_op);
+    };
+    
+    // Passes of a frame in submission order, and the images they pass between each other. Once compiled, passes that
+    // contribute nothing to the swapchain image are culled, the barriers and layout transitions between the rest are
+    // worked out, and transient images whose lifetimes don't overlap are placed in the same memory. Executing the
+    // graph then only records what was planned.
+    //
+    // Passes with attachments are recorded between RenderPass::begin_rendering() and RenderPass::end_rendering().
+    class RenderGraph
+    {
+    public:
+        using ExecuteFunction = std::function<void(vk::CommandBuffer command_buffer)>;
+        
+        RenderGraph(std::shared_ptr<Device> device_ptr, std::shared_ptr<Swapchain> swapchain_ptr,
+                    std::shared_ptr<RenderPass> render_pass_ptr);
+        ~RenderGraph();
+        
+        RenderGraph(const RenderGraph &) = delete;
+        RenderGraph & operator=(const RenderGraph &) = delete;
+        
+        // Transient images are created by the graph and only live for the frame.
+        void create_image(std::string name, const RenderGraphImageInfo &info);
+        // The image acquired by the render pass for this frame. It is presented once the graph has executed.
+        void import_swapchain_image(std::string name);
+        void add_pass(std::string name, const std::function<void(RenderGraphPassBuilder &builder)> &setup,
+                      ExecuteFunction execute);
+        
+        void compile();
+        // Records every pass that was not culled into the render pass's current command buffer.
+        void execute();
+        
+        // For passes that read images, e.g. to bind them to descriptors.
+        [[nodiscard]] vk::Image get_image(std::string_view name) const;
+        [[nodiscard]] vk::ImageView get_image_view(std::string_view name) const;
+        [[nodiscard]] vk::Extent2D get_extent(std::string_view name) const;
+    
+    private:
+        friend class RenderGraphPassBuilder;
+        
+        struct ResourceUse
+        {
+            usize resource_index;
+            RenderGraphAccess access;
+            vk::AttachmentLoadOp load_op;
+        };
+        
+        struct Pass
+        {
+            std::string name;
+            std::vector<ResourceUse> uses;
+            ExecuteFunction execute;
+            bool has_side_effects = false;
+            bool is_culled = false;
+            
+            // Filled in when compiling. The image handles of the barriers are patched in when executing, since the
+            // swapchain image changes every frame.
+            std::vector<vk::ImageMemoryBarrier2> image_barriers;
+            std::vector<usize> image_barrier_resource_indices;
+            std::optional<RenderingAttachments> attachments_opt;
+            std::vector<usize> attachment_resource_indices;
+        };
+        
+        // Transient images in the same slot share memory.
+        struct AliasSlot
+        {
+            std::vector<usize> resource_indices;
+            vk::MemoryRequirements requirements;
+        };
+        
+        struct Resource
+        {
+            std::string name;
+            RenderGraphImageInfo info;
+            bool is_swapchain_image = false;
+            
+            // Filled in when compiling. Lifetimes are in pass indices, and only cover passes that were not culled.
+            vk::ImageUsageFlags usage;
+            std::optional<usize> first_pass_index_opt;
+            usize last_pass_index = 0;
+            std::optional<usize> alias_slot_index_opt;
+            
+            Image image;
+            vk::ImageView image_view;
+        };
+        
+        // What a resource was last used for, as far as synchronizing the next use goes.
+        struct ResourceState
+        {
+            vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+            // The last write, or layout transition, which every later use has to wait for.
+            vk::PipelineStageFlags2 write_stage_mask;
+            vk::AccessFlags2 write_access_mask;
+            // Where the last write has been made visible since. Writes also have to wait for these reads.
+            vk::PipelineStageFlags2 read_stage_mask;
+            vk::AccessFlags2 read_access_mask;
+        };
+        
+        std::shared_ptr<Device> m_device_ptr;
+        std::shared_ptr<Swapchain> m_swapchain_ptr;
+        std::shared_ptr<RenderPass> m_render_pass_ptr;
+        
+        std::vector<Resource> m_resources;
+        std::unordered_map<std::string, usize> m_resource_indices;
+        std::vector<Pass> m_passes;
+        std::vector<AliasSlot> m_alias_slots;
+        
+        std::vector<vk::ImageMemoryBarrier2> m_final_image_barriers;
+        std::vector<usize> m_final_image_barrier_resource_indices;
+        
+        bool m_is_compiled = false;
+        // The swapchain extent the transient images were created for.
+        vk::Extent2D m_compiled_extent;
+        
+        [[nodiscard]] usize get_resource_index(std::string_view name) const;
+        [[nodiscard]] vk::Image get_resource_image(const Resource &resource) const;
+        [[nodiscard]] vk::ImageView get_resource_image_view(const Resource &resource) const;
+        [[nodiscard]] vk::Extent2D get_resource_extent(const Resource &resource) const;
+        
+        void cull_passes();
+        void compute_lifetimes();
+        void plan_barriers();
+        void simulate_barriers(std::vector<ResourceState> &alias_slot_states, bool record);
+        void plan_attachments();
+        
+        void create_transient_images();
+        void retire_transient_images();
+        
+        void record_image_barriers(vk::CommandBuffer command_buffer, std::vector<vk::ImageMemoryBarrier2> &barriers,
+                                   std::span<const usize> resource_indices) const;
+    };
+}
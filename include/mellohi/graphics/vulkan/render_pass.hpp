@@ -1,36 +1,158 @@
 #pragma once
 
-#include "mellohi/graphics/vulkan/swapchain.hpp"
+#include "mellohi/core/thread_pool.hpp"
+#include "mellohi/graphics/vulkan/bindless_descriptors.hpp"
+#include "mellohi/graphics/vulkan/graphics_pipeline_cache.hpp"
+#include "mellohi/graphics/vulkan/uniform_ring.hpp"
+#include "mellohi/graphics/vulkan/upload_scheduler.hpp"
 
 namespace mellohi
 {
+    struct RenderingAttachment
+    {
+        vk::ImageView image_view;
+        vk::Format format = vk::Format::eUndefined;
+        vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+        // Color attachments are cleared to the window clear color, depth attachments to 1.0.
+        vk::AttachmentLoadOp load_op = vk::AttachmentLoadOp::eLoad;
+        vk::AttachmentStoreOp store_op = vk::AttachmentStoreOp::eStore;
+    };
+    
+    struct RenderingAttachments
+    {
+        vk::Extent2D extent;
+        std::vector<RenderingAttachment> color_attachments;
+        std::optional<RenderingAttachment> depth_attachment_opt;
+    };
+    
+    // Records a frame into one command buffer and submits it for presentation. The attachments are expected to be in
+    // the given layouts when rendering begins; the render graph records the barriers that get them there.
+    //
+    // Every pipeline shares one layout: the bindless descriptor set as set 0, the uniform ring's set as set 1 and a
+    // push constant range for all stages. Both sets stay bound for the whole frame, so draws only push constants and
+    // move dynamic offsets.
+    //
+    // Uniform and push constant structs are copied as they are, so they have to match the shaders' std140 and
+    // std430 layouts.
     class RenderPass
     {
     public:
+        // Guaranteed by every Vulkan implementation.
+        static constexpr u32 PUSH_CONSTANT_SIZE = 128;
+        
         RenderPass(std::shared_ptr<EngineConfigAsset> engine_config_ptr, std::shared_ptr<Device> device_ptr,
-                   std::shared_ptr<Swapchain> swapchain_ptr);
+                   std::shared_ptr<Swapchain> swapchain_ptr, std::shared_ptr<UploadScheduler> upload_scheduler_ptr,
+                   std::shared_ptr<BindlessDescriptors> bindless_descriptors_ptr,
+                   std::shared_ptr<GraphicsPipelineCache> graphics_pipeline_cache_ptr);
         ~RenderPass();
         
         [[nodiscard]] bool begin();
+        void begin_rendering(const RenderingAttachments &attachments);
         void bind_graphics_pipeline(vk::Pipeline graphics_pipeline);
+        // Uploads the data read through binding 0 of set 1 for the rest of the frame. Called outside record_parallel().
+        void set_frame_uniforms(std::span<const std::byte> data);
+        template<typename T> requires std::is_trivially_copyable_v<T>
+        void set_frame_uniforms(const T &uniforms);
+        // Uploads the data read through binding 1 of set 1 by the command buffer's following draws, for data too large
+        // for push constants. Safe to call from record_parallel().
+        void set_draw_uniforms(vk::CommandBuffer command_buffer, std::span<const std::byte> data);
+        template<typename T> requires std::is_trivially_copyable_v<T>
+        void set_draw_uniforms(vk::CommandBuffer command_buffer, const T &uniforms);
+        // Like set_draw_uniforms(), for callers that write the data in place, e.g. gathering per-instance data.
+        [[nodiscard]] std::span<std::byte> allocate_draw_uniforms(vk::CommandBuffer command_buffer, usize size);
+        // Writes into the shared push constant range, e.g. the bindless indices of a draw's resources.
+        void push_constants(vk::CommandBuffer command_buffer, std::span<const std::byte> data, u32 offset = 0) const;
+        template<typename T> requires std::is_trivially_copyable_v<T>
+        void push_constants(vk::CommandBuffer command_buffer, const T &constants, u32 offset = 0) const;
         void draw(u32 vertex_count, u32 instance_count, u32 first_vertex, u32 first_instance);
+        // Draws every command in one call if the device supports multi-draw indirect, or one call each otherwise.
+        // Safe to call from record_parallel().
+        void draw_indirect(vk::CommandBuffer command_buffer, std::span<const vk::DrawIndirectCommand> commands);
+        // Splits [0, count) into contiguous ranges that are recorded in parallel, each into a secondary command buffer
+        // that continues the current rendering. The buffers are executed in range order, so the result matches
+        // recording the whole range in order on one thread. Pipelines bound before the call must be bound again after
+        // it; the shared descriptor sets are bound again with the frame's uniforms.
+        void record_parallel(usize count,
+                             const std::function<void(vk::CommandBuffer command_buffer, usize begin, usize end)> &record);
+        void end_rendering();
         void end();
         
         [[nodiscard]] vk::CommandBuffer get_current_command_buffer() const;
-        [[nodiscard]] vk::RenderPass get_render_pass() const;
+        [[nodiscard]] u32 get_current_image_index() const;
+        // Pipelines drawn in this pass are created against these formats rather than against a vk::RenderPass.
+        [[nodiscard]] vk::Format get_color_attachment_format() const;
+        // Pipelines drawn in this pass use this layout, so that the shared descriptor sets stay bound across them.
+        [[nodiscard]] const PipelineLayoutKey &get_pipeline_layout_key() const;
+        [[nodiscard]] vk::PipelineLayout get_pipeline_layout() const;
         
     private:
         std::shared_ptr<EngineConfigAsset> m_engine_config_ptr;
         std::shared_ptr<Device> m_device_ptr;
         std::shared_ptr<Swapchain> m_swapchain_ptr;
+        std::shared_ptr<UploadScheduler> m_upload_scheduler_ptr;
+        std::shared_ptr<BindlessDescriptors> m_bindless_descriptors_ptr;
+        
+        UniformRing m_uniform_ring;
+        PipelineLayoutKey m_pipeline_layout_key;
+        vk::PipelineLayout m_pipeline_layout;
+        // Dynamic offset of this frame's uniforms, which binding 1 also points at until a draw sets its own.
+        u32 m_frame_uniform_offset = 0;
     
-        vk::RenderPass m_render_pass;
         vk::CommandPool m_command_pool;
         std::vector<vk::CommandBuffer> m_command_buffers;
         std::optional<u32> m_current_image_index_opt;
+        std::vector<vk::SemaphoreSubmitInfo> m_wait_semaphore_infos;
+        
+        // Kept between frames so that beginning rendering does not allocate.
+        RenderingAttachments m_rendering_attachments;
+        std::vector<vk::RenderingAttachmentInfo> m_color_attachment_infos;
+        bool m_is_rendering = false;
+        
+        // Command pools are not thread-safe, so every range of record_parallel() gets its own pool for each frame in
+        // flight. Pools are reset as a whole once their frame is reused.
+        struct SecondaryCommandPool
+        {
+            vk::CommandPool command_pool;
+            std::vector<vk::CommandBuffer> command_buffers;
+            usize used_count = 0;
+        };
+        
+        // Indexed by frame in flight, then by range.
+        std::vector<std::vector<SecondaryCommandPool>> m_secondary_command_pools;
+        
+        // Declared last so workers are joined before anything they reference is destroyed.
+        ThreadPool m_recording_thread_pool;
         
-        void create_render_pass();
         void create_command_pool();
         void create_command_buffers();
+        void create_secondary_command_pools();
+        void retire_secondary_command_pools();
+        
+        void bind_descriptor_sets(vk::CommandBuffer command_buffer, vk::PipelineBindPoint pipeline_bind_point,
+                                  u32 draw_uniform_offset) const;
+        
+        // Every instance of one rendering uses the same attachments and load and store ops; only the flags differ.
+        void record_begin_rendering(vk::RenderingFlags flags);
+        void set_viewport_and_scissor(vk::CommandBuffer command_buffer) const;
+        [[nodiscard]] vk::CommandBuffer begin_secondary_command_buffer(SecondaryCommandPool &secondary_command_pool);
     };
+    
+    template<typename T> requires std::is_trivially_copyable_v<T>
+    void RenderPass::set_frame_uniforms(const T &uniforms)
+    {
+        set_frame_uniforms(std::as_bytes(std::span(&uniforms, 1)));
+    }
+    
+    template<typename T> requires std::is_trivially_copyable_v<T>
+    void RenderPass::set_draw_uniforms(const vk::CommandBuffer command_buffer, const T &uniforms)
+    {
+        set_draw_uniforms(command_buffer, std::as_bytes(std::span(&uniforms, 1)));
+    }
+    
+    template<typename T> requires std::is_trivially_copyable_v<T>
+    void RenderPass::push_constants(const vk::CommandBuffer command_buffer, const T &constants, const u32 offset) const
+    {
+        static_assert(sizeof(T) <= PUSH_CONSTANT_SIZE, "Push constants must fit in the shared range.");
+        push_constants(command_buffer, std::as_bytes(std::span(&constants, 1)), offset);
+    }
 }
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <optional>
+
+#include <shaderc/shaderc.h>
+
+#include "mellohi/core/assets/asset_id.hpp"
+#include "mellohi/core/logger.hpp"
+
+namespace mellohi
+{
+    class AssetManager;
+    
+    // Compiles GLSL shader assets to SPIR-V, keeping the results on disk so that unchanged shaders are never compiled
+    // twice. Entries are keyed by the shader source, stage, compile options, shaderc build and SPIR-V target.
+    class ShaderCache
+    {
+    public:
+        static ShaderCache & get();
+        
+        [[nodiscard]] std::vector<u32> get_spirv_code(const AssetId &shader_id);
+        // Compiles and caches shaders ahead of time on the asset worker threads, with the calling thread helping, so that
+        // later loads of them are hits. Returns once every shader is cached.
+        void prewarm(AssetManager &asset_manager, const std::vector<AssetId> &shader_ids);
+        
+        [[nodiscard]] usize get_hit_count() const;
+        [[nodiscard]] usize get_miss_count() const;
+        
+    private:
+        explicit ShaderCache(std::filesystem::path cache_dir);
+        
+        std::filesystem::path m_cache_dir;
+        u64 m_compiler_hash;
+        
+        std::atomic<usize> m_hit_count = 0;
+        std::atomic<usize> m_miss_count = 0;
+        
+        std::optional<std::vector<u32>> read_entry(const std::filesystem::path &entry_path) const;
+        void write_entry(const std::filesystem::path &entry_path, const std::vector<u32> &spirv_code) const;
+        
+        static std::vector<u32> compile(const AssetId &shader_id, std::string_view source_code,
+                                        shaderc_shader_kind shader_kind);
+    };
+}
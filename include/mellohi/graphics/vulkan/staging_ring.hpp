@@ -0,0 +1,49 @@
+#pragma once
+
+#include <deque>
+
+#include "mellohi/graphics/vulkan/device.hpp"
+
+namespace mellohi
+{
+    // A persistently mapped, host-visible buffer that upload data is copied through. Space is handed out front to
+    // back and wraps around; it is reclaimed in batches once the GPU has finished the copies that read it.
+    class StagingRing
+    {
+    public:
+        StagingRing(std::shared_ptr<Device> device_ptr, vk::DeviceSize size);
+        ~StagingRing();
+        
+        StagingRing(const StagingRing &) = delete;
+        StagingRing & operator=(const StagingRing &) = delete;
+        
+        // Returns the offset of the allocated range, or std::nullopt if the ring is too full.
+        [[nodiscard]] std::optional<vk::DeviceSize> allocate(vk::DeviceSize size, vk::DeviceSize alignment);
+        // Tags everything allocated since the last call with the batch that reads it.
+        void close_batch(u64 batch);
+        // Reclaims the space of batches below the given one.
+        void release_batches_before(u64 batch);
+        
+        [[nodiscard]] bool is_empty() const;
+        [[nodiscard]] std::optional<u64> get_oldest_batch_opt() const;
+        [[nodiscard]] vk::Buffer get_buffer() const;
+        [[nodiscard]] vk::DeviceSize get_size() const;
+        [[nodiscard]] std::byte * get_mapped_ptr(vk::DeviceSize offset) const;
+    
+    private:
+        struct BatchRegion
+        {
+            u64 batch;
+            vk::DeviceSize end;
+        };
+        
+        std::shared_ptr<Device> m_device_ptr;
+        
+        Buffer m_buffer;
+        // Bytes [tail, head) are in use, wrapping around the end of the buffer. The head never catches up with the
+        // tail, so head == tail means the ring is empty.
+        vk::DeviceSize m_head = 0;
+        vk::DeviceSize m_tail = 0;
+        std::deque<BatchRegion> m_batch_regions;
+    };
+}
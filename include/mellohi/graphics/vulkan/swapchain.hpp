@@ -1,5 +1,7 @@
 #pragma once
 
+#include <deque>
+
 #include "mellohi/graphics/vulkan/device.hpp"
 
 namespace mellohi
@@ -7,48 +9,82 @@ namespace mellohi
     class Swapchain
     {
     public:
-        const static usize MAX_FRAMES_IN_FLIGHT = 2;
+        // Upper bound for graphics.frames_in_flight.
+        const static u32 MAX_FRAMES_IN_FLIGHT = 4;
     
         Swapchain(std::shared_ptr<EngineConfigAsset> engine_config_ptr, std::shared_ptr<Platform> platform_ptr,
                   std::shared_ptr<Device> device_ptr);
         ~Swapchain();
         
-        void init_with_render_pass(vk::RenderPass render_pass);
-        
         [[nodiscard]] std::optional<u32> acquire_next_image_index();
-        void present(u32 image_index, vk::CommandBuffer command_buffer);
+        // The submission also waits on the given semaphores, e.g. for uploads the frame reads from.
+        void present(u32 image_index, vk::CommandBuffer command_buffer,
+                     std::span<const vk::SemaphoreSubmitInfo> wait_semaphore_infos = {});
         
         [[nodiscard]] usize get_current_frame_index() const;
+        [[nodiscard]] u32 get_frames_in_flight() const;
         [[nodiscard]] vk::Extent2D get_extent() const;
         [[nodiscard]] vk::SwapchainKHR get_swapchain() const;
-        [[nodiscard]] const std::vector<vk::ImageView> & get_image_views() const;
-        [[nodiscard]] vk::Framebuffer get_framebuffer(u32 image_index) const;
+        [[nodiscard]] vk::Image get_image(u32 image_index) const;
+        [[nodiscard]] vk::ImageView get_image_view(u32 image_index) const;
 
     private:
+        // Everything from the engine config that the swapchain is built from.
+        struct PresentationSettings
+        {
+            bool vsync;
+            u32 frames_in_flight;
+            LatencyMode latency_mode;
+            
+            bool operator==(const PresentationSettings &other) const = default;
+        };
+        
         std::shared_ptr<EngineConfigAsset> m_engine_config_ptr;
         usize m_engine_config_reloaded_callback_id;
         
         std::shared_ptr<Platform> m_platform_ptr;
         std::shared_ptr<Device> m_device_ptr;
-        vk::RenderPass m_render_pass;
 
-        bool m_should_be_recreated;
+        PresentationSettings m_presentation_settings;
+        bool m_should_be_recreated = false;
         vk::SwapchainKHR m_swapchain;
         vk::Extent2D m_extent;
+        std::vector<vk::Image> m_images;
         std::vector<vk::ImageView> m_image_views;
-        std::vector<vk::Framebuffer> m_framebuffers;
         
         std::vector<vk::Semaphore> m_image_available_semaphores;
         std::vector<vk::Semaphore> m_render_finished_semaphores;
-        std::vector<vk::Fence> m_in_flight_fences;
         usize m_current_frame_index = 0;
+        
+        // Presentation may keep using a swapchain and the semaphores it waited on after the frame timeline says the
+        // frame is done, so these are destroyed once every present made before they were replaced has finished.
+        struct RetiredPresentationObjects
+        {
+            u64 present_count;
+            vk::SwapchainKHR swapchain;
+            std::vector<vk::Semaphore> semaphores;
+        };
+        
+        std::deque<RetiredPresentationObjects> m_retired_presentation_objects;
+        // Signaled as presents finish, oldest first. Only used if the device supports present fences.
+        std::deque<vk::Fence> m_pending_present_fences;
+        std::vector<vk::Fence> m_free_present_fences;
+        u64 m_present_count = 0;
+        u64 m_finished_present_count = 0;
 
         void create_swapchain();
         void create_image_views();
-        void create_framebuffers();
         void create_sync_objects();
+        void retire_sync_objects();
+        void destroy_finished_presentation_objects();
+        void destroy_presentation_objects(const RetiredPresentationObjects &presentation_objects) const;
+        
+        [[nodiscard]] PresentationSettings get_configured_presentation_settings() const;
+        [[nodiscard]] vk::PresentModeKHR choose_present_mode() const;
+        [[nodiscard]] u32 choose_image_count(const vk::SurfaceCapabilitiesKHR &surface_capabilities) const;
         
         void recreate();
+        void retire();
         void destroy();
         
         void on_engine_config_reloaded();
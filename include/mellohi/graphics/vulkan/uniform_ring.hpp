@@ -0,0 +1,61 @@
+#pragma once
+
+#include "mellohi/graphics/vulkan/swapchain.hpp"
+
+namespace mellohi
+{
+    struct UniformRingAllocation
+    {
+        // Into the ring's buffer, and so also the dynamic offset to bind the allocation with.
+        u32 offset;
+        std::byte *mapped_ptr;
+    };
+    
+    // A persistently mapped, host-visible buffer split into one region per frame in flight, which per-frame and
+    // per-draw uniform data is bump allocated from. Shaders read it through a descriptor set with two dynamic uniform
+    // buffers, declared as
+    //   layout(set = 1, binding = 0) uniform FrameUniforms { ... } frame;
+    //   layout(set = 1, binding = 1) uniform DrawUniforms { ... } draw;
+    // The set is written once, and pointed at each allocation by its dynamic offset when it is bound. Indirect draw
+    // commands written by the CPU are allocated from the ring as well.
+    class UniformRing
+    {
+    public:
+        // Size of each frame's region.
+        static constexpr vk::DeviceSize FRAME_REGION_SIZE = 4 * 1024 * 1024;
+        // Range of the descriptors, and so the largest single allocation. Guaranteed by every Vulkan implementation.
+        static constexpr u32 MAX_UNIFORM_SIZE = 16384;
+        
+        explicit UniformRing(std::shared_ptr<Device> device_ptr);
+        ~UniformRing();
+        
+        UniformRing(const UniformRing &) = delete;
+        UniformRing & operator=(const UniformRing &) = delete;
+        
+        // Switches to the region of the frame being recorded, whose previous contents the GPU has finished reading.
+        // Returns the dynamic offset of the region's start.
+        [[nodiscard]] u32 begin_frame();
+        // Allocates from the current frame's region. Safe to call from any thread.
+        [[nodiscard]] UniformRingAllocation allocate(vk::DeviceSize size);
+        
+        [[nodiscard]] vk::Buffer get_buffer() const;
+        [[nodiscard]] vk::DescriptorSetLayout get_descriptor_set_layout() const;
+        [[nodiscard]] vk::DescriptorSet get_descriptor_set() const;
+    
+    private:
+        std::shared_ptr<Device> m_device_ptr;
+        
+        Buffer m_buffer;
+        vk::DeviceSize m_alignment = 0;
+        
+        vk::DescriptorSetLayout m_descriptor_set_layout;
+        vk::DescriptorPool m_descriptor_pool;
+        vk::DescriptorSet m_descriptor_set;
+        
+        vk::DeviceSize m_region_offset = 0;
+        // Bytes allocated from the current region.
+        std::atomic<vk::DeviceSize> m_head = 0;
+        
+        void create_descriptor_set();
+    };
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <deque>
+#include <span>
+
+#include "mellohi/graphics/vulkan/staging_ring.hpp"
+
+namespace mellohi
+{
+    // Batches CPU to GPU copies through a staging ring and submits them to the transfer queue once per frame, so that
+    // uploads overlap rendering instead of stalling it. Each batch signals a timeline semaphore with its number once
+    // its copies have finished, which the frame that first uses them waits on.
+    //
+    // Destination resources must be created with eTransferDst usage and exclusive sharing. With a dedicated transfer
+    // queue family their ownership is released to the graphics family after the copy and acquired by the frame
+    // through record_acquire_barriers(). Uploaded resources may be used from the next frame that begins.
+    class UploadScheduler
+    {
+    public:
+        // Total size of the staging ring. Larger single uploads are not supported.
+        static constexpr vk::DeviceSize STAGING_RING_SIZE = 32ull * 1024 * 1024;
+        
+        explicit UploadScheduler(std::shared_ptr<Device> device_ptr);
+        ~UploadScheduler();
+        
+        UploadScheduler(const UploadScheduler &) = delete;
+        UploadScheduler & operator=(const UploadScheduler &) = delete;
+        
+        // These return the batch the copy was recorded into. Safe to call from any thread.
+        u64 upload_to_buffer(const Buffer &buffer, std::span<const std::byte> data, vk::DeviceSize buffer_offset = 0);
+        // Uploads the first mip level and layer of a color image and leaves it in the given layout.
+        u64 upload_to_image(const Image &image, std::span<const std::byte> data,
+                            vk::ImageLayout final_layout = vk::ImageLayout::eShaderReadOnlyOptimal);
+        
+        // Submits the batch being recorded, if anything was uploaded into it. Called once per frame.
+        void flush();
+        // Records the acquiring half of the ownership transfers for every batch flushed since the last call. Returns
+        // the wait the command buffer's submission needs, if any batches were flushed.
+        [[nodiscard]] std::optional<vk::SemaphoreSubmitInfo> record_acquire_barriers(vk::CommandBuffer command_buffer);
+        
+        [[nodiscard]] bool is_batch_complete(u64 batch) const;
+        // Flushes the batch first if it is still being recorded.
+        void wait_for_batch(u64 batch);
+    
+    private:
+        struct SubmittedBatch
+        {
+            u64 batch;
+            vk::CommandBuffer command_buffer;
+        };
+        
+        std::shared_ptr<Device> m_device_ptr;
+        vk::DeviceSize m_optimal_buffer_copy_offset_alignment;
+        
+        StagingRing m_staging_ring;
+        
+        vk::CommandPool m_command_pool;
+        vk::Semaphore m_timeline_semaphore;
+        // The batch being recorded. Batches are numbered from 1 so that the semaphore's initial value of 0 means none
+        // have completed.
+        u64 m_batch = 1;
+        u64 m_last_flushed_batch = 0;
+        u64 m_last_acquired_batch = 0;
+        vk::CommandBuffer m_recording_command_buffer;
+        std::deque<SubmittedBatch> m_submitted_batches;
+        std::vector<vk::CommandBuffer> m_free_command_buffers;
+        
+        // Acquire barriers for the batch being recorded, and for flushed batches not yet acquired by a frame.
+        std::vector<vk::BufferMemoryBarrier2> m_recording_buffer_acquires;
+        std::vector<vk::ImageMemoryBarrier2> m_recording_image_acquires;
+        std::vector<vk::BufferMemoryBarrier2> m_pending_buffer_acquires;
+        std::vector<vk::ImageMemoryBarrier2> m_pending_image_acquires;
+        
+        mutable std::mutex m_mutex;
+        
+        void create_command_pool();
+        
+        vk::DeviceSize allocate_staging(vk::DeviceSize size, vk::DeviceSize alignment);
+        vk::CommandBuffer begin_recording();
+        void flush_locked();
+    };
+}
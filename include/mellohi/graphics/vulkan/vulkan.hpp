@@ -16,6 +16,7 @@
 // Need to "export" multiple header files because of https://github.com/clangd/clangd/issues/1085.
 #include <vulkan/vulkan.hpp> // IWYU pragma: export
 #include <vulkan/vulkan_enums.hpp> // IWYU pragma: export
+#include <vulkan/vulkan_format_traits.hpp> // IWYU pragma: export
 #include <vulkan/vulkan_handles.hpp> // IWYU pragma: export
 
 #define MH_ASSERT_VK(vk_result, message, ...) \
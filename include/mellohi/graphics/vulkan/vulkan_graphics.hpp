@@ -1,7 +1,11 @@
 #pragma once
 
+#include <chrono>
+
 #include "mellohi/graphics/graphics.hpp"
-#include "mellohi/graphics/vulkan/assets/vulkan_material.hpp"
+#include "mellohi/graphics/vulkan/draw_queue.hpp"
+#include "mellohi/graphics/vulkan/indirect_renderer.hpp"
+#include "mellohi/graphics/vulkan/render_graph.hpp"
 
 namespace mellohi
 {
@@ -17,9 +21,25 @@ namespace mellohi
         std::shared_ptr<AssetManager> m_asset_manager_ptr;
         std::shared_ptr<Device> m_device_ptr;
         std::shared_ptr<Swapchain> m_swapchain_ptr;
+        std::shared_ptr<UploadScheduler> m_upload_scheduler_ptr;
+        std::shared_ptr<GraphicsPipelineCache> m_graphics_pipeline_cache_ptr;
+        std::shared_ptr<BindlessDescriptors> m_bindless_descriptors_ptr;
         std::shared_ptr<RenderPass> m_render_pass_ptr;
+        std::unique_ptr<RenderGraph> m_render_graph_ptr;
+        std::unique_ptr<DrawQueue> m_draw_queue_ptr;
         std::shared_ptr<VulkanMaterial> m_triangle_material_ptr;
+        // Only created if the device supports indirect draw counts.
+        std::unique_ptr<IndirectRenderer> m_indirect_renderer_ptr;
+        std::shared_ptr<VulkanMaterial> m_chunk_material_ptr;
+        Buffer m_chunk_index_buffer;
+        std::chrono::steady_clock::time_point m_start_time;
+        
+        void create_chunks();
+        void create_render_graph();
+        
+        [[nodiscard]] fmat4x4 get_view_projection() const;
         
-        void create_graphics_pipeline();
+        // Seconds since the graphics were created.
+        [[nodiscard]] f32 get_time() const;
     };
 }
@@ -13,34 +13,65 @@ namespace mellohi
     
     Asset::~Asset()
     {
+        m_asset_manager_ptr->set_dependencies(m_id, {});
+        
         MH_TRACE("Asset {} destructed.", get_id());
     }
     
     void Asset::reload()
     {
-        load();
-        
+        get_asset_manager().reload(get_id());
+    }
+    
+    void Asset::notify_reloaded()
+    {
         MH_TRACE("Asset {} reloaded.", get_id());
         
-        // Callbacks can deregister themselves mid-loop, so we make a copy to keep the iteration valid.
-        const auto reload_callbacks = m_reload_callbacks;
-        for (const auto &[id, callback] : reload_callbacks)
+        const std::lock_guard<std::recursive_mutex> lock(m_reload_callback_mutex);
+        m_dispatching_reload_callbacks = true;
+        
+        // Callbacks registered mid-loop are left for the next reload.
+        const usize callback_count = m_reload_callbacks.size();
+        for (usize i = 0; i < callback_count; ++i)
         {
-            callback();
+            if (m_reload_callbacks[i].callback)
+            {
+                m_reload_callbacks[i].callback();
+            }
         }
+        
+        m_dispatching_reload_callbacks = false;
+        std::erase_if(m_reload_callbacks, [](const ReloadCallback &reload_callback)
+        {
+            return !reload_callback.callback;
+        });
     }
     
     usize Asset::register_reload_callback(const std::function<void()> &callback)
     {
-        const std::lock_guard<std::mutex> lock(m_reload_callback_mutex);
-        m_reload_callbacks[m_next_reload_callback_id] = callback;
+        const std::lock_guard<std::recursive_mutex> lock(m_reload_callback_mutex);
+        m_reload_callbacks.push_back({ .id = m_next_reload_callback_id, .callback = callback });
         return m_next_reload_callback_id++;
     }
     
-    void Asset::deregister_reload_callback(usize callback_id)
+    void Asset::deregister_reload_callback(const usize callback_id)
     {
-        const std::lock_guard<std::mutex> lock(m_reload_callback_mutex);
-        m_reload_callbacks.erase(callback_id);
+        const std::lock_guard<std::recursive_mutex> lock(m_reload_callback_mutex);
+        
+        const auto callback_it = std::ranges::find(m_reload_callbacks, callback_id, &ReloadCallback::id);
+        if (callback_it == m_reload_callbacks.end())
+        {
+            return;
+        }
+        
+        if (m_dispatching_reload_callbacks)
+        {
+            callback_it->callback = nullptr;
+        }
+        else
+        {
+            m_reload_callbacks.erase(callback_it);
+        }
     }
     
     const AssetId & Asset::get_id() const
@@ -53,6 +84,11 @@ namespace mellohi
         return *m_asset_manager_ptr;
     }
     
+    void Asset::finalize()
+    {
+        
+    }
+    
     TextAsset::TextAsset(const std::shared_ptr<AssetManager> asset_manager_ptr, const AssetId &asset_id)
         : Asset(asset_manager_ptr, asset_id)
     {
@@ -75,13 +111,21 @@ namespace mellohi
         load();
     }
     
-    const std::vector<u8> & BinaryAsset::get_bytes() const
+    std::span<const u8> BinaryAsset::get_bytes() const
     {
-        return m_bytes;
+        return m_bytes_view;
     }
     
     void BinaryAsset::load()
     {
+        if (const auto archived_bytes_opt = get_id().get_archived_bytes())
+        {
+            m_bytes.clear();
+            m_bytes_view = archived_bytes_opt.value();
+            return;
+        }
+        
         m_bytes = get_id().read_file_as_bytes();
+        m_bytes_view = m_bytes;
     }
 }
@@ -0,0 +1,148 @@
+#include "mellohi/core/assets/asset_archive.hpp"
+
+#include <algorithm>
+
+#if defined(__linux__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "mellohi/core/assets/asset_id.hpp"
+#include "mellohi/core/logger.hpp"
+
+namespace mellohi
+{
+    AssetArchive::AssetArchive(const std::filesystem::path &file_path)
+    {
+        #if defined(__linux__) || defined(__APPLE__)
+            const auto fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+            {
+                MH_WARN("Failed to open asset archive {}.", file_path.string());
+                return;
+            }
+            
+            struct stat file_stat{};
+            if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+            {
+                void *data_ptr = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data_ptr != MAP_FAILED)
+                {
+                    m_data_ptr = static_cast<const u8 *>(data_ptr);
+                    m_size = file_stat.st_size;
+                }
+            }
+            
+            // The mapping stays valid after the descriptor is closed.
+            close(fd);
+            
+            if (!m_data_ptr)
+            {
+                MH_WARN("Failed to map asset archive {}.", file_path.string());
+                return;
+            }
+            
+            if (!validate(file_path))
+            {
+                unmap();
+                return;
+            }
+            
+            MH_INFO("Mounted asset archive {} with {} files.", file_path.string(), m_toc.size());
+        #else
+            MH_WARN("Asset archives are not supported on this platform. Ignoring {}.", file_path.string());
+        #endif
+    }
+    
+    AssetArchive::~AssetArchive()
+    {
+        unmap();
+    }
+    
+    bool AssetArchive::is_open() const
+    {
+        return m_data_ptr != nullptr;
+    }
+    
+    usize AssetArchive::get_entry_count() const
+    {
+        return m_toc.size();
+    }
+    
+    std::optional<std::span<const u8>> AssetArchive::find(const std::string_view fully_qualified_path) const
+    {
+        const auto hash = AssetId::hash_fully_qualified_path(fully_qualified_path);
+        
+        auto entry_it = std::ranges::lower_bound(m_toc, hash, {}, &ArchiveTocEntry::hash);
+        for (; entry_it != m_toc.end() && entry_it->hash == hash; ++entry_it)
+        {
+            const std::string_view entry_path(reinterpret_cast<const char *>(m_data_ptr + entry_it->path_offset),
+                                              entry_it->path_size);
+            if (entry_path == fully_qualified_path)
+            {
+                return std::span(m_data_ptr + entry_it->data_offset, entry_it->data_size);
+            }
+        }
+        
+        return std::nullopt;
+    }
+    
+    bool AssetArchive::validate(const std::filesystem::path &file_path)
+    {
+        const auto is_in_bounds = [this](const u64 offset, const u64 size)
+        {
+            return offset <= m_size && size <= m_size - offset;
+        };
+        
+        if (!is_in_bounds(0, sizeof(ArchiveHeader)))
+        {
+            MH_WARN("Asset archive {} is truncated.", file_path.string());
+            return false;
+        }
+        
+        const auto &header = *reinterpret_cast<const ArchiveHeader *>(m_data_ptr);
+        if (header.magic != ARCHIVE_MAGIC || header.version != ARCHIVE_VERSION)
+        {
+            MH_WARN("Asset archive {} has an unsupported format.", file_path.string());
+            return false;
+        }
+        
+        if (header.toc_offset % alignof(ArchiveTocEntry) != 0
+            || header.entry_count > m_size / sizeof(ArchiveTocEntry)
+            || !is_in_bounds(header.toc_offset, header.entry_count * sizeof(ArchiveTocEntry)))
+        {
+            MH_WARN("Asset archive {} has a corrupt table of contents.", file_path.string());
+            return false;
+        }
+        
+        m_toc = std::span(reinterpret_cast<const ArchiveTocEntry *>(m_data_ptr + header.toc_offset),
+                          header.entry_count);
+        
+        for (const auto &entry : m_toc)
+        {
+            if (!is_in_bounds(entry.path_offset, entry.path_size) || !is_in_bounds(entry.data_offset, entry.data_size))
+            {
+                MH_WARN("Asset archive {} has an entry outside of the file.", file_path.string());
+                return false;
+            }
+        }
+        
+        return true;
+    }
+    
+    void AssetArchive::unmap()
+    {
+        #if defined(__linux__) || defined(__APPLE__)
+            if (m_data_ptr)
+            {
+                munmap(const_cast<u8 *>(m_data_ptr), m_size);
+            }
+        #endif
+        
+        m_data_ptr = nullptr;
+        m_size = 0;
+        m_toc = {};
+    }
+}
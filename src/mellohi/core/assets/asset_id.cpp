@@ -1,7 +1,12 @@
 #include "mellohi/core/assets/asset_id.hpp"
 
+#include <deque>
 #include <fstream>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
 
+#include "mellohi/core/assets/virtual_file_system.hpp"
 #include "mellohi/core/logger.hpp"
 
 namespace mellohi
@@ -11,26 +16,25 @@ namespace mellohi
         const auto delimiter_pos = fully_qualified_path.find(':');
         if (delimiter_pos == std::string_view::npos)
         {
-            m_path = fully_qualified_path;
+            m_entry_ptr = &intern(make_fully_qualified_path("", fully_qualified_path), 0);
         }
         else
         {
-            m_package = fully_qualified_path.substr(0, delimiter_pos);
-            m_path = fully_qualified_path.substr(delimiter_pos + 1);
+            m_entry_ptr = &intern(fully_qualified_path, delimiter_pos);
         }
         
-        MH_ASSERT(file_exists(), "AssetId {} constructed, but its file does not exist.");
+        MH_ASSERT(file_exists(), "AssetId {} constructed, but its file does not exist.", *this);
     }
     
     AssetId::AssetId(const std::string_view package, const std::string_view path)
-        : m_package(package), m_path(path)
+        : m_entry_ptr(&intern(make_fully_qualified_path(package, path), package.size()))
     {
-        MH_ASSERT(file_exists(), "AssetId {} constructed, but its file does not exist.");
+        MH_ASSERT(file_exists(), "AssetId {} constructed, but its file does not exist.", *this);
     }
     
     bool AssetId::operator==(const AssetId &other) const
     {
-        return m_package == other.m_package && m_path == other.m_path;
+        return m_entry_ptr == other.m_entry_ptr;
     }
     
     bool AssetId::operator!=(const AssetId &other) const
@@ -40,7 +44,7 @@ namespace mellohi
     
     bool AssetId::operator<(const AssetId &other) const
     {
-        return get_fully_qualified_path() < other.get_fully_qualified_path();
+        return m_entry_ptr->handle < other.m_entry_ptr->handle;
     }
     
     bool AssetId::operator>(const AssetId &other) const
@@ -65,40 +69,59 @@ namespace mellohi
     
     const std::string & AssetId::get_package() const
     {
-        return m_package;
+        return m_entry_ptr->package;
     }
     
     const std::string & AssetId::get_path() const
     {
-        return m_path;
+        return m_entry_ptr->path;
     }
     
-    std::string AssetId::get_fully_qualified_path() const
+    const std::string & AssetId::get_fully_qualified_path() const
     {
-        return m_package + ":" + m_path;
+        return m_entry_ptr->fully_qualified_path;
+    }
+    
+    u32 AssetId::get_handle() const
+    {
+        return m_entry_ptr->handle;
+    }
+    
+    u64 AssetId::get_hash() const
+    {
+        return m_entry_ptr->hash;
     }
     
     std::filesystem::path AssetId::as_file_path() const
     {
-        const auto path = std::filesystem::path(MH_GAME_ASSETS_DIR) / m_package / m_path;
-        if (std::filesystem::exists(path))
+        if (auto file_path_opt = VirtualFileSystem::get().resolve(get_fully_qualified_path()))
         {
-            return path;
+            return std::move(file_path_opt.value());
         }
         
-        return std::filesystem::path(MH_ENGINE_ASSETS_DIR) / m_package / m_path;
+        return std::filesystem::path(MH_ENGINE_ASSETS_DIR) / get_package() / get_path();
     }
     
     bool AssetId::file_exists() const
     {
-        return std::filesystem::exists(as_file_path());
+        const auto &virtual_file_system = VirtualFileSystem::get();
+        return virtual_file_system.resolve(get_fully_qualified_path()).has_value()
+            || virtual_file_system.find_archived(get_fully_qualified_path()).has_value();
     }
     
     std::string AssetId::read_file_as_string() const
     {
-        MH_ASSERT(file_exists(), "AssetId {} points to a file that does not exist. Cannot read as string.", *this);
+        const auto file_path_opt = VirtualFileSystem::get().resolve(get_fully_qualified_path());
+        if (!file_path_opt.has_value())
+        {
+            const auto bytes_opt = VirtualFileSystem::get().find_archived(get_fully_qualified_path());
+            MH_ASSERT(bytes_opt.has_value(),
+                      "AssetId {} points to a file that does not exist. Cannot read as string.", *this);
+            
+            return {reinterpret_cast<const char *>(bytes_opt->data()), bytes_opt->size()};
+        }
         
-        std::ifstream ifs(as_file_path());
+        std::ifstream ifs(file_path_opt.value());
         std::string content((std::istreambuf_iterator(ifs)), (std::istreambuf_iterator<char>()));
         
         return content;
@@ -106,9 +129,17 @@ namespace mellohi
     
     std::vector<u8> AssetId::read_file_as_bytes() const
     {
-        MH_ASSERT(file_exists(), "AssetId {} points to a file that does not exist. Cannot read as bytes.", *this);
+        const auto file_path_opt = VirtualFileSystem::get().resolve(get_fully_qualified_path());
+        if (!file_path_opt.has_value())
+        {
+            const auto bytes_opt = VirtualFileSystem::get().find_archived(get_fully_qualified_path());
+            MH_ASSERT(bytes_opt.has_value(),
+                      "AssetId {} points to a file that does not exist. Cannot read as bytes.", *this);
+            
+            return {bytes_opt->begin(), bytes_opt->end()};
+        }
         
-        std::ifstream ifs(as_file_path(), std::ios::binary | std::ios::ate);
+        std::ifstream ifs(file_path_opt.value(), std::ios::binary | std::ios::ate);
         
         const auto size = ifs.tellg();
         
@@ -118,4 +149,65 @@ namespace mellohi
         
         return content;
     }
+    
+    std::optional<std::span<const u8>> AssetId::get_archived_bytes() const
+    {
+        const auto &virtual_file_system = VirtualFileSystem::get();
+        if (virtual_file_system.resolve(get_fully_qualified_path()).has_value())
+        {
+            return std::nullopt;
+        }
+        
+        return virtual_file_system.find_archived(get_fully_qualified_path());
+    }
+    
+    std::string AssetId::make_fully_qualified_path(const std::string_view package, const std::string_view path)
+    {
+        std::string fully_qualified_path;
+        fully_qualified_path.reserve(package.size() + 1 + path.size());
+        fully_qualified_path.append(package).append(":").append(path);
+        
+        return fully_qualified_path;
+    }
+    
+    // Looks the path up without copying it, so that constructing an existing id from its fully qualified path never
+    // allocates.
+    const AssetId::Entry & AssetId::intern(const std::string_view fully_qualified_path, const usize delimiter_pos)
+    {
+        // Entries live in a deque so that pointers to them stay valid as the table grows. They are never removed.
+        static std::deque<Entry> entries;
+        static std::unordered_map<std::string, const Entry *, TransparentStringHash, std::equal_to<>> entries_by_path;
+        static std::shared_mutex mutex;
+        
+        {
+            const std::shared_lock<std::shared_mutex> lock(mutex);
+            
+            const auto entry_it = entries_by_path.find(fully_qualified_path);
+            if (entry_it != entries_by_path.end())
+            {
+                return *entry_it->second;
+            }
+        }
+        
+        const std::unique_lock<std::shared_mutex> lock(mutex);
+        
+        // Another thread may have interned the same id between the two locks.
+        const auto entry_it = entries_by_path.find(fully_qualified_path);
+        if (entry_it != entries_by_path.end())
+        {
+            return *entry_it->second;
+        }
+        
+        const auto &entry = entries.emplace_back(Entry
+        {
+            .package = std::string(fully_qualified_path.substr(0, delimiter_pos)),
+            .path = std::string(fully_qualified_path.substr(delimiter_pos + 1)),
+            .fully_qualified_path = std::string(fully_qualified_path),
+            .handle = static_cast<u32>(entries.size()),
+            .hash = hash_fully_qualified_path(fully_qualified_path),
+        });
+        entries_by_path.emplace(entry.fully_qualified_path, &entry);
+        
+        return entry;
+    }
 }
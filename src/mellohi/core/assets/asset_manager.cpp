@@ -1,26 +1,319 @@
 #include "mellohi/core/assets/asset_manager.hpp"
 
+#include <latch>
+
 namespace mellohi
 {
     AssetManager::AssetManager()
+        : m_main_thread_id(std::this_thread::get_id()),
+          m_asset_watcher(VirtualFileSystem::get().get_root_dirs())
     {
         MH_INFO("Game Assets Dir: {}", MH_GAME_ASSETS_DIR);
         MH_INFO("Engine Assets Dir: {}", MH_ENGINE_ASSETS_DIR);
+        MH_INFO("Asset loading threads: {}", m_thread_pool.get_thread_count());
+    }
+    
+    void AssetManager::process_main_thread_tasks()
+    {
+        MH_ASSERT_DEBUG(is_main_thread(), "Main thread asset tasks must be processed on the main thread.");
+        
+        std::deque<std::function<void()>> main_thread_tasks;
+        {
+            const std::lock_guard<std::mutex> lock(m_main_thread_tasks_mutex);
+            main_thread_tasks.swap(m_main_thread_tasks);
+        }
+        
+        for (const auto &task : main_thread_tasks)
+        {
+            task();
+        }
+    }
+    
+    void AssetManager::reload_changed()
+    {
+        const auto changed_asset_ids_opt = m_asset_watcher.poll_changed_asset_ids();
+        if (!changed_asset_ids_opt.has_value())
+        {
+            reload_all();
+            return;
+        }
+        
+        std::vector<std::shared_ptr<Asset>> assets;
+        {
+            const std::lock_guard<std::mutex> lock(m_assets_mutex);
+            
+            for (const auto &asset_id : changed_asset_ids_opt.value())
+            {
+                if (auto asset_ptr = find_loaded_asset(asset_id))
+                {
+                    assets.push_back(std::move(asset_ptr));
+                }
+            }
+        }
+        
+        for (const auto &asset_ptr : assets)
+        {
+            MH_TRACE("Asset {} changed on disk.", asset_ptr->get_id());
+        }
+        
+        reload_assets(assets);
     }
     
     void AssetManager::reload_all()
     {
-        for (auto it = m_assets.begin(); it != m_assets.end(); )
+        std::vector<std::shared_ptr<Asset>> assets;
         {
-            if (it->second.expired())
+            const std::lock_guard<std::mutex> lock(m_assets_mutex);
+            
+            for (auto it = m_assets.begin(); it != m_assets.end(); )
             {
-                it = m_assets.erase(it);
-                continue;
+                if (auto asset_ptr = it->second.lock())
+                {
+                    assets.push_back(std::move(asset_ptr));
+                    ++it;
+                }
+                else
+                {
+                    it = m_assets.erase(it);
+                }
+            }
+        }
+        
+        // Reloading may load new assets, so it happens outside the lock.
+        reload_assets(assets);
+    }
+    
+    void AssetManager::reload(const AssetId &asset_id)
+    {
+        std::shared_ptr<Asset> asset_ptr;
+        {
+            const std::lock_guard<std::mutex> lock(m_assets_mutex);
+            asset_ptr = find_loaded_asset(asset_id);
+        }
+        
+        MH_ASSERT(asset_ptr, "Asset {} cannot be reloaded because it was not loaded through the asset manager.",
+                  asset_id);
+        reload_assets({ asset_ptr });
+    }
+    
+    void AssetManager::set_dependencies(const AssetId &dependent_id, const std::vector<AssetId> &dependency_ids)
+    {
+        const std::lock_guard<std::mutex> lock(m_dependencies_mutex);
+        
+        if (const auto dependencies_it = m_dependencies.find(dependent_id); dependencies_it != m_dependencies.end())
+        {
+            for (const auto &dependency_id : dependencies_it->second)
+            {
+                auto &dependents = m_dependents[dependency_id];
+                std::erase(dependents, dependent_id);
+                
+                if (dependents.empty())
+                {
+                    m_dependents.erase(dependency_id);
+                }
             }
             
-            it->second.lock()->reload();
+            m_dependencies.erase(dependencies_it);
+        }
+        
+        if (dependency_ids.empty())
+        {
+            return;
+        }
+        
+        for (const auto &dependency_id : dependency_ids)
+        {
+            auto &dependents = m_dependents[dependency_id];
+            if (std::ranges::find(dependents, dependent_id) == dependents.end())
+            {
+                dependents.push_back(dependent_id);
+            }
+        }
+        
+        m_dependencies.emplace(dependent_id, dependency_ids);
+    }
+    
+    void AssetManager::submit_background_task(std::function<void()> &&task)
+    {
+        m_thread_pool.submit(std::move(task));
+    }
+    
+    bool AssetManager::is_main_thread() const
+    {
+        return std::this_thread::get_id() == m_main_thread_id;
+    }
+    
+    std::shared_ptr<Asset> AssetManager::find_loaded_asset(const AssetId &asset_id) const
+    {
+        const auto asset_it = m_assets.find(asset_id);
+        if (asset_it == m_assets.end())
+        {
+            return nullptr;
+        }
+        
+        return asset_it->second.lock();
+    }
+    
+    void AssetManager::run_pending_load(const std::shared_ptr<PendingLoad> &pending_load_ptr)
+    {
+        // Whichever of the worker task or a thread waiting on the load gets here first does the work.
+        if (pending_load_ptr->claimed.test_and_set())
+        {
+            return;
+        }
+        
+        const auto asset_ptr = pending_load_ptr->construct();
+        pending_load_ptr->construct = nullptr;
+        
+        const auto finish = [this, pending_load_ptr, asset_ptr]
+        {
+            asset_ptr->finalize();
+            
+            {
+                const std::lock_guard<std::mutex> lock(m_assets_mutex);
+                m_assets[pending_load_ptr->asset_id] = asset_ptr;
+                m_pending_loads.erase(pending_load_ptr->asset_id);
+            }
+            
+            pending_load_ptr->loaded_promise.set_value(asset_ptr);
+        };
+        
+        pending_load_ptr->constructed_promise.set_value(asset_ptr);
+        
+        if (is_main_thread())
+        {
+            finish();
+        }
+        else
+        {
+            // Main thread tasks run in submission order, so anything this asset loaded while constructing is
+            // finalized before it is.
+            push_main_thread_task(finish);
+        }
+    }
+    
+    std::shared_ptr<Asset> AssetManager::wait_for_pending_load(const std::shared_ptr<PendingLoad> &pending_load_ptr)
+    {
+        // Running the load here if no worker has picked it up yet keeps workers that wait on each other from
+        // exhausting the pool.
+        run_pending_load(pending_load_ptr);
+        
+        if (!is_main_thread())
+        {
+            return pending_load_ptr->constructed_future.get();
+        }
+        
+        const auto &loaded_future = pending_load_ptr->loaded_future;
+        while (loaded_future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            process_main_thread_tasks();
+            std::this_thread::yield();
+        }
+        
+        return loaded_future.get();
+    }
+    
+    void AssetManager::reload_assets(const std::vector<std::shared_ptr<Asset>> &assets)
+    {
+        MH_ASSERT_DEBUG(is_main_thread(), "Assets must be reloaded on the main thread.");
+        
+        if (assets.empty())
+        {
+            return;
+        }
+        
+        if (assets.size() == 1)
+        {
+            assets.front()->load();
+        }
+        else
+        {
+            // Reading and parsing (including shader compilation) fans out across the workers. Nothing else touches
+            // the assets meanwhile, since the main thread is blocked here.
+            std::latch loads_remaining(static_cast<std::ptrdiff_t>(assets.size()));
+            for (const auto &asset_ptr : assets)
+            {
+                m_thread_pool.submit([asset_ptr, &loads_remaining]
+                {
+                    asset_ptr->load();
+                    loads_remaining.count_down();
+                });
+            }
+            loads_remaining.wait();
+        }
+        
+        // Assets loaded for the first time by the loads above must be finalized before anything that uses them.
+        process_main_thread_tasks();
+        
+        // Sorted after loading, since loading can change what an asset depends on.
+        const auto batch = sort_reload_batch(assets);
+        
+        for (const auto &asset_ptr : batch)
+        {
+            asset_ptr->finalize();
+        }
+        
+        for (const auto &asset_ptr : batch)
+        {
+            asset_ptr->notify_reloaded();
+        }
+    }
+    
+    // Returns the reloaded assets plus everything that transitively depends on them, each once, ordered so that every
+    // asset comes after its dependencies.
+    std::vector<std::shared_ptr<Asset>> AssetManager::sort_reload_batch(
+        const std::vector<std::shared_ptr<Asset>> &assets)
+    {
+        enum class VisitState : u8
+        {
+            Visiting,
+            Visited,
+        };
+        
+        std::unordered_map<AssetId, VisitState> visit_states;
+        std::vector<std::shared_ptr<Asset>> reverse_sorted_batch;
+        
+        const std::scoped_lock lock(m_assets_mutex, m_dependencies_mutex);
+        
+        // Depth-first over dependents; an asset is emitted only once everything depending on it has been.
+        const auto visit = [&](const auto &self, const std::shared_ptr<Asset> &asset_ptr) -> void
+        {
+            const auto [visit_state_it, inserted] = visit_states.try_emplace(asset_ptr->get_id(),
+                                                                             VisitState::Visiting);
+            if (!inserted)
+            {
+                MH_ASSERT(visit_state_it->second == VisitState::Visited,
+                          "Asset {} depends on itself through its dependencies.", asset_ptr->get_id());
+                return;
+            }
+            
+            if (const auto dependents_it = m_dependents.find(asset_ptr->get_id()); dependents_it != m_dependents.end())
+            {
+                for (const auto &dependent_id : dependents_it->second)
+                {
+                    if (const auto dependent_ptr = find_loaded_asset(dependent_id))
+                    {
+                        self(self, dependent_ptr);
+                    }
+                }
+            }
             
-            ++it;
+            visit_states[asset_ptr->get_id()] = VisitState::Visited;
+            reverse_sorted_batch.push_back(asset_ptr);
+        };
+        
+        for (const auto &asset_ptr : assets)
+        {
+            visit(visit, asset_ptr);
         }
+        
+        std::ranges::reverse(reverse_sorted_batch);
+        return reverse_sorted_batch;
+    }
+    
+    void AssetManager::push_main_thread_task(std::function<void()> &&task)
+    {
+        const std::lock_guard<std::mutex> lock(m_main_thread_tasks_mutex);
+        m_main_thread_tasks.push_back(std::move(task));
     }
 }
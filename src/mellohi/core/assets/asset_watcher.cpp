@@ -0,0 +1,203 @@
+#include "mellohi/core/assets/asset_watcher.hpp"
+
+#include <unordered_set>
+
+#ifdef __linux__
+    #include <sys/inotify.h>
+    #include <unistd.h>
+#endif
+
+#include "mellohi/core/assets/virtual_file_system.hpp"
+#include "mellohi/core/logger.hpp"
+
+namespace mellohi
+{
+    AssetWatcher::AssetWatcher(const std::vector<std::filesystem::path> &root_dirs)
+    {
+        #ifdef __linux__
+            m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if (m_inotify_fd < 0)
+            {
+                MH_WARN("Failed to initialize inotify. Asset hot reloading is disabled.");
+                return;
+            }
+            
+            for (const auto &root_dir : root_dirs)
+            {
+                add_watch_recursive(root_dir, root_dir);
+            }
+        #else
+            MH_WARN("Asset hot reloading is not supported on this platform.");
+        #endif
+    }
+    
+    AssetWatcher::~AssetWatcher()
+    {
+        #ifdef __linux__
+            if (m_inotify_fd >= 0)
+            {
+                close(m_inotify_fd);
+            }
+        #endif
+    }
+    
+    std::optional<std::vector<AssetId>> AssetWatcher::poll_changed_asset_ids()
+    {
+        std::unordered_set<AssetId> changed_asset_ids;
+        
+        #ifdef __linux__
+            if (m_inotify_fd < 0)
+            {
+                return std::vector<AssetId>{};
+            }
+            
+            bool overflowed = false;
+            bool dir_removed = false;
+            
+            alignas(inotify_event) char buffer[4096];
+            while (true)
+            {
+                const auto length = read(m_inotify_fd, buffer, sizeof(buffer));
+                if (length <= 0)
+                {
+                    break;
+                }
+                
+                for (auto event_ptr = buffer; event_ptr < buffer + length; )
+                {
+                    const auto &event = *reinterpret_cast<const inotify_event *>(event_ptr);
+                    event_ptr += sizeof(inotify_event) + event.len;
+                    
+                    if (event.mask & IN_Q_OVERFLOW)
+                    {
+                        overflowed = true;
+                        continue;
+                    }
+                    
+                    const auto watched_dir_it = m_watched_dirs.find(event.wd);
+                    if (watched_dir_it == m_watched_dirs.end())
+                    {
+                        continue;
+                    }
+                    
+                    if (event.mask & IN_IGNORED)
+                    {
+                        m_watched_dirs.erase(watched_dir_it);
+                        continue;
+                    }
+                    
+                    if (event.len == 0)
+                    {
+                        continue;
+                    }
+                    
+                    // Copied, since adding watches below may replace the entry.
+                    const auto [root_dir, dir] = watched_dir_it->second;
+                    const auto path = dir / event.name;
+                    
+                    if (event.mask & IN_ISDIR)
+                    {
+                        if (event.mask & (IN_DELETE | IN_MOVED_FROM))
+                        {
+                            dir_removed = true;
+                            continue;
+                        }
+                        
+                        add_watch_recursive(root_dir, path);
+                        
+                        // Files moved in with the directory, or written before its watch was added, never produce
+                        // their own events.
+                        std::error_code error_code;
+                        for (const auto &entry : std::filesystem::recursive_directory_iterator(path, error_code))
+                        {
+                            if (const auto asset_id_opt = refresh_file(root_dir, entry.path()))
+                            {
+                                changed_asset_ids.insert(asset_id_opt.value());
+                            }
+                        }
+                        continue;
+                    }
+                    
+                    // Deleted and newly created files only need the index updated; creation is followed by a
+                    // close-write once the file has its contents.
+                    const auto asset_id_opt = refresh_file(root_dir, path);
+                    if (asset_id_opt.has_value() && (event.mask & (IN_CLOSE_WRITE | IN_MOVED_TO)))
+                    {
+                        changed_asset_ids.insert(asset_id_opt.value());
+                    }
+                }
+            }
+            
+            if (overflowed)
+            {
+                MH_WARN("Asset watcher lost track of changes.");
+                VirtualFileSystem::get().rescan();
+                return std::nullopt;
+            }
+            
+            // Files removed along with a directory never produce their own events.
+            if (dir_removed)
+            {
+                VirtualFileSystem::get().rescan();
+            }
+        #endif
+        
+        return std::vector<AssetId>(changed_asset_ids.begin(), changed_asset_ids.end());
+    }
+    
+    void AssetWatcher::add_watch_recursive(const std::filesystem::path &root_dir, const std::filesystem::path &dir)
+    {
+        std::error_code error_code;
+        if (!std::filesystem::is_directory(dir, error_code))
+        {
+            return;
+        }
+        
+        add_watch(root_dir, dir);
+        
+        for (const auto &entry : std::filesystem::recursive_directory_iterator(dir, error_code))
+        {
+            if (entry.is_directory(error_code))
+            {
+                add_watch(root_dir, entry.path());
+            }
+        }
+    }
+    
+    void AssetWatcher::add_watch(const std::filesystem::path &root_dir, const std::filesystem::path &dir)
+    {
+        #ifdef __linux__
+            const auto watch_descriptor = inotify_add_watch(m_inotify_fd, dir.c_str(),
+                                                            IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE
+                                                            | IN_MOVED_FROM | IN_ONLYDIR);
+            if (watch_descriptor < 0)
+            {
+                MH_WARN("Failed to watch asset directory {}.", dir.string());
+                return;
+            }
+            
+            m_watched_dirs.insert_or_assign(watch_descriptor, WatchedDir{root_dir, dir});
+        #endif
+    }
+    
+    std::optional<AssetId> AssetWatcher::refresh_file(const std::filesystem::path &root_dir,
+                                                      const std::filesystem::path &file_path)
+    {
+        const auto fully_qualified_path_opt = VirtualFileSystem::to_fully_qualified_path(root_dir, file_path);
+        if (!fully_qualified_path_opt.has_value())
+        {
+            return std::nullopt;
+        }
+        
+        auto &virtual_file_system = VirtualFileSystem::get();
+        virtual_file_system.refresh(fully_qualified_path_opt.value());
+        
+        // Editors commonly write through temporary files that are gone by the time we see the event.
+        if (!virtual_file_system.resolve(fully_qualified_path_opt.value()).has_value())
+        {
+            return std::nullopt;
+        }
+        
+        return AssetId(fully_qualified_path_opt.value());
+    }
+}
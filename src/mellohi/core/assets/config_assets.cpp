@@ -6,6 +6,24 @@
 
 namespace mellohi
 {
+    std::optional<LatencyMode> latency_mode_from_string(const std::string_view str)
+    {
+        if (str == "low_latency")
+        {
+            return LatencyMode::LowLatency;
+        }
+        else if (str == "balanced")
+        {
+            return LatencyMode::Balanced;
+        }
+        else if (str == "throughput")
+        {
+            return LatencyMode::Throughput;
+        }
+        
+        return std::nullopt;
+    }
+    
     GameConfigAsset::GameConfigAsset(const std::shared_ptr<AssetManager> asset_manager_ptr, const AssetId &asset_id)
         : TomlAsset(asset_manager_ptr, asset_id)
     {
@@ -47,6 +65,16 @@ namespace mellohi
         return m_window.vsync_opt;
     }
 
+    std::optional<u32> GameConfigAsset::get_graphics_frames_in_flight_opt() const
+    {
+        return m_graphics.frames_in_flight_opt;
+    }
+
+    std::optional<LatencyMode> GameConfigAsset::get_graphics_latency_mode_opt() const
+    {
+        return m_graphics.latency_mode_opt;
+    }
+
     void GameConfigAsset::load()
     {
         MH_ASSERT(get_id() == AssetId(":game.toml"), "Game config must be at :game.toml, not {}.", get_id());
@@ -61,12 +89,20 @@ namespace mellohi
         m_window.resizable_opt = parse_opt<bool>(table, "window.resizable");
         m_window.title_opt = parse_opt<std::string>(table, "window.title");
         m_window.vsync_opt = parse_opt<bool>(table, "window.vsync");
+
+        m_graphics.frames_in_flight_opt = parse_opt<u32>(table, "graphics.frames_in_flight");
+
+        const auto latency_mode_str_opt = parse_opt<std::string>(table, "graphics.latency_mode");
+        m_graphics.latency_mode_opt = latency_mode_str_opt.and_then(latency_mode_from_string);
+        MH_ASSERT(!latency_mode_str_opt.has_value() || m_graphics.latency_mode_opt.has_value(),
+                  "{} has unknown graphics.latency_mode {}.", get_id(), latency_mode_str_opt.value_or(""));
     }
 
     EngineConfigAsset::EngineConfigAsset(const std::shared_ptr<AssetManager> asset_manager_ptr, const AssetId &asset_id)
         : TomlAsset(asset_manager_ptr, asset_id)
     {
         m_game_config = asset_manager_ptr->load<GameConfigAsset>(AssetId(":game.toml"));
+        asset_manager_ptr->set_dependencies(asset_id, {m_game_config->get_id()});
 
         load();
     }
@@ -116,6 +152,16 @@ namespace mellohi
         return m_game_config->get_window_vsync_opt().value_or(m_window.vsync);
     }
 
+    u32 EngineConfigAsset::get_graphics_frames_in_flight() const
+    {
+        return m_game_config->get_graphics_frames_in_flight_opt().value_or(m_graphics.frames_in_flight);
+    }
+
+    LatencyMode EngineConfigAsset::get_graphics_latency_mode() const
+    {
+        return m_game_config->get_graphics_latency_mode_opt().value_or(m_graphics.latency_mode);
+    }
+
     void EngineConfigAsset::load()
     {
         MH_ASSERT(get_id() == AssetId(":engine.toml"), "Engine config must be at :engine.toml, not {}.", get_id());
@@ -130,5 +176,12 @@ namespace mellohi
         m_window.resizable = parse<bool>(table, "window.resizable", "bool");
         m_window.title = parse<std::string>(table, "window.title", "string");
         m_window.vsync = parse<bool>(table, "window.vsync", "bool");
+
+        m_graphics.frames_in_flight = parse<u32>(table, "graphics.frames_in_flight", "u32");
+
+        const auto latency_mode_str = parse<std::string>(table, "graphics.latency_mode", "string");
+        const auto latency_mode_opt = latency_mode_from_string(latency_mode_str);
+        MH_ASSERT(latency_mode_opt.has_value(), "{} has unknown graphics.latency_mode {}.", get_id(), latency_mode_str);
+        m_graphics.latency_mode = latency_mode_opt.value();
     }
 }
@@ -0,0 +1,144 @@
+#include "mellohi/core/assets/virtual_file_system.hpp"
+
+#include <mutex>
+
+#include "mellohi/core/logger.hpp"
+
+namespace mellohi
+{
+    VirtualFileSystem & VirtualFileSystem::get()
+    {
+        static VirtualFileSystem virtual_file_system({MH_GAME_ASSETS_DIR, MH_ENGINE_ASSETS_DIR});
+        return virtual_file_system;
+    }
+    
+    VirtualFileSystem::VirtualFileSystem(std::vector<std::filesystem::path> root_dirs)
+        : m_root_dirs(std::move(root_dirs))
+    {
+        #ifdef MH_ASSET_ARCHIVE_PATH
+            m_archive_ptr = std::make_unique<AssetArchive>(MH_ASSET_ARCHIVE_PATH);
+            if (!m_archive_ptr->is_open())
+            {
+                m_archive_ptr.reset();
+            }
+        #endif
+        
+        rescan();
+    }
+    
+    std::optional<std::filesystem::path> VirtualFileSystem::resolve(const std::string_view fully_qualified_path) const
+    {
+        const std::shared_lock<std::shared_mutex> lock(m_files_mutex);
+        
+        const auto file_it = m_files.find(fully_qualified_path);
+        if (file_it == m_files.end())
+        {
+            return std::nullopt;
+        }
+        
+        return file_it->second;
+    }
+    
+    std::optional<std::span<const u8>> VirtualFileSystem::find_archived(
+        const std::string_view fully_qualified_path) const
+    {
+        // The archive is immutable, so it needs no locking.
+        if (!m_archive_ptr)
+        {
+            return std::nullopt;
+        }
+        
+        return m_archive_ptr->find(fully_qualified_path);
+    }
+    
+    void VirtualFileSystem::refresh(const std::string_view fully_qualified_path)
+    {
+        const auto delimiter_pos = fully_qualified_path.find(':');
+        MH_ASSERT_DEBUG(delimiter_pos != std::string_view::npos, "{} is not a fully qualified asset path.",
+                        fully_qualified_path);
+        
+        const auto package = fully_qualified_path.substr(0, delimiter_pos);
+        const auto path = fully_qualified_path.substr(delimiter_pos + 1);
+        
+        std::optional<std::filesystem::path> file_path_opt;
+        for (const auto &root_dir : m_root_dirs)
+        {
+            auto file_path = root_dir / package / path;
+            
+            std::error_code error_code;
+            if (std::filesystem::is_regular_file(file_path, error_code))
+            {
+                file_path_opt = std::move(file_path);
+                break;
+            }
+        }
+        
+        const std::unique_lock<std::shared_mutex> lock(m_files_mutex);
+        
+        if (file_path_opt.has_value())
+        {
+            m_files.insert_or_assign(std::string(fully_qualified_path), std::move(file_path_opt.value()));
+        }
+        else if (const auto file_it = m_files.find(fully_qualified_path); file_it != m_files.end())
+        {
+            m_files.erase(file_it);
+        }
+    }
+    
+    void VirtualFileSystem::rescan()
+    {
+        std::unordered_map<std::string, std::filesystem::path, TransparentStringHash, std::equal_to<>> files;
+        
+        for (const auto &root_dir : m_root_dirs)
+        {
+            std::error_code error_code;
+            for (const auto &entry : std::filesystem::recursive_directory_iterator(root_dir, error_code))
+            {
+                if (!entry.is_regular_file(error_code))
+                {
+                    continue;
+                }
+                
+                if (auto fully_qualified_path_opt = to_fully_qualified_path(root_dir, entry.path()))
+                {
+                    // Roots are scanned from highest priority, so the first file seen for a path wins.
+                    files.try_emplace(std::move(fully_qualified_path_opt.value()), entry.path());
+                }
+            }
+        }
+        
+        MH_INFO("Indexed {} asset files.", files.size());
+        
+        const std::unique_lock<std::shared_mutex> lock(m_files_mutex);
+        m_files = std::move(files);
+    }
+    
+    const std::vector<std::filesystem::path> & VirtualFileSystem::get_root_dirs() const
+    {
+        return m_root_dirs;
+    }
+    
+    std::optional<std::string> VirtualFileSystem::to_fully_qualified_path(const std::filesystem::path &root_dir,
+                                                                          const std::filesystem::path &file_path)
+    {
+        const auto relative_path = file_path.lexically_relative(root_dir);
+        if (relative_path.empty() || *relative_path.begin() == "..")
+        {
+            return std::nullopt;
+        }
+        
+        const auto first_it = relative_path.begin();
+        if (std::next(first_it) == relative_path.end())
+        {
+            return ":" + relative_path.generic_string();
+        }
+        
+        std::filesystem::path path_in_package;
+        for (auto it = std::next(first_it); it != relative_path.end(); ++it)
+        {
+            path_in_package /= *it;
+        }
+        
+        return first_it->string() + ":" + path_in_package.generic_string();
+    }
+}
@@ -17,6 +17,8 @@ namespace mellohi
         while (!m_platform_ptr->close_requested())
         {
             m_platform_ptr->process_events();
+            m_asset_manager_ptr->process_main_thread_tasks();
+            m_asset_manager_ptr->reload_changed();
             
             game.process(*this);
             
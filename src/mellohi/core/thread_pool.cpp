@@ -0,0 +1,71 @@
+#include "mellohi/core/thread_pool.hpp"
+
+#include "mellohi/core/logger.hpp"
+
+namespace mellohi
+{
+    ThreadPool::ThreadPool(const usize thread_count)
+    {
+        MH_ASSERT(thread_count > 0, "ThreadPool must have at least one thread.");
+        
+        m_threads.reserve(thread_count);
+        for (usize i = 0; i < thread_count; ++i)
+        {
+            m_threads.emplace_back(std::bind_front(&ThreadPool::worker_loop, this));
+        }
+    }
+    
+    ThreadPool::~ThreadPool()
+    {
+        // Threads must be stopped and joined before the task queue they wait on is destroyed. Workers drain the queue
+        // before they stop, since a pending load or future waiting on a queued task would otherwise never complete.
+        for (auto &thread : m_threads)
+        {
+            thread.request_stop();
+        }
+        m_threads.clear();
+    }
+    
+    void ThreadPool::submit(std::function<void()> &&task)
+    {
+        {
+            const std::lock_guard<std::mutex> lock(m_tasks_mutex);
+            m_tasks.push_back(std::move(task));
+        }
+        m_tasks_condition.notify_one();
+    }
+    
+    usize ThreadPool::get_thread_count() const
+    {
+        return m_threads.size();
+    }
+    
+    usize ThreadPool::get_default_thread_count()
+    {
+        const usize hardware_thread_count = std::thread::hardware_concurrency();
+        return hardware_thread_count > 1 ? hardware_thread_count - 1 : 1;
+    }
+    
+    void ThreadPool::worker_loop(const std::stop_token stop_token)
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_tasks_mutex);
+                m_tasks_condition.wait(lock, stop_token, [this] { return !m_tasks.empty(); });
+                
+                // Only returns once stopping with nothing left to run, including tasks that running ones submitted.
+                if (m_tasks.empty())
+                {
+                    return;
+                }
+                
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            
+            task();
+        }
+    }
+}
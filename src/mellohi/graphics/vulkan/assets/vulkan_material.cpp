@@ -1,208 +1,157 @@
 #include "mellohi/graphics/vulkan/assets/vulkan_material.hpp"
 
+#include "mellohi/core/logger.hpp"
+
 namespace mellohi
 {
+    static std::optional<vk::CullModeFlags> cull_mode_from_string(const std::string_view str)
+    {
+        if (str == "none")
+        {
+            return vk::CullModeFlagBits::eNone;
+        }
+        else if (str == "front")
+        {
+            return vk::CullModeFlagBits::eFront;
+        }
+        else if (str == "back")
+        {
+            return vk::CullModeFlagBits::eBack;
+        }
+        
+        return std::nullopt;
+    }
+    
+    static std::atomic<u32> next_material_id = 0;
+    
     VulkanMaterial::VulkanMaterial(const std::shared_ptr<AssetManager> asset_manager_ptr, const AssetId &asset_id,
                                    const std::shared_ptr<Device> device_ptr,
-                                   const std::shared_ptr<RenderPass> render_pass_ptr)
-        : Material(asset_manager_ptr, asset_id), m_device_ptr(device_ptr), m_render_pass_ptr(render_pass_ptr)
+                                   const std::shared_ptr<RenderPass> render_pass_ptr,
+                                   const std::shared_ptr<GraphicsPipelineCache> graphics_pipeline_cache_ptr)
+        : Material(asset_manager_ptr, asset_id), m_device_ptr(device_ptr), m_render_pass_ptr(render_pass_ptr),
+          m_graphics_pipeline_cache_ptr(graphics_pipeline_cache_ptr), m_material_id(next_material_id++)
     {
         load();
     }
     
     VulkanMaterial::~VulkanMaterial()
     {
-        m_frag_shader_ptr->deregister_reload_callback(m_on_frag_shader_reloaded_id);
-        m_vert_shader_ptr->deregister_reload_callback(m_on_vert_shader_reloaded_id);
-        
-        m_device_ptr->push_to_deletion_queue(
-            std::bind(&Device::destroy_pipeline, m_device_ptr, m_graphics_pipeline)
-        );
+        // The build may still be reading the shader modules.
+        if (m_pending_graphics_pipeline.valid())
+        {
+            m_pending_graphics_pipeline.wait();
+        }
     }
     
     void VulkanMaterial::bind()
     {
-        if (m_should_be_recreated)
+        update_graphics_pipeline();
+        m_render_pass_ptr->bind_graphics_pipeline(m_graphics_pipeline_ptr->get_pipeline());
+    }
+    
+    void VulkanMaterial::bind(const vk::CommandBuffer command_buffer) const
+    {
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_graphics_pipeline_ptr->get_pipeline());
+    }
+    
+    void VulkanMaterial::update_graphics_pipeline()
+    {
+        if (m_pending_graphics_pipeline.valid() &&
+            m_pending_graphics_pipeline.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
         {
-            reload();
+            m_graphics_pipeline_ptr = m_pending_graphics_pipeline.get();
         }
-        
-        m_render_pass_ptr->bind_graphics_pipeline(m_graphics_pipeline);
+    }
+    
+    const GraphicsPipeline & VulkanMaterial::get_graphics_pipeline() const
+    {
+        return *m_graphics_pipeline_ptr;
+    }
+    
+    u32 VulkanMaterial::get_material_id() const
+    {
+        return m_material_id;
     }
     
     void VulkanMaterial::load()
     {
-        m_should_be_recreated = false;
+        const auto table = parse_toml_table();
         
-        if (m_graphics_pipeline)
-        {
-            m_device_ptr->push_to_deletion_queue(
-                std::bind(&Device::destroy_pipeline, m_device_ptr, m_graphics_pipeline)
-            );
-        }
+        const auto cull_mode_str_opt = parse_opt<std::string>(table, "cull_mode");
+        const auto cull_mode_opt = cull_mode_str_opt.and_then(cull_mode_from_string);
+        MH_ASSERT(!cull_mode_str_opt.has_value() || cull_mode_opt.has_value(), "{} has unknown cull_mode {}.",
+                  get_id(), cull_mode_str_opt.value_or(""));
+        m_cull_mode = cull_mode_opt.value_or(vk::CullModeFlagBits::eBack);
         
-        const auto table = parse_toml_table();
+        const auto blend_mode_str_opt = parse_opt<std::string>(table, "blend_mode");
+        const auto blend_mode_opt = blend_mode_str_opt.and_then(blend_mode_from_string);
+        MH_ASSERT(!blend_mode_str_opt.has_value() || blend_mode_opt.has_value(), "{} has unknown blend_mode {}.",
+                  get_id(), blend_mode_str_opt.value_or(""));
+        m_blend_mode = blend_mode_opt.value_or(BlendMode::Opaque);
+        
+        m_depth_test = parse_opt<bool>(table, "depth_test").value_or(false);
+        m_depth_write = parse_opt<bool>(table, "depth_write").value_or(false);
         
         const auto vert_shader_id = parse<AssetId>(table, "vert_shader", "AssetId");
         const auto frag_shader_id = parse<AssetId>(table, "frag_shader", "AssetId");
         
-        auto &asset_manager = get_asset_manager();
-        
-        if (!m_vert_shader_ptr || m_vert_shader_ptr->get_id() != vert_shader_id)
-        {
-            if (m_vert_shader_ptr)
-            {
-                m_vert_shader_ptr->deregister_reload_callback(m_on_vert_shader_reloaded_id);
-            }
-            
-            m_vert_shader_ptr = asset_manager.load<VulkanShader>(vert_shader_id, m_device_ptr);
-            
-            m_on_vert_shader_reloaded_id = m_vert_shader_ptr->register_reload_callback(
-                std::bind(&VulkanMaterial::on_shader_reloaded, this)
-            );
-        }
-        
-        if (!m_frag_shader_ptr || m_frag_shader_ptr->get_id() != frag_shader_id)
+        if (m_vert_shader_ptr && m_vert_shader_ptr->get_id() == vert_shader_id &&
+            m_frag_shader_ptr && m_frag_shader_ptr->get_id() == frag_shader_id)
         {
-            if (m_frag_shader_ptr)
-            {
-                m_frag_shader_ptr->deregister_reload_callback(m_on_frag_shader_reloaded_id);
-            }
-            
-            m_frag_shader_ptr = asset_manager.load<VulkanShader>(frag_shader_id, m_device_ptr);
-            
-            m_on_frag_shader_reloaded_id = m_frag_shader_ptr->register_reload_callback(
-                std::bind(&VulkanMaterial::on_shader_reloaded, this)
-            );
+            return;
         }
         
-        const vk::PipelineShaderStageCreateInfo shader_stages[]
-        {
-            {
-                .stage = vk::ShaderStageFlagBits::eVertex,
-                .module = m_vert_shader_ptr->get_shader_module(),
-                .pName = "main",
-            },
-            {
-                .stage = vk::ShaderStageFlagBits::eFragment,
-                .module = m_frag_shader_ptr->get_shader_module(),
-                .pName = "main",
-            },
-        };
-        
-        const std::vector dynamic_states
-        {
-            vk::DynamicState::eViewport,
-            vk::DynamicState::eScissor,
-        };
-        const vk::PipelineDynamicStateCreateInfo dynamic_state_create_info
-        {
-            .dynamicStateCount = static_cast<u32>(dynamic_states.size()),
-            .pDynamicStates = dynamic_states.data(),
-        };
-        
-        const vk::PipelineVertexInputStateCreateInfo vertex_input_state_create_info
-        {
-            .vertexBindingDescriptionCount = 0,
-            .pVertexBindingDescriptions = nullptr,
-            .vertexAttributeDescriptionCount = 0,
-            .pVertexAttributeDescriptions = nullptr,
-        };
-        
-        const vk::PipelineInputAssemblyStateCreateInfo input_assembly_state_create_info
-        {
-            .topology = vk::PrimitiveTopology::eTriangleList,
-            .primitiveRestartEnable = vk::False,
-        };
-        
-        const vk::PipelineViewportStateCreateInfo viewport_state_create_info
-        {
-            .viewportCount = 1,
-            .scissorCount = 1,
-        };
-        
-        const vk::PipelineRasterizationStateCreateInfo rasterization_state_create_info
-        {
-            .depthClampEnable = vk::False,
-            .rasterizerDiscardEnable = vk::False,
-            .polygonMode = vk::PolygonMode::eFill,
-            .lineWidth = 1.0f,
-            .cullMode = vk::CullModeFlagBits::eBack,
-            .frontFace = vk::FrontFace::eClockwise,
-            .depthBiasEnable = vk::False,
-            .depthBiasConstantFactor = 0.0f,
-            .depthBiasClamp = 0.0f,
-            .depthBiasSlopeFactor = 0.0f,
-        };
-        
-        const vk::PipelineMultisampleStateCreateInfo multisample_state_create_info
-        {
-            .sampleShadingEnable = vk::False,
-            .rasterizationSamples = vk::SampleCountFlagBits::e1,
-            .minSampleShading = 1.0f,
-            .pSampleMask = nullptr,
-            .alphaToCoverageEnable = vk::False,
-            .alphaToOneEnable = vk::False,
-        };
-        
-        const vk::PipelineColorBlendAttachmentState color_blend_attachment_state
-        {
-            .colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG
-                            | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA,
-            .blendEnable = vk::False,
-            .srcColorBlendFactor = vk::BlendFactor::eOne,
-            .dstColorBlendFactor = vk::BlendFactor::eZero,
-            .colorBlendOp = vk::BlendOp::eAdd,
-            .srcAlphaBlendFactor = vk::BlendFactor::eOne,
-            .dstAlphaBlendFactor = vk::BlendFactor::eZero,
-            .alphaBlendOp = vk::BlendOp::eAdd,
-        };
+        // Both stages are requested together so that their compilation overlaps.
+        auto &asset_manager = get_asset_manager();
+        const auto shader_ptrs = asset_manager.load_all<VulkanShader>({vert_shader_id, frag_shader_id}, m_device_ptr);
         
-        const vk::PipelineColorBlendStateCreateInfo color_blend_state_create_info
-        {
-            .logicOpEnable = vk::False,
-            .logicOp = vk::LogicOp::eCopy,
-            .attachmentCount = 1,
-            .pAttachments = &color_blend_attachment_state,
-            .blendConstants = {},
-        };
+        m_vert_shader_ptr = shader_ptrs[0];
+        m_frag_shader_ptr = shader_ptrs[1];
         
-        const vk::PipelineLayoutCreateInfo pipeline_layout_create_info
+        // The pipeline is rebuilt by the asset manager whenever either shader is reloaded.
+        asset_manager.set_dependencies(get_id(), {vert_shader_id, frag_shader_id});
+    }
+    
+    void VulkanMaterial::finalize()
+    {
+        // The first pipeline is needed before anything can be drawn, so only that one is looked up inline.
+        if (!m_graphics_pipeline_ptr)
         {
-            .setLayoutCount = 0,
-            .pSetLayouts = nullptr,
-            .pushConstantRangeCount = 0,
-            .pPushConstantRanges = nullptr,
-        };
-        
-        const auto pipeline_layout = m_device_ptr->create_pipeline_layout(pipeline_layout_create_info);
+            m_graphics_pipeline_ptr = m_graphics_pipeline_cache_ptr->get_or_create_pipeline(get_graphics_pipeline_key());
+            return;
+        }
         
-        const vk::GraphicsPipelineCreateInfo graphics_pipeline_create_info
+        // A build that is still running may be using shader modules that were just retired, so it is waited for
+        // before the deletion queue can be flushed. Its result is already out of date.
+        if (m_pending_graphics_pipeline.valid())
         {
-            .stageCount = 2,
-            .pStages = shader_stages,
-            .pVertexInputState = &vertex_input_state_create_info,
-            .pInputAssemblyState = &input_assembly_state_create_info,
-            .pViewportState = &viewport_state_create_info,
-            .pRasterizationState = &rasterization_state_create_info,
-            .pMultisampleState = &multisample_state_create_info,
-            .pDepthStencilState = nullptr,
-            .pColorBlendState = &color_blend_state_create_info,
-            .pDynamicState = &dynamic_state_create_info,
-            .layout = pipeline_layout,
-            .renderPass = m_render_pass_ptr->get_render_pass(),
-            .subpass = 0,
-            .basePipelineHandle = nullptr,
-            .basePipelineIndex = -1,
-        };
+            m_pending_graphics_pipeline.wait();
+        }
         
-        m_graphics_pipeline = m_device_ptr->create_graphics_pipeline(graphics_pipeline_create_info);
+        auto build_task_ptr = std::make_shared<std::packaged_task<std::shared_ptr<GraphicsPipeline>()>>(
+            [graphics_pipeline_cache_ptr = m_graphics_pipeline_cache_ptr, key = get_graphics_pipeline_key()]
+            {
+                return graphics_pipeline_cache_ptr->get_or_create_pipeline(key);
+            }
+        );
+        m_pending_graphics_pipeline = build_task_ptr->get_future();
         
-        m_device_ptr->destroy_pipeline_layout(pipeline_layout);
+        get_asset_manager().submit_background_task([build_task_ptr] { (*build_task_ptr)(); });
     }
     
-    void VulkanMaterial::on_shader_reloaded()
+    GraphicsPipelineKey VulkanMaterial::get_graphics_pipeline_key() const
     {
-        m_should_be_recreated = true;
+        return {
+            .vert_shader_module = m_vert_shader_ptr->get_shader_module(),
+            .vert_shader_module_id = m_vert_shader_ptr->get_shader_module_id(),
+            .frag_shader_module = m_frag_shader_ptr->get_shader_module(),
+            .frag_shader_module_id = m_frag_shader_ptr->get_shader_module_id(),
+            .cull_mode = m_cull_mode,
+            .depth_test = m_depth_test,
+            .depth_write = m_depth_write,
+            .blend_mode = m_blend_mode,
+            .color_attachment_format = m_render_pass_ptr->get_color_attachment_format(),
+            .layout_key = m_render_pass_ptr->get_pipeline_layout_key(),
+        };
     }
 }
@@ -0,0 +1,238 @@
+#include "mellohi/graphics/vulkan/bindless_descriptors.hpp"
+
+#include <algorithm>
+
+namespace mellohi
+{
+    static vk::DescriptorType get_descriptor_type(const BindlessResourceType type)
+    {
+        switch (type)
+        {
+            case BindlessResourceType::SampledImage:
+                return vk::DescriptorType::eSampledImage;
+            case BindlessResourceType::Sampler:
+                return vk::DescriptorType::eSampler;
+            case BindlessResourceType::StorageBuffer:
+                return vk::DescriptorType::eStorageBuffer;
+        }
+        
+        MH_ASSERT(false, "Unknown bindless resource type {}.", static_cast<i32>(type));
+        return {};
+    }
+    
+    BindlessDescriptors::BindlessDescriptors(const std::shared_ptr<Device> device_ptr)
+        : m_device_ptr(device_ptr)
+    {
+        // Update-after-bind descriptors have limits of their own, which may be lower than the usual ones.
+        const auto properties = m_device_ptr->get_physical_device_vulkan_12_properties();
+        const std::array capacities
+        {
+            std::min({MAX_SAMPLED_IMAGES, properties.maxDescriptorSetUpdateAfterBindSampledImages,
+                      properties.maxPerStageDescriptorUpdateAfterBindSampledImages}),
+            std::min({MAX_SAMPLERS, properties.maxDescriptorSetUpdateAfterBindSamplers,
+                      properties.maxPerStageDescriptorUpdateAfterBindSamplers}),
+            std::min({MAX_STORAGE_BUFFERS, properties.maxDescriptorSetUpdateAfterBindStorageBuffers,
+                      properties.maxPerStageDescriptorUpdateAfterBindStorageBuffers}),
+        };
+        
+        for (usize type_index = 0; type_index < m_index_allocators.size(); ++type_index)
+        {
+            m_index_allocators[type_index].capacity = capacities[type_index];
+        }
+        
+        create_descriptor_set(capacities);
+    }
+    
+    BindlessDescriptors::~BindlessDescriptors()
+    {
+        // Frames in flight may still be using the set, which is freed along with its pool.
+        m_device_ptr->push_to_deletion_queue(m_descriptor_pool);
+        m_device_ptr->push_to_deletion_queue(m_descriptor_set_layout);
+    }
+    
+    BindlessImageHandle BindlessDescriptors::add_image(const vk::ImageView image_view, const vk::ImageLayout layout)
+    {
+        const vk::DescriptorImageInfo image_info
+        {
+            .imageView = image_view,
+            .imageLayout = layout,
+        };
+        
+        const auto index = allocate_index(BindlessResourceType::SampledImage);
+        write_descriptor(BindlessResourceType::SampledImage, index, &image_info, nullptr);
+        return { .index = index };
+    }
+    
+    BindlessSamplerHandle BindlessDescriptors::add_sampler(const vk::Sampler sampler)
+    {
+        const vk::DescriptorImageInfo image_info
+        {
+            .sampler = sampler,
+        };
+        
+        const auto index = allocate_index(BindlessResourceType::Sampler);
+        write_descriptor(BindlessResourceType::Sampler, index, &image_info, nullptr);
+        return { .index = index };
+    }
+    
+    BindlessBufferHandle BindlessDescriptors::add_buffer(const Buffer &buffer, const vk::DeviceSize offset,
+                                                         const vk::DeviceSize range)
+    {
+        const vk::DescriptorBufferInfo buffer_info
+        {
+            .buffer = buffer.buffer,
+            .offset = offset,
+            .range = range,
+        };
+        
+        const auto index = allocate_index(BindlessResourceType::StorageBuffer);
+        write_descriptor(BindlessResourceType::StorageBuffer, index, nullptr, &buffer_info);
+        return { .index = index };
+    }
+    
+    void BindlessDescriptors::remove(const BindlessImageHandle handle)
+    {
+        retire_index(BindlessResourceType::SampledImage, handle.index);
+    }
+    
+    void BindlessDescriptors::remove(const BindlessSamplerHandle handle)
+    {
+        retire_index(BindlessResourceType::Sampler, handle.index);
+    }
+    
+    void BindlessDescriptors::remove(const BindlessBufferHandle handle)
+    {
+        retire_index(BindlessResourceType::StorageBuffer, handle.index);
+    }
+    
+    vk::DescriptorSetLayout BindlessDescriptors::get_descriptor_set_layout() const
+    {
+        return m_descriptor_set_layout;
+    }
+    
+    vk::DescriptorSet BindlessDescriptors::get_descriptor_set() const
+    {
+        return m_descriptor_set;
+    }
+    
+    void BindlessDescriptors::create_descriptor_set(const std::array<u32, 3> &capacities)
+    {
+        std::array<vk::DescriptorSetLayoutBinding, 3> bindings;
+        std::array<vk::DescriptorBindingFlags, 3> binding_flags;
+        std::array<vk::DescriptorPoolSize, 3> pool_sizes;
+        
+        for (u32 binding = 0; binding < bindings.size(); ++binding)
+        {
+            const auto descriptor_type = get_descriptor_type(static_cast<BindlessResourceType>(binding));
+            
+            bindings[binding] = vk::DescriptorSetLayoutBinding
+            {
+                .binding = binding,
+                .descriptorType = descriptor_type,
+                .descriptorCount = capacities[binding],
+                .stageFlags = vk::ShaderStageFlagBits::eAll,
+            };
+            
+            // Elements are written while command buffers using other elements are pending, and most of them are
+            // never written at all.
+            binding_flags[binding] = vk::DescriptorBindingFlagBits::eUpdateAfterBind
+                                     | vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending
+                                     | vk::DescriptorBindingFlagBits::ePartiallyBound;
+            
+            pool_sizes[binding] = vk::DescriptorPoolSize
+            {
+                .type = descriptor_type,
+                .descriptorCount = capacities[binding],
+            };
+        }
+        
+        const vk::DescriptorSetLayoutBindingFlagsCreateInfo binding_flags_create_info
+        {
+            .bindingCount = static_cast<u32>(binding_flags.size()),
+            .pBindingFlags = binding_flags.data(),
+        };
+        
+        const vk::DescriptorSetLayoutCreateInfo descriptor_set_layout_create_info
+        {
+            .pNext = &binding_flags_create_info,
+            .flags = vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool,
+            .bindingCount = static_cast<u32>(bindings.size()),
+            .pBindings = bindings.data(),
+        };
+        m_descriptor_set_layout = m_device_ptr->create_descriptor_set_layout(descriptor_set_layout_create_info);
+        
+        const vk::DescriptorPoolCreateInfo descriptor_pool_create_info
+        {
+            .flags = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind,
+            .maxSets = 1,
+            .poolSizeCount = static_cast<u32>(pool_sizes.size()),
+            .pPoolSizes = pool_sizes.data(),
+        };
+        m_descriptor_pool = m_device_ptr->create_descriptor_pool(descriptor_pool_create_info);
+        
+        const vk::DescriptorSetAllocateInfo descriptor_set_allocate_info
+        {
+            .descriptorPool = m_descriptor_pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &m_descriptor_set_layout,
+        };
+        m_descriptor_set = m_device_ptr->allocate_descriptor_sets(descriptor_set_allocate_info).front();
+    }
+    
+    u32 BindlessDescriptors::allocate_index(const BindlessResourceType type)
+    {
+        auto &index_allocator = m_index_allocators[static_cast<usize>(type)];
+        
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        
+        while (!index_allocator.retired_indices.empty()
+               && m_device_ptr->is_frame_complete(index_allocator.retired_indices.front().frame))
+        {
+            index_allocator.free_indices.push_back(index_allocator.retired_indices.front().index);
+            index_allocator.retired_indices.pop_front();
+        }
+        
+        if (!index_allocator.free_indices.empty())
+        {
+            const auto index = index_allocator.free_indices.back();
+            index_allocator.free_indices.pop_back();
+            return index;
+        }
+        
+        MH_ASSERT(index_allocator.next_index < index_allocator.capacity,
+                  "Bindless descriptor set is out of {} slots; all {} are in use.",
+                  vk::to_string(get_descriptor_type(type)), index_allocator.capacity);
+        return index_allocator.next_index++;
+    }
+    
+    void BindlessDescriptors::retire_index(const BindlessResourceType type, const u32 index)
+    {
+        MH_ASSERT(index != INVALID_BINDLESS_INDEX, "Cannot remove an invalid bindless handle.");
+        
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        m_index_allocators[static_cast<usize>(type)].retired_indices.push_back({
+            .frame = m_device_ptr->get_frame(),
+            .index = index,
+        });
+    }
+    
+    // Writes to the set have to be externally synchronized, even with update-after-bind.
+    void BindlessDescriptors::write_descriptor(const BindlessResourceType type, const u32 index,
+                                               const vk::DescriptorImageInfo *image_info_ptr,
+                                               const vk::DescriptorBufferInfo *buffer_info_ptr)
+    {
+        const vk::WriteDescriptorSet descriptor_write
+        {
+            .dstSet = m_descriptor_set,
+            .dstBinding = static_cast<u32>(type),
+            .dstArrayElement = index,
+            .descriptorCount = 1,
+            .descriptorType = get_descriptor_type(type),
+            .pImageInfo = image_info_ptr,
+            .pBufferInfo = buffer_info_ptr,
+        };
+        
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        m_device_ptr->update_descriptor_sets({&descriptor_write, 1});
+    }
+}
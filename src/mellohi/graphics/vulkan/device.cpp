@@ -1,10 +1,37 @@
 #include "mellohi/graphics/vulkan/device.hpp"
 #include <vulkan/vulkan_structs.hpp>
 
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
 VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 
 namespace mellohi
 {
+    // What BindlessDescriptors needs: arrays of sampled images and storage buffers that are indexed non-uniformly,
+    // only partially filled, and updated while command buffers using other elements are pending.
+    static bool supports_bindless_descriptors(const vk::PhysicalDeviceVulkan12Features &vulkan_12_features)
+    {
+        return vulkan_12_features.shaderSampledImageArrayNonUniformIndexing
+               && vulkan_12_features.shaderStorageBufferArrayNonUniformIndexing
+               && vulkan_12_features.descriptorBindingSampledImageUpdateAfterBind
+               && vulkan_12_features.descriptorBindingStorageBufferUpdateAfterBind
+               && vulkan_12_features.descriptorBindingUpdateUnusedWhilePending
+               && vulkan_12_features.descriptorBindingPartiallyBound
+               && vulkan_12_features.runtimeDescriptorArray;
+    }
+    
+    static bool has_extension(const std::span<const vk::ExtensionProperties> available_extensions,
+                              const char *extension_name)
+    {
+        return std::ranges::any_of(available_extensions,
+            [extension_name](const vk::ExtensionProperties &extension_properties)
+            {
+                return std::strcmp(extension_properties.extensionName, extension_name) == 0;
+            });
+    }
+    
     Device::Device(const EngineConfigAsset &engine_config, const Platform &platform)
     {
         VULKAN_HPP_DEFAULT_DISPATCHER.init();
@@ -12,12 +39,25 @@ namespace mellohi
         create_debug_utils_messenger();
         choose_physical_device();
         create_device();
+        create_memory_allocator();
         choose_preferred_surface_format();
+        create_pipeline_cache();
+        create_frame_timeline_semaphore();
+        
+        m_deletion_queue.reserve(64);
     }
     
     Device::~Device()
     {
-        flush_deletion_queue();
+        wait_idle();
+        flush_deletion_queue(std::numeric_limits<u64>::max());
+        
+        m_memory_allocator_ptr.reset();
+        
+        m_device.destroySemaphore(m_frame_timeline_semaphore);
+        
+        save_pipeline_cache();
+        m_device.destroyPipelineCache(m_pipeline_cache);
         
         m_device.destroy();
         
@@ -31,6 +71,14 @@ namespace mellohi
         m_instance.destroy();
     }
     
+    bool Device::is_fence_signaled(const vk::Fence fence) const
+    {
+        const auto result = m_device.getFenceStatus(fence);
+        MH_ASSERT(result == vk::Result::eSuccess || result == vk::Result::eNotReady,
+                  "Failed to get Vulkan fence status: {}.", vk::to_string(result));
+        return result == vk::Result::eSuccess;
+    }
+    
     void Device::reset_fence(const vk::Fence fence) const
     {
         const auto result = m_device.resetFences(1, &fence);
@@ -49,24 +97,154 @@ namespace mellohi
         MH_ASSERT_VK(result, "Failed to wait for Vulkan device.");
     }
     
-    void Device::push_to_deletion_queue(std::function<void()>&& deletor)
+    u64 Device::get_semaphore_counter_value(const vk::Semaphore semaphore) const
     {
-        m_deletion_queue.push_back(deletor);
+        const auto resval = m_device.getSemaphoreCounterValue(semaphore);
+        MH_ASSERT_VK(resval.result, "Failed to get Vulkan timeline semaphore value.");
+        return resval.value;
     }
     
-    void Device::flush_deletion_queue()
+    void Device::wait_for_semaphore(const vk::Semaphore semaphore, const u64 value, const u64 timeout) const
     {
-        if (!m_deletion_queue.empty())
+        const vk::SemaphoreWaitInfo semaphore_wait_info
         {
-            wait_idle();
-            
-            const auto deletion_queue = m_deletion_queue;
-            m_deletion_queue.clear();
-            for (auto it = deletion_queue.rbegin(); it != deletion_queue.rend(); it++)
+            .semaphoreCount = 1,
+            .pSemaphores = &semaphore,
+            .pValues = &value,
+        };
+        
+        const auto result = m_device.waitSemaphores(semaphore_wait_info, timeout);
+        MH_ASSERT_VK(result, "Failed to wait for Vulkan timeline semaphore.");
+    }
+    
+    void Device::submit(const QueueCapability capability, const vk::SubmitInfo2 &submit_info) const
+    {
+        const auto queue = get_queue(capability);
+        const std::lock_guard<std::mutex> lock(m_queue_mutexes.at(queue));
+        
+        const auto result = queue.submit2(1, &submit_info, nullptr);
+        MH_ASSERT_VK(result, "Failed to submit Vulkan queue.");
+    }
+    
+    void Device::submit(const QueueCapability capability, const std::span<const vk::CommandBuffer> command_buffers,
+                        const std::span<const vk::SemaphoreSubmitInfo> wait_semaphore_infos,
+                        const std::span<const vk::SemaphoreSubmitInfo> signal_semaphore_infos) const
+    {
+        std::vector<vk::CommandBufferSubmitInfo> command_buffer_submit_infos;
+        command_buffer_submit_infos.reserve(command_buffers.size());
+        for (const auto command_buffer : command_buffers)
+        {
+            command_buffer_submit_infos.push_back({ .commandBuffer = command_buffer });
+        }
+        
+        submit(capability, {
+            .waitSemaphoreInfoCount = static_cast<u32>(wait_semaphore_infos.size()),
+            .pWaitSemaphoreInfos = wait_semaphore_infos.data(),
+            .commandBufferInfoCount = static_cast<u32>(command_buffer_submit_infos.size()),
+            .pCommandBufferInfos = command_buffer_submit_infos.data(),
+            .signalSemaphoreInfoCount = static_cast<u32>(signal_semaphore_infos.size()),
+            .pSignalSemaphoreInfos = signal_semaphore_infos.data(),
+        });
+    }
+    
+    vk::Result Device::present(const vk::PresentInfoKHR &present_info) const
+    {
+        const auto queue = get_queue(QueueCapability::Present);
+        const std::lock_guard<std::mutex> lock(m_queue_mutexes.at(queue));
+        
+        return queue.presentKHR(present_info);
+    }
+    
+    bool Device::shares_queue_family(const QueueCapability capability, const QueueCapability other_capability) const
+    {
+        return get_queue_family_index(capability) == get_queue_family_index(other_capability);
+    }
+    
+    bool Device::supports_multi_draw_indirect() const
+    {
+        return m_multi_draw_indirect_supported;
+    }
+    
+    bool Device::supports_draw_indirect_count() const
+    {
+        return m_draw_indirect_count_supported;
+    }
+    
+    bool Device::supports_present_fences() const
+    {
+        return m_present_fences_supported;
+    }
+    
+    u64 Device::get_frame() const
+    {
+        return m_frame;
+    }
+    
+    u64 Device::get_completed_frame_count() const
+    {
+        return get_semaphore_counter_value(m_frame_timeline_semaphore);
+    }
+    
+    bool Device::is_frame_complete(const u64 frame) const
+    {
+        return get_completed_frame_count() > frame;
+    }
+    
+    void Device::wait_for_frame(const u64 frame, const u64 timeout) const
+    {
+        wait_for_semaphore(m_frame_timeline_semaphore, frame + 1, timeout);
+    }
+    
+    void Device::advance_frame()
+    {
+        ++m_frame;
+    }
+    
+    vk::Semaphore Device::get_frame_timeline_semaphore() const
+    {
+        return m_frame_timeline_semaphore;
+    }
+    
+    void Device::push_to_deletion_queue(const Buffer &buffer)
+    {
+        if (buffer.buffer)
+        {
+            push_to_deletion_queue(vk::Buffer::objectType,
+                                   std::bit_cast<u64>(static_cast<VkBuffer>(buffer.buffer)), buffer.allocation);
+        }
+    }
+    
+    void Device::push_to_deletion_queue(const Image &image)
+    {
+        if (image.image)
+        {
+            push_to_deletion_queue(vk::Image::objectType,
+                                   std::bit_cast<u64>(static_cast<VkImage>(image.image)), image.allocation);
+        }
+    }
+    
+    void Device::flush_deletion_queue()
+    {
+        flush_deletion_queue(get_completed_frame_count());
+    }
+    
+    void Device::flush_deletion_queue(const u64 completed_frame_count)
+    {
+        const std::lock_guard<std::mutex> lock(m_deletion_queue_mutex);
+        
+        const auto completed_end = std::ranges::find_if(m_deletion_queue,
+            [completed_frame_count](const DeletionEntry &entry)
             {
-                (*it)();
-            }
+                return entry.frame >= completed_frame_count;
+            });
+        
+        for (auto it = std::make_reverse_iterator(completed_end); it != m_deletion_queue.rend(); ++it)
+        {
+            destroy_handle(it->object_type, it->handle);
+            m_memory_allocator_ptr->free(it->allocation);
         }
+        
+        m_deletion_queue.erase(m_deletion_queue.begin(), completed_end);
     }
     
     std::vector<vk::CommandBuffer> Device::allocate_command_buffers(
@@ -77,6 +255,32 @@ namespace mellohi
         return resval.value;
     }
     
+    std::vector<vk::DescriptorSet> Device::allocate_descriptor_sets(
+        const vk::DescriptorSetAllocateInfo &allocate_info) const
+    {
+        const auto resval = m_device.allocateDescriptorSets(allocate_info);
+        MH_ASSERT_VK(resval.result, "Failed to allocate Vulkan descriptor set.");
+        return resval.value;
+    }
+    
+    Buffer Device::create_buffer(const vk::BufferCreateInfo &create_info,
+                                 const AllocationCreateInfo &allocation_create_info) const
+    {
+        const auto resval = m_device.createBuffer(create_info);
+        MH_ASSERT_VK(resval.result, "Failed to create Vulkan buffer.");
+        
+        const auto allocation = m_memory_allocator_ptr->allocate_for_buffer(resval.value, allocation_create_info);
+        const auto result = m_device.bindBufferMemory(resval.value, allocation.memory, allocation.offset);
+        MH_ASSERT_VK(result, "Failed to bind Vulkan buffer memory.");
+        
+        return Buffer
+        {
+            .buffer = resval.value,
+            .size = create_info.size,
+            .allocation = allocation,
+        };
+    }
+    
     vk::CommandPool Device::create_command_pool(const vk::CommandPoolCreateInfo &create_info) const
     {
         const auto resval = m_device.createCommandPool(create_info);
@@ -84,27 +288,109 @@ namespace mellohi
         return resval.value;
     }
     
-    vk::Fence Device::create_fence(const vk::FenceCreateInfo &create_info) const
+    vk::Pipeline Device::create_compute_pipeline(const vk::ComputePipelineCreateInfo &create_info) const
     {
-        const auto resval = m_device.createFence(create_info);
-        MH_ASSERT_VK(resval.result, "Failed to create Vulkan fence.");
+        const auto resval = m_device.createComputePipeline(m_pipeline_cache, create_info);
+        MH_ASSERT_VK(resval.result, "Failed to create Vulkan compute pipeline.");
+        return resval.value;
+    }
+    
+    vk::DescriptorPool Device::create_descriptor_pool(const vk::DescriptorPoolCreateInfo &create_info) const
+    {
+        const auto resval = m_device.createDescriptorPool(create_info);
+        MH_ASSERT_VK(resval.result, "Failed to create Vulkan descriptor pool.");
         return resval.value;
     }
     
-    vk::Framebuffer Device::create_framebuffer(const vk::FramebufferCreateInfo &create_info) const
+    vk::DescriptorSetLayout Device::create_descriptor_set_layout(
+        const vk::DescriptorSetLayoutCreateInfo &create_info) const
     {
-        const auto resval = m_device.createFramebuffer(create_info);
-        MH_ASSERT_VK(resval.result, "Failed to create Vulkan framebuffer.");
+        const auto resval = m_device.createDescriptorSetLayout(create_info);
+        MH_ASSERT_VK(resval.result, "Failed to create Vulkan descriptor set layout.");
+        return resval.value;
+    }
+    
+    vk::Fence Device::create_fence(const vk::FenceCreateInfo &create_info) const
+    {
+        const auto resval = m_device.createFence(create_info);
+        MH_ASSERT_VK(resval.result, "Failed to create Vulkan fence.");
         return resval.value;
     }
     
     vk::Pipeline Device::create_graphics_pipeline(const vk::GraphicsPipelineCreateInfo &create_info) const
     {
-        const auto resval = m_device.createGraphicsPipeline(nullptr, create_info);
+        const auto resval = m_device.createGraphicsPipeline(m_pipeline_cache, create_info);
         MH_ASSERT_VK(resval.result, "Failed to create Vulkan graphics pipeline.");
         return resval.value;
     }
     
+    Image Device::create_image(const vk::ImageCreateInfo &create_info,
+                               const AllocationCreateInfo &allocation_create_info) const
+    {
+        const auto resval = m_device.createImage(create_info);
+        MH_ASSERT_VK(resval.result, "Failed to create Vulkan image.");
+        
+        const auto allocation = m_memory_allocator_ptr->allocate_for_image(resval.value, allocation_create_info);
+        const auto result = m_device.bindImageMemory(resval.value, allocation.memory, allocation.offset);
+        MH_ASSERT_VK(result, "Failed to bind Vulkan image memory.");
+        
+        return Image
+        {
+            .image = resval.value,
+            .format = create_info.format,
+            .extent = create_info.extent,
+            .allocation = allocation,
+        };
+    }
+    
+    std::vector<Image> Device::create_aliased_images(const std::span<const vk::ImageCreateInfo> create_infos,
+                                                     const AllocationCreateInfo &allocation_create_info) const
+    {
+        std::vector<Image> images;
+        images.reserve(create_infos.size());
+        
+        // The memory has to satisfy the requirements of every image bound to it.
+        vk::MemoryRequirements requirements
+        {
+            .size = 0,
+            .alignment = 1,
+            .memoryTypeBits = ~0u,
+        };
+        
+        for (const auto &create_info : create_infos)
+        {
+            const auto resval = m_device.createImage(create_info);
+            MH_ASSERT_VK(resval.result, "Failed to create Vulkan image.");
+            
+            const auto image_requirements = m_device.getImageMemoryRequirements(resval.value);
+            requirements.size = std::max(requirements.size, image_requirements.size);
+            requirements.alignment = std::max(requirements.alignment, image_requirements.alignment);
+            requirements.memoryTypeBits &= image_requirements.memoryTypeBits;
+            
+            images.push_back({
+                .image = resval.value,
+                .format = create_info.format,
+                .extent = create_info.extent,
+            });
+        }
+        
+        MH_ASSERT(requirements.memoryTypeBits != 0, "Aliased Vulkan images have no memory type in common.");
+        
+        const auto allocation = m_memory_allocator_ptr->allocate(requirements, allocation_create_info);
+        for (const auto &image : images)
+        {
+            const auto result = m_device.bindImageMemory(image.image, allocation.memory, allocation.offset);
+            MH_ASSERT_VK(result, "Failed to bind Vulkan image memory.");
+        }
+        
+        if (!images.empty())
+        {
+            images.front().allocation = allocation;
+        }
+        
+        return images;
+    }
+    
     vk::ImageView Device::create_image_view(const vk::ImageViewCreateInfo &create_info) const
     {
         const auto resval = m_device.createImageView(create_info);
@@ -119,13 +405,6 @@ namespace mellohi
         return resval.value;
     }
     
-    vk::RenderPass Device::create_render_pass(const vk::RenderPassCreateInfo &create_info) const
-    {
-        const auto resval = m_device.createRenderPass(create_info);
-        MH_ASSERT_VK(resval.result, "Failed to create Vulkan render pass.");
-        return resval.value;
-    }
-    
     vk::Semaphore Device::create_semaphore(const vk::SemaphoreCreateInfo &create_info) const
     {
         const auto resval = m_device.createSemaphore(create_info);
@@ -133,6 +412,17 @@ namespace mellohi
         return resval.value;
     }
     
+    vk::Semaphore Device::create_timeline_semaphore(const u64 initial_value) const
+    {
+        const vk::SemaphoreTypeCreateInfo semaphore_type_create_info
+        {
+            .semaphoreType = vk::SemaphoreType::eTimeline,
+            .initialValue = initial_value,
+        };
+        
+        return create_semaphore({ .pNext = &semaphore_type_create_info });
+    }
+    
     vk::ShaderModule Device::create_shader_module(const vk::ShaderModuleCreateInfo &create_info) const
     {
         const auto resval = m_device.createShaderModule(create_info);
@@ -147,19 +437,36 @@ namespace mellohi
         return resval.value;
     }
     
+    void Device::destroy_buffer(const Buffer &buffer) const
+    {
+        m_device.destroyBuffer(buffer.buffer);
+        m_memory_allocator_ptr->free(buffer.allocation);
+    }
+    
     void Device::destroy_command_pool(const vk::CommandPool command_pool) const
     {
         m_device.destroyCommandPool(command_pool);
     }
     
+    void Device::destroy_descriptor_pool(const vk::DescriptorPool descriptor_pool) const
+    {
+        m_device.destroyDescriptorPool(descriptor_pool);
+    }
+    
+    void Device::destroy_descriptor_set_layout(const vk::DescriptorSetLayout descriptor_set_layout) const
+    {
+        m_device.destroyDescriptorSetLayout(descriptor_set_layout);
+    }
+    
     void Device::destroy_fence(const vk::Fence fence) const
     {
         m_device.destroyFence(fence);
     }
     
-    void Device::destroy_framebuffer(const vk::Framebuffer framebuffer) const
+    void Device::destroy_image(const Image &image) const
     {
-        m_device.destroyFramebuffer(framebuffer);
+        m_device.destroyImage(image.image);
+        m_memory_allocator_ptr->free(image.allocation);
     }
     
     void Device::destroy_image_view(const vk::ImageView image_view) const
@@ -177,11 +484,6 @@ namespace mellohi
         m_device.destroyPipelineLayout(pipeline_layout);
     }
     
-    void Device::destroy_render_pass(const vk::RenderPass render_pass) const
-    {
-        m_device.destroyRenderPass(render_pass);
-    }
-    
     void Device::destroy_semaphore(const vk::Semaphore semaphore) const
     {
         m_device.destroySemaphore(semaphore);
@@ -197,21 +499,112 @@ namespace mellohi
         m_device.destroySwapchainKHR(swapchain);
     }
     
+    void Device::free_command_buffers(const vk::CommandPool command_pool,
+                                      const std::span<const vk::CommandBuffer> command_buffers) const
+    {
+        m_device.freeCommandBuffers(command_pool, static_cast<u32>(command_buffers.size()), command_buffers.data());
+    }
+    
+    void Device::push_to_deletion_queue(const vk::ObjectType object_type, const u64 handle,
+                                        const Allocation &allocation)
+    {
+        const std::lock_guard<std::mutex> lock(m_deletion_queue_mutex);
+        m_deletion_queue.push_back({
+            .frame = m_frame,
+            .object_type = object_type,
+            .handle = handle,
+            .allocation = allocation,
+        });
+    }
+    
+    void Device::destroy_handle(const vk::ObjectType object_type, const u64 handle) const
+    {
+        switch (object_type)
+        {
+            case vk::ObjectType::eBuffer:
+                m_device.destroyBuffer(vk::Buffer(std::bit_cast<VkBuffer>(handle)));
+                break;
+            case vk::ObjectType::eCommandPool:
+                destroy_command_pool(vk::CommandPool(std::bit_cast<VkCommandPool>(handle)));
+                break;
+            case vk::ObjectType::eDescriptorPool:
+                destroy_descriptor_pool(vk::DescriptorPool(std::bit_cast<VkDescriptorPool>(handle)));
+                break;
+            case vk::ObjectType::eDescriptorSetLayout:
+                destroy_descriptor_set_layout(vk::DescriptorSetLayout(std::bit_cast<VkDescriptorSetLayout>(handle)));
+                break;
+            case vk::ObjectType::eFence:
+                destroy_fence(vk::Fence(std::bit_cast<VkFence>(handle)));
+                break;
+            case vk::ObjectType::eImage:
+                m_device.destroyImage(vk::Image(std::bit_cast<VkImage>(handle)));
+                break;
+            case vk::ObjectType::eImageView:
+                destroy_image_view(vk::ImageView(std::bit_cast<VkImageView>(handle)));
+                break;
+            case vk::ObjectType::ePipeline:
+                destroy_pipeline(vk::Pipeline(std::bit_cast<VkPipeline>(handle)));
+                break;
+            case vk::ObjectType::ePipelineLayout:
+                destroy_pipeline_layout(vk::PipelineLayout(std::bit_cast<VkPipelineLayout>(handle)));
+                break;
+            case vk::ObjectType::eSemaphore:
+                destroy_semaphore(vk::Semaphore(std::bit_cast<VkSemaphore>(handle)));
+                break;
+            case vk::ObjectType::eShaderModule:
+                destroy_shader_module(vk::ShaderModule(std::bit_cast<VkShaderModule>(handle)));
+                break;
+            case vk::ObjectType::eSwapchainKHR:
+                destroy_swapchain(vk::SwapchainKHR(std::bit_cast<VkSwapchainKHR>(handle)));
+                break;
+            default:
+                MH_ASSERT(false, "Vulkan object type {} cannot be deleted through the deletion queue.",
+                          vk::to_string(object_type));
+        }
+    }
+    
     vk::Device Device::get_device() const
     {
         return m_device;
     }
     
+    vk::MemoryRequirements Device::get_image_memory_requirements(const vk::ImageCreateInfo &create_info) const
+    {
+        const vk::DeviceImageMemoryRequirements device_image_memory_requirements
+        {
+            .pCreateInfo = &create_info,
+        };
+        
+        return m_device.getImageMemoryRequirements(device_image_memory_requirements).memoryRequirements;
+    }
+    
     vk::Instance Device::get_instance() const
     {
         return m_instance;
     }
     
+    MemoryAllocator &Device::get_memory_allocator() const
+    {
+        return *m_memory_allocator_ptr;
+    }
+    
     vk::PhysicalDevice Device::get_physical_device() const
     {
         return m_physical_device;
     }
     
+    vk::PhysicalDeviceProperties Device::get_physical_device_properties() const
+    {
+        return m_physical_device.getProperties();
+    }
+    
+    vk::PhysicalDeviceVulkan12Properties Device::get_physical_device_vulkan_12_properties() const
+    {
+        const auto properties = m_physical_device.getProperties2<vk::PhysicalDeviceProperties2,
+                                                                 vk::PhysicalDeviceVulkan12Properties>();
+        return properties.get<vk::PhysicalDeviceVulkan12Properties>();
+    }
+    
     vk::SurfaceFormatKHR Device::get_preferred_surface_format() const
     {
         return m_preferred_surface_format;
@@ -219,7 +612,7 @@ namespace mellohi
     
     vk::Queue Device::get_queue(const QueueCapability capability) const
     {
-        const auto queue_it = m_queues.find(get_queue_family_index(capability));
+        const auto queue_it = m_queues.find(capability);
         MH_ASSERT(queue_it != m_queues.end(), "Device is missing queue for capability {}.", capability);
         return queue_it->second;
     }
@@ -265,19 +658,15 @@ namespace mellohi
         return resval.value;
     }
     
-    std::vector<u32> Device::get_unique_queue_family_indices() const
+    void Device::reset_command_pool(const vk::CommandPool command_pool) const
     {
-        const auto graphics_index = get_queue_family_index(QueueCapability::Graphics);
-        const auto present_index = get_queue_family_index(QueueCapability::Present);
-        
-        if (graphics_index != present_index)
-        {
-            return {graphics_index, present_index};
-        }
-        else
-        {
-            return {graphics_index};
-        }
+        const auto result = m_device.resetCommandPool(command_pool);
+        MH_ASSERT_VK(result, "Failed to reset Vulkan command pool.");
+    }
+    
+    void Device::update_descriptor_sets(const std::span<const vk::WriteDescriptorSet> descriptor_writes) const
+    {
+        m_device.updateDescriptorSets(static_cast<u32>(descriptor_writes.size()), descriptor_writes.data(), 0, nullptr);
     }
     
     static VKAPI_ATTR VkBool32 VKAPI_CALL vk_debug_callback(
@@ -334,7 +723,21 @@ namespace mellohi
             .apiVersion = VK_API_VERSION_1_3,
         };
         
-        const auto required_extensions = get_required_instance_extensions(platform);
+        auto required_extensions = get_required_instance_extensions(platform);
+        
+        // Optional; needed by the device extension that gives presents fences.
+        const auto available_extensions_resval = vk::enumerateInstanceExtensionProperties();
+        MH_ASSERT_VK(available_extensions_resval.result, "Failed to enumerate Vulkan instance extensions.");
+        m_surface_maintenance_supported =
+            has_extension(available_extensions_resval.value, VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME)
+            && has_extension(available_extensions_resval.value, VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME);
+        
+        if (m_surface_maintenance_supported)
+        {
+            required_extensions.push_back(VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME);
+            required_extensions.push_back(VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME);
+        }
+        
         const auto required_validation_layers = get_required_validation_layers();
         
         vk::InstanceCreateFlagBits flags = {};
@@ -403,11 +806,25 @@ namespace mellohi
             for (auto i = 0; i < queue_families.size(); ++i)
             {
                 const auto &queue_family = queue_families[i];
-                if (queue_family.queueFlags & vk::QueueFlagBits::eGraphics)
+                if ((queue_family.queueFlags & vk::QueueFlagBits::eGraphics)
+                    && (queue_family.queueFlags & vk::QueueFlagBits::eCompute))
                 {
                     queue_family_indices.try_emplace(QueueCapability::Graphics, i);
                 }
                 
+                if ((queue_family.queueFlags & vk::QueueFlagBits::eCompute)
+                    && !(queue_family.queueFlags & vk::QueueFlagBits::eGraphics))
+                {
+                    queue_family_indices.try_emplace(QueueCapability::Compute, i);
+                }
+                
+                // Usually backed by the GPU's copy engines, so transfers on it overlap graphics work.
+                if ((queue_family.queueFlags & vk::QueueFlagBits::eTransfer)
+                    && !(queue_family.queueFlags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute)))
+                {
+                    queue_family_indices.try_emplace(QueueCapability::Transfer, i);
+                }
+                
                 VkBool32 present_support = false;
                 const auto _ = physical_device.getSurfaceSupportKHR(i, m_surface, &present_support);
                 if (present_support)
@@ -416,9 +833,31 @@ namespace mellohi
                 }
             }
             
+            // Frames are synchronized with a timeline semaphore and resources are bound through descriptor indexing
+            // (core from Vulkan 1.2), and drawn with dynamic rendering and synchronization2 (core from Vulkan 1.3).
+            const auto features = physical_device.getFeatures2<vk::PhysicalDeviceFeatures2,
+                                                               vk::PhysicalDeviceVulkan12Features,
+                                                               vk::PhysicalDeviceVulkan13Features>();
+            const auto &vulkan_12_features = features.get<vk::PhysicalDeviceVulkan12Features>();
+            const auto &vulkan_13_features = features.get<vk::PhysicalDeviceVulkan13Features>();
+            if (physical_device.getProperties().apiVersion < VK_API_VERSION_1_3
+                || !vulkan_12_features.timelineSemaphore
+                || !supports_bindless_descriptors(vulkan_12_features)
+                || !vulkan_13_features.dynamicRendering
+                || !vulkan_13_features.synchronization2)
+            {
+                continue;
+            }
+            
             if (queue_family_indices.contains(QueueCapability::Graphics)
                 && queue_family_indices.contains(QueueCapability::Present))
             {
+                // The graphics family supports compute, as required above, and therefore transfers.
+                queue_family_indices.try_emplace(QueueCapability::Compute,
+                                                 queue_family_indices.at(QueueCapability::Graphics));
+                queue_family_indices.try_emplace(QueueCapability::Transfer,
+                                                 queue_family_indices.at(QueueCapability::Graphics));
+                
                 m_queue_family_indices = queue_family_indices;
                 m_physical_device = physical_device;
                 
@@ -434,25 +873,120 @@ namespace mellohi
     
     void Device::create_device()
     {
+        // Capabilities sharing a family still get their own queue while the family has enough, so that e.g.
+        // compute on the graphics family can overlap rendering on GPUs that schedule queues independently. Present
+        // always shares the graphics queue when it can. Background work is prioritized below rendering.
+        const auto queue_families = m_physical_device.getQueueFamilyProperties();
+        std::unordered_map<u32, std::vector<f32>> queue_priorities;
+        std::unordered_map<QueueCapability, u32> queue_indices;
+        for (const auto capability : {QueueCapability::Graphics, QueueCapability::Present,
+                                      QueueCapability::Compute, QueueCapability::Transfer})
+        {
+            if (capability == QueueCapability::Present && shares_queue_family(capability, QueueCapability::Graphics))
+            {
+                queue_indices[capability] = queue_indices.at(QueueCapability::Graphics);
+                continue;
+            }
+            
+            const auto queue_family_index = get_queue_family_index(capability);
+            auto &priorities = queue_priorities[queue_family_index];
+            if (priorities.size() < queue_families[queue_family_index].queueCount)
+            {
+                const auto is_rendering = capability == QueueCapability::Graphics
+                                          || capability == QueueCapability::Present;
+                priorities.push_back(is_rendering ? 1.0f : 0.5f);
+            }
+            
+            queue_indices[capability] = static_cast<u32>(priorities.size() - 1);
+        }
+        
         std::vector<vk::DeviceQueueCreateInfo> device_queue_create_infos;
-        const f32 queue_priority = 1.0f;
-        for (const u32 queue_family_index : get_unique_queue_family_indices())
+        for (const auto &[queue_family_index, priorities] : queue_priorities)
         {
             device_queue_create_infos.push_back(vk::DeviceQueueCreateInfo
             {
                 .queueFamilyIndex = queue_family_index,
-                .queueCount = 1,
-                .pQueuePriorities = &queue_priority,
+                .queueCount = static_cast<u32>(priorities.size()),
+                .pQueuePriorities = priorities.data(),
             });
         }
         
-        const vk::PhysicalDeviceFeatures physical_device_features;
+        // Optional; lets draws of different vertex ranges be merged into one call, and lets the GPU decide how many
+        // draws an indirect call makes.
+        const auto supported_features = m_physical_device.getFeatures2<vk::PhysicalDeviceFeatures2,
+                                                                       vk::PhysicalDeviceVulkan12Features>();
+        const auto &supported_core_features = supported_features.get<vk::PhysicalDeviceFeatures2>().features;
+        const auto &supported_vulkan_12_features = supported_features.get<vk::PhysicalDeviceVulkan12Features>();
+        m_multi_draw_indirect_supported = supported_core_features.multiDrawIndirect
+                                          && supported_core_features.drawIndirectFirstInstance;
+        m_draw_indirect_count_supported = m_multi_draw_indirect_supported
+                                          && supported_vulkan_12_features.drawIndirectCount;
+        
+        const vk::PhysicalDeviceFeatures physical_device_features
+        {
+            .multiDrawIndirect = m_multi_draw_indirect_supported,
+            .drawIndirectFirstInstance = m_multi_draw_indirect_supported,
+        };
+        vk::PhysicalDeviceVulkan13Features physical_device_vulkan_13_features
+        {
+            .synchronization2 = vk::True,
+            .dynamicRendering = vk::True,
+        };
+        vk::PhysicalDeviceVulkan12Features physical_device_vulkan_12_features
+        {
+            .pNext = &physical_device_vulkan_13_features,
+            .drawIndirectCount = m_draw_indirect_count_supported,
+            .shaderSampledImageArrayNonUniformIndexing = vk::True,
+            .shaderStorageBufferArrayNonUniformIndexing = vk::True,
+            .descriptorBindingSampledImageUpdateAfterBind = vk::True,
+            .descriptorBindingStorageBufferUpdateAfterBind = vk::True,
+            .descriptorBindingUpdateUnusedWhilePending = vk::True,
+            .descriptorBindingPartiallyBound = vk::True,
+            .runtimeDescriptorArray = vk::True,
+            .timelineSemaphore = vk::True,
+        };
+        
+        auto required_device_extensions = get_required_device_extensions();
+        
+        const auto available_extensions_resval = m_physical_device.enumerateDeviceExtensionProperties();
+        MH_ASSERT_VK(available_extensions_resval.result, "Failed to enumerate Vulkan device extensions.");
+        const auto &available_extensions = available_extensions_resval.value;
+        
+        // Optional; lets GPU memory usage be reported against what the driver actually has available.
+        m_memory_budget_supported = has_extension(available_extensions, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        if (m_memory_budget_supported)
+        {
+            required_device_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        }
+        
+        // Optional; lets the swapchain retire what presentation uses without waiting for the device to idle.
+        if (m_surface_maintenance_supported
+            && has_extension(available_extensions, VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME))
+        {
+            const auto supported_swapchain_features = m_physical_device.getFeatures2<
+                vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceSwapchainMaintenance1FeaturesEXT>();
+            m_present_fences_supported = supported_swapchain_features
+                .get<vk::PhysicalDeviceSwapchainMaintenance1FeaturesEXT>().swapchainMaintenance1;
+        }
+        
+        if (m_present_fences_supported)
+        {
+            required_device_extensions.push_back(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME);
+        }
+        
+        vk::PhysicalDeviceSwapchainMaintenance1FeaturesEXT physical_device_swapchain_maintenance_1_features
+        {
+            .pNext = &physical_device_vulkan_12_features,
+            .swapchainMaintenance1 = vk::True,
+        };
         
-        const auto required_device_extensions = get_required_device_extensions();
         const auto required_validation_layers = get_required_validation_layers();
         
         const vk::DeviceCreateInfo device_create_info
         {
+            .pNext = m_present_fences_supported
+                ? static_cast<const void *>(&physical_device_swapchain_maintenance_1_features)
+                : static_cast<const void *>(&physical_device_vulkan_12_features),
             .queueCreateInfoCount = static_cast<u32>(device_queue_create_infos.size()),
             .pQueueCreateInfos = device_queue_create_infos.data(),
             .pEnabledFeatures = &physical_device_features,
@@ -466,12 +1000,23 @@ namespace mellohi
         MH_ASSERT_VK(device_resval.result, "Failed to create Vulkan logical device.");
         m_device = device_resval.value;
         
-        for (const u32 queue_family_index : get_unique_queue_family_indices())
+        for (const auto &[capability, queue_index] : queue_indices)
         {
             vk::Queue queue;
-            m_device.getQueue(queue_family_index, 0, &queue);
-            m_queues.try_emplace(queue_family_index, queue);
+            m_device.getQueue(get_queue_family_index(capability), queue_index, &queue);
+            m_queues.try_emplace(capability, queue);
+            m_queue_mutexes.try_emplace(queue);
         }
+        
+        MH_INFO("Using queue families {} for graphics, {} for compute and {} for transfers.",
+                get_queue_family_index(QueueCapability::Graphics), get_queue_family_index(QueueCapability::Compute),
+                get_queue_family_index(QueueCapability::Transfer));
+    }
+    
+    void Device::create_memory_allocator()
+    {
+        m_memory_allocator_ptr = std::make_unique<MemoryAllocator>(m_physical_device, m_device,
+                                                                   m_memory_budget_supported);
     }
     
     void Device::choose_preferred_surface_format()
@@ -490,6 +1035,130 @@ namespace mellohi
         }
     }
     
+    // Prepended to the driver's pipeline cache data. The driver validates its own header, but a driver update can keep
+    // the same cache UUID, so the driver version is checked here as well.
+    struct PipelineCacheFileHeader
+    {
+        std::array<char, 4> magic;
+        u32 vendor_id;
+        u32 device_id;
+        u32 driver_version;
+        std::array<u8, VK_UUID_SIZE> pipeline_cache_uuid;
+        u64 data_size;
+    };
+    
+    static constexpr std::array<char, 4> PIPELINE_CACHE_FILE_MAGIC{'M', 'H', 'P', 'C'};
+    
+    static std::filesystem::path get_pipeline_cache_file_path()
+    {
+        return std::filesystem::path(MH_CACHE_DIR) / "pipeline_cache.bin";
+    }
+    
+    static PipelineCacheFileHeader make_pipeline_cache_file_header(const vk::PhysicalDeviceProperties &properties,
+                                                                   const u64 data_size)
+    {
+        return PipelineCacheFileHeader
+        {
+            .magic = PIPELINE_CACHE_FILE_MAGIC,
+            .vendor_id = properties.vendorID,
+            .device_id = properties.deviceID,
+            .driver_version = properties.driverVersion,
+            .pipeline_cache_uuid = properties.pipelineCacheUUID,
+            .data_size = data_size,
+        };
+    }
+    
+    void Device::create_pipeline_cache()
+    {
+        const auto properties = m_physical_device.getProperties();
+        
+        std::vector<u8> initial_data;
+        
+        std::ifstream ifs(get_pipeline_cache_file_path(), std::ios::binary);
+        PipelineCacheFileHeader header{};
+        if (ifs.read(reinterpret_cast<char *>(&header), sizeof(header)))
+        {
+            const auto expected_header = make_pipeline_cache_file_header(properties, header.data_size);
+            if (std::memcmp(&header, &expected_header, sizeof(header)) == 0)
+            {
+                initial_data.resize(header.data_size);
+                if (!ifs.read(reinterpret_cast<char *>(initial_data.data()), initial_data.size()))
+                {
+                    initial_data.clear();
+                }
+            }
+            
+            if (initial_data.empty())
+            {
+                MH_INFO("Discarding pipeline cache from a different device or driver.");
+            }
+        }
+        
+        const vk::PipelineCacheCreateInfo pipeline_cache_create_info
+        {
+            .initialDataSize = initial_data.size(),
+            .pInitialData = initial_data.data(),
+        };
+        
+        auto resval = m_device.createPipelineCache(pipeline_cache_create_info);
+        if (resval.result != vk::Result::eSuccess && !initial_data.empty())
+        {
+            MH_WARN("Driver rejected the pipeline cache. Starting with an empty one.");
+            resval = m_device.createPipelineCache(vk::PipelineCacheCreateInfo{});
+        }
+        MH_ASSERT_VK(resval.result, "Failed to create Vulkan pipeline cache.");
+        m_pipeline_cache = resval.value;
+        
+        MH_DEBUG("Loaded {} bytes of pipeline cache.", initial_data.size());
+    }
+    
+    void Device::create_frame_timeline_semaphore()
+    {
+        m_frame_timeline_semaphore = create_timeline_semaphore();
+    }
+    
+    void Device::save_pipeline_cache() const
+    {
+        const auto resval = m_device.getPipelineCacheData(m_pipeline_cache);
+        if (resval.result != vk::Result::eSuccess)
+        {
+            MH_WARN("Failed to get Vulkan pipeline cache data.");
+            return;
+        }
+        const auto &data = resval.value;
+        
+        const auto file_path = get_pipeline_cache_file_path();
+        auto temp_file_path = file_path;
+        temp_file_path += ".tmp";
+        
+        std::error_code error_code;
+        std::filesystem::create_directories(file_path.parent_path(), error_code);
+        
+        {
+            const auto header = make_pipeline_cache_file_header(m_physical_device.getProperties(), data.size());
+            
+            std::ofstream ofs(temp_file_path, std::ios::binary | std::ios::trunc);
+            ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            ofs.write(reinterpret_cast<const char *>(data.data()), data.size());
+            
+            if (!ofs)
+            {
+                MH_WARN("Failed to write pipeline cache to {}.", file_path.string());
+                return;
+            }
+        }
+        
+        // Replaced in one step so that a crash mid-write never leaves a truncated cache behind.
+        std::filesystem::rename(temp_file_path, file_path, error_code);
+        if (error_code)
+        {
+            MH_WARN("Failed to write pipeline cache to {}: {}", file_path.string(), error_code.message());
+            return;
+        }
+        
+        MH_DEBUG("Saved {} bytes of pipeline cache.", data.size());
+    }
+    
     // TODO: Validate whether extensions and layers are available.
     std::vector<const char *> Device::get_required_instance_extensions(const Platform &platform)
     {
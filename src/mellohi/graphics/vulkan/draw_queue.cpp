@@ -0,0 +1,230 @@
+#include "mellohi/graphics/vulkan/draw_queue.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace mellohi
+{
+    // Fewer batches than this are recorded inline, since secondary command buffers would cost more than they save.
+    static constexpr usize MIN_BATCHES_FOR_PARALLEL_RECORDING = 256;
+    
+    DrawQueue::DrawQueue(const std::shared_ptr<RenderPass> render_pass_ptr)
+        : m_render_pass_ptr(render_pass_ptr), m_packets(MAX_DRAW_PACKETS), m_instance_data(INSTANCE_DATA_CAPACITY)
+    {
+        
+    }
+    
+    void DrawQueue::submit(const DrawPacket &packet, const std::span<const std::byte> instance_data)
+    {
+        MH_ASSERT_DEBUG(packet.material_ptr, "Draw packet must have a material.");
+        MH_ASSERT_DEBUG(instance_data.size() % 16 == 0, "Instance data of {} bytes is not a multiple of 16 bytes.",
+                        instance_data.size());
+        
+        const auto packet_index = m_packet_count.fetch_add(1, std::memory_order_relaxed);
+        MH_ASSERT(packet_index < MAX_DRAW_PACKETS, "Draw queue is out of space for this frame.");
+        
+        const auto instance_data_offset = m_instance_data_size.fetch_add(instance_data.size(),
+                                                                         std::memory_order_relaxed);
+        MH_ASSERT(instance_data_offset + instance_data.size() <= INSTANCE_DATA_CAPACITY,
+                  "Draw queue is out of space for instance data this frame.");
+        std::memcpy(m_instance_data.data() + instance_data_offset, instance_data.data(), instance_data.size());
+        
+        m_packets[packet_index] = QueuedPacket
+        {
+            .packet = packet,
+            .instance_data_offset = static_cast<u32>(instance_data_offset),
+            .instance_data_size = static_cast<u32>(instance_data.size()),
+        };
+    }
+    
+    void DrawQueue::record(const vk::CommandBuffer command_buffer)
+    {
+        const auto packet_count = m_packet_count.load(std::memory_order_acquire);
+        
+        m_sort_entries.clear();
+        for (u32 packet_index = 0; packet_index < packet_count; ++packet_index)
+        {
+            const auto &packet = m_packets[packet_index].packet;
+            
+            // Rebuilt pipelines are swapped in here, on the main thread, so that the key and the bound pipeline agree.
+            packet.material_ptr->update_graphics_pipeline();
+            
+            m_sort_entries.push_back({
+                .key = make_sort_key(packet.pass, packet.material_ptr->get_graphics_pipeline().get_id(),
+                                     packet.material_ptr->get_material_id(), packet.depth),
+                .packet_index = packet_index,
+            });
+        }
+        
+        radix_sort(m_sort_entries, m_sort_scratch);
+        build_batches();
+        
+        if (m_batches.size() >= MIN_BATCHES_FOR_PARALLEL_RECORDING)
+        {
+            m_render_pass_ptr->record_parallel(m_batches.size(),
+                [this](const vk::CommandBuffer secondary_command_buffer, const usize begin, const usize end)
+                {
+                    record_batches(secondary_command_buffer, begin, end);
+                });
+        }
+        else
+        {
+            record_batches(command_buffer, 0, m_batches.size());
+        }
+        
+        m_packet_count.store(0, std::memory_order_relaxed);
+        m_instance_data_size.store(0, std::memory_order_relaxed);
+    }
+    
+    // From most to least significant: 8 bits of pass, 16 of pipeline, 16 of material and 24 of depth.
+    u64 DrawQueue::make_sort_key(const u8 pass, const u32 pipeline_id, const u32 material_id, const f32 depth)
+    {
+        const auto quantized_depth = static_cast<u64>(std::clamp(depth, 0.0f, 1.0f) * static_cast<f32>(0xffffff));
+        
+        return static_cast<u64>(pass) << 56
+               | static_cast<u64>(pipeline_id & 0xffff) << 40
+               | static_cast<u64>(material_id & 0xffff) << 24
+               | quantized_depth;
+    }
+    
+    // Least significant byte first. Passes over bytes every key shares are skipped, which with draws sharing most of
+    // their state is most of them.
+    void DrawQueue::radix_sort(std::vector<SortEntry> &entries, std::vector<SortEntry> &scratch)
+    {
+        scratch.resize(entries.size());
+        
+        for (u32 shift = 0; shift < 64; shift += 8)
+        {
+            std::array<usize, 256> offsets{};
+            for (const auto &entry : entries)
+            {
+                ++offsets[entry.key >> shift & 0xff];
+            }
+            
+            if (std::ranges::find(offsets, entries.size()) != offsets.end())
+            {
+                continue;
+            }
+            
+            usize offset = 0;
+            for (auto &bucket_offset : offsets)
+            {
+                const auto count = bucket_offset;
+                bucket_offset = offset;
+                offset += count;
+            }
+            
+            for (const auto &entry : entries)
+            {
+                scratch[offsets[entry.key >> shift & 0xff]++] = entry;
+            }
+            
+            entries.swap(scratch);
+        }
+    }
+    
+    void DrawQueue::build_batches()
+    {
+        m_batches.clear();
+        
+        for (usize entry_index = 0; entry_index < m_sort_entries.size(); ++entry_index)
+        {
+            const auto &packet = m_packets[m_sort_entries[entry_index].packet_index];
+            
+            if (!m_batches.empty())
+            {
+                auto &batch = m_batches.back();
+                const auto &batch_packet = m_packets[m_sort_entries[batch.first_entry_index].packet_index];
+                
+                const auto max_entry_count = batch_packet.instance_data_size > 0
+                    ? std::min<usize>(MAX_DRAWS_PER_BATCH,
+                                      UniformRing::MAX_UNIFORM_SIZE / batch_packet.instance_data_size)
+                    : MAX_DRAWS_PER_BATCH;
+                
+                if (batch.entry_count < max_entry_count && can_merge(batch_packet, packet))
+                {
+                    ++batch.entry_count;
+                    continue;
+                }
+            }
+            
+            m_batches.push_back({ .first_entry_index = entry_index, .entry_count = 1 });
+        }
+    }
+    
+    // Safe to call from several threads at once for different batches.
+    void DrawQueue::record_batches(const vk::CommandBuffer command_buffer, const usize begin, const usize end)
+    {
+        vk::Pipeline bound_pipeline;
+        std::vector<vk::DrawIndirectCommand> draw_commands;
+        
+        for (usize batch_index = begin; batch_index < end; ++batch_index)
+        {
+            const auto &batch = m_batches[batch_index];
+            const auto entries = std::span(m_sort_entries).subspan(batch.first_entry_index, batch.entry_count);
+            const auto &batch_packet = m_packets[entries.front().packet_index];
+            
+            const auto pipeline = batch_packet.packet.material_ptr->get_graphics_pipeline().get_pipeline();
+            if (pipeline != bound_pipeline)
+            {
+                command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+                bound_pipeline = pipeline;
+            }
+            
+            // Instances are numbered across the whole batch, so each one's data sits at its gl_InstanceIndex.
+            if (batch_packet.instance_data_size > 0)
+            {
+                auto instance_data = m_render_pass_ptr->allocate_draw_uniforms(
+                    command_buffer, entries.size() * batch_packet.instance_data_size
+                );
+                for (const auto &entry : entries)
+                {
+                    const auto &queued_packet = m_packets[entry.packet_index];
+                    std::memcpy(instance_data.data(), m_instance_data.data() + queued_packet.instance_data_offset,
+                                queued_packet.instance_data_size);
+                    instance_data = instance_data.subspan(queued_packet.instance_data_size);
+                }
+            }
+            
+            // Runs of the same vertex range become one instanced draw.
+            draw_commands.clear();
+            for (u32 instance_index = 0; instance_index < entries.size(); ++instance_index)
+            {
+                const auto &packet = m_packets[entries[instance_index].packet_index].packet;
+                
+                if (!draw_commands.empty() && draw_commands.back().vertexCount == packet.vertex_count
+                    && draw_commands.back().firstVertex == packet.first_vertex)
+                {
+                    ++draw_commands.back().instanceCount;
+                    continue;
+                }
+                
+                draw_commands.push_back({
+                    .vertexCount = packet.vertex_count,
+                    .instanceCount = 1,
+                    .firstVertex = packet.first_vertex,
+                    .firstInstance = instance_index,
+                });
+            }
+            
+            if (draw_commands.size() == 1)
+            {
+                const auto &draw_command = draw_commands.front();
+                command_buffer.draw(draw_command.vertexCount, draw_command.instanceCount, draw_command.firstVertex,
+                                    draw_command.firstInstance);
+            }
+            else
+            {
+                m_render_pass_ptr->draw_indirect(command_buffer, draw_commands);
+            }
+        }
+    }
+    
+    // The material decides every piece of state besides the draw uniforms, which a batch shares.
+    bool DrawQueue::can_merge(const QueuedPacket &batch_packet, const QueuedPacket &packet)
+    {
+        return packet.packet.pass == batch_packet.packet.pass
+               && packet.packet.material_ptr == batch_packet.packet.material_ptr
+               && packet.instance_data_size == batch_packet.instance_data_size;
+    }
+}
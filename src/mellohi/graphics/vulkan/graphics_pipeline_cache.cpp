@@ -0,0 +1,382 @@
+#include "mellohi/graphics/vulkan/graphics_pipeline_cache.hpp"
+
+#include "mellohi/core/hash.hpp"
+
+namespace mellohi
+{
+    std::optional<BlendMode> blend_mode_from_string(const std::string_view str)
+    {
+        if (str == "opaque")
+        {
+            return BlendMode::Opaque;
+        }
+        else if (str == "alpha")
+        {
+            return BlendMode::Alpha;
+        }
+        else if (str == "additive")
+        {
+            return BlendMode::Additive;
+        }
+        
+        return std::nullopt;
+    }
+    
+    template<typename Handle>
+    static u64 hash_handle(const Handle handle, const u64 hash)
+    {
+        return fnv1a_64_value(static_cast<typename Handle::CType>(handle), hash);
+    }
+    
+    template<typename Enum>
+    static u64 hash_enum(const Enum value, const u64 hash)
+    {
+        return fnv1a_64_value(static_cast<std::underlying_type_t<Enum>>(value), hash);
+    }
+    
+    u64 PipelineLayoutKey::get_hash() const
+    {
+        auto hash = FNV1A_64_OFFSET_BASIS;
+        for (const auto descriptor_set_layout : descriptor_set_layouts)
+        {
+            hash = hash_handle(descriptor_set_layout, hash);
+        }
+        
+        for (const auto &push_constant_range : push_constant_ranges)
+        {
+            hash = fnv1a_64_value(static_cast<VkShaderStageFlags>(push_constant_range.stageFlags), hash);
+            hash = fnv1a_64_value(push_constant_range.offset, hash);
+            hash = fnv1a_64_value(push_constant_range.size, hash);
+        }
+        
+        return hash;
+    }
+    
+    bool GraphicsPipelineKey::operator==(const GraphicsPipelineKey &other) const
+    {
+        return vert_shader_module_id == other.vert_shader_module_id
+               && frag_shader_module_id == other.frag_shader_module_id
+               && vertex_bindings == other.vertex_bindings
+               && vertex_attributes == other.vertex_attributes
+               && topology == other.topology
+               && polygon_mode == other.polygon_mode
+               && cull_mode == other.cull_mode
+               && front_face == other.front_face
+               && depth_test == other.depth_test
+               && depth_write == other.depth_write
+               && depth_compare_op == other.depth_compare_op
+               && blend_mode == other.blend_mode
+               && color_attachment_format == other.color_attachment_format
+               && depth_attachment_format == other.depth_attachment_format
+               && layout_key == other.layout_key;
+    }
+    
+    u64 GraphicsPipelineKey::get_hash() const
+    {
+        auto hash = fnv1a_64_value(vert_shader_module_id);
+        hash = fnv1a_64_value(frag_shader_module_id, hash);
+        
+        for (const auto &vertex_binding : vertex_bindings)
+        {
+            hash = fnv1a_64_value(vertex_binding.binding, hash);
+            hash = fnv1a_64_value(vertex_binding.stride, hash);
+            hash = hash_enum(vertex_binding.inputRate, hash);
+        }
+        
+        for (const auto &vertex_attribute : vertex_attributes)
+        {
+            hash = fnv1a_64_value(vertex_attribute.location, hash);
+            hash = fnv1a_64_value(vertex_attribute.binding, hash);
+            hash = hash_enum(vertex_attribute.format, hash);
+            hash = fnv1a_64_value(vertex_attribute.offset, hash);
+        }
+        
+        hash = hash_enum(topology, hash);
+        hash = hash_enum(polygon_mode, hash);
+        hash = fnv1a_64_value(static_cast<VkCullModeFlags>(cull_mode), hash);
+        hash = hash_enum(front_face, hash);
+        hash = fnv1a_64_value(static_cast<u8>(depth_test), hash);
+        hash = fnv1a_64_value(static_cast<u8>(depth_write), hash);
+        hash = hash_enum(depth_compare_op, hash);
+        hash = hash_enum(blend_mode, hash);
+        hash = hash_enum(color_attachment_format, hash);
+        hash = hash_enum(depth_attachment_format, hash);
+        
+        return fnv1a_64_value(layout_key.get_hash(), hash);
+    }
+    
+    static std::atomic<u32> next_graphics_pipeline_id = 0;
+    
+    GraphicsPipeline::GraphicsPipeline(const std::shared_ptr<Device> device_ptr, const vk::Pipeline pipeline,
+                                       const vk::PipelineLayout layout)
+        : m_device_ptr(device_ptr), m_pipeline(pipeline), m_layout(layout), m_id(next_graphics_pipeline_id++)
+    {
+        
+    }
+    
+    GraphicsPipeline::~GraphicsPipeline()
+    {
+        m_device_ptr->push_to_deletion_queue(m_pipeline);
+    }
+    
+    vk::Pipeline GraphicsPipeline::get_pipeline() const
+    {
+        return m_pipeline;
+    }
+    
+    vk::PipelineLayout GraphicsPipeline::get_layout() const
+    {
+        return m_layout;
+    }
+    
+    u32 GraphicsPipeline::get_id() const
+    {
+        return m_id;
+    }
+    
+    GraphicsPipelineCache::GraphicsPipelineCache(const std::shared_ptr<Device> device_ptr) : m_device_ptr(device_ptr)
+    {
+        
+    }
+    
+    GraphicsPipelineCache::~GraphicsPipelineCache()
+    {
+        // Command buffers that are still executing may have been recorded with these.
+        for (const auto &[key, layout] : m_layouts)
+        {
+            m_device_ptr->push_to_deletion_queue(layout);
+        }
+    }
+    
+    std::shared_ptr<GraphicsPipeline> GraphicsPipelineCache::get_or_create_pipeline(const GraphicsPipelineKey &key)
+    {
+        std::promise<std::shared_ptr<GraphicsPipeline>> built_promise;
+        {
+            std::unique_lock<std::mutex> lock(m_pipelines_mutex);
+            
+            const auto pipeline_it = m_pipelines.find(key);
+            if (pipeline_it != m_pipelines.end())
+            {
+                if (auto pipeline_ptr = pipeline_it->second.lock())
+                {
+                    ++m_hit_count;
+                    return pipeline_ptr;
+                }
+            }
+            
+            const auto pending_pipeline_it = m_pending_pipelines.find(key);
+            if (pending_pipeline_it != m_pending_pipelines.end())
+            {
+                ++m_hit_count;
+                
+                const auto pending_pipeline_future = pending_pipeline_it->second;
+                lock.unlock();
+                return pending_pipeline_future.get();
+            }
+            
+            ++m_miss_count;
+            m_pending_pipelines.emplace(key, built_promise.get_future().share());
+        }
+        
+        // Built outside the lock, since compiling a pipeline can take a while.
+        const auto layout = get_or_create_layout(key.layout_key);
+        const auto pipeline_ptr = std::make_shared<GraphicsPipeline>(m_device_ptr, create_pipeline(key, layout), layout);
+        
+        {
+            const std::lock_guard<std::mutex> lock(m_pipelines_mutex);
+            
+            m_pending_pipelines.erase(key);
+            m_pipelines.insert_or_assign(key, pipeline_ptr);
+            
+            // Entries of pipelines that nothing uses anymore are dropped whenever a new one is added.
+            std::erase_if(m_pipelines, [](const auto &entry) { return entry.second.expired(); });
+        }
+        
+        built_promise.set_value(pipeline_ptr);
+        return pipeline_ptr;
+    }
+    
+    vk::PipelineLayout GraphicsPipelineCache::get_or_create_layout(const PipelineLayoutKey &key)
+    {
+        const std::lock_guard<std::mutex> lock(m_layouts_mutex);
+        
+        const auto layout_it = m_layouts.find(key);
+        if (layout_it != m_layouts.end())
+        {
+            return layout_it->second;
+        }
+        
+        const vk::PipelineLayoutCreateInfo pipeline_layout_create_info
+        {
+            .setLayoutCount = static_cast<u32>(key.descriptor_set_layouts.size()),
+            .pSetLayouts = key.descriptor_set_layouts.data(),
+            .pushConstantRangeCount = static_cast<u32>(key.push_constant_ranges.size()),
+            .pPushConstantRanges = key.push_constant_ranges.data(),
+        };
+        
+        const auto layout = m_device_ptr->create_pipeline_layout(pipeline_layout_create_info);
+        m_layouts.emplace(key, layout);
+        return layout;
+    }
+    
+    usize GraphicsPipelineCache::get_hit_count() const
+    {
+        return m_hit_count;
+    }
+    
+    usize GraphicsPipelineCache::get_miss_count() const
+    {
+        return m_miss_count;
+    }
+    
+    vk::Pipeline GraphicsPipelineCache::create_pipeline(const GraphicsPipelineKey &key,
+                                                        const vk::PipelineLayout layout) const
+    {
+        const vk::PipelineShaderStageCreateInfo shader_stages[]
+        {
+            {
+                .stage = vk::ShaderStageFlagBits::eVertex,
+                .module = key.vert_shader_module,
+                .pName = "main",
+            },
+            {
+                .stage = vk::ShaderStageFlagBits::eFragment,
+                .module = key.frag_shader_module,
+                .pName = "main",
+            },
+        };
+        
+        const std::vector dynamic_states
+        {
+            vk::DynamicState::eViewport,
+            vk::DynamicState::eScissor,
+        };
+        const vk::PipelineDynamicStateCreateInfo dynamic_state_create_info
+        {
+            .dynamicStateCount = static_cast<u32>(dynamic_states.size()),
+            .pDynamicStates = dynamic_states.data(),
+        };
+        
+        const vk::PipelineVertexInputStateCreateInfo vertex_input_state_create_info
+        {
+            .vertexBindingDescriptionCount = static_cast<u32>(key.vertex_bindings.size()),
+            .pVertexBindingDescriptions = key.vertex_bindings.data(),
+            .vertexAttributeDescriptionCount = static_cast<u32>(key.vertex_attributes.size()),
+            .pVertexAttributeDescriptions = key.vertex_attributes.data(),
+        };
+        
+        const vk::PipelineInputAssemblyStateCreateInfo input_assembly_state_create_info
+        {
+            .topology = key.topology,
+            .primitiveRestartEnable = vk::False,
+        };
+        
+        const vk::PipelineViewportStateCreateInfo viewport_state_create_info
+        {
+            .viewportCount = 1,
+            .scissorCount = 1,
+        };
+        
+        const vk::PipelineRasterizationStateCreateInfo rasterization_state_create_info
+        {
+            .depthClampEnable = vk::False,
+            .rasterizerDiscardEnable = vk::False,
+            .polygonMode = key.polygon_mode,
+            .lineWidth = 1.0f,
+            .cullMode = key.cull_mode,
+            .frontFace = key.front_face,
+            .depthBiasEnable = vk::False,
+            .depthBiasConstantFactor = 0.0f,
+            .depthBiasClamp = 0.0f,
+            .depthBiasSlopeFactor = 0.0f,
+        };
+        
+        const vk::PipelineMultisampleStateCreateInfo multisample_state_create_info
+        {
+            .sampleShadingEnable = vk::False,
+            .rasterizationSamples = vk::SampleCountFlagBits::e1,
+            .minSampleShading = 1.0f,
+            .pSampleMask = nullptr,
+            .alphaToCoverageEnable = vk::False,
+            .alphaToOneEnable = vk::False,
+        };
+        
+        const vk::PipelineDepthStencilStateCreateInfo depth_stencil_state_create_info
+        {
+            .depthTestEnable = key.depth_test,
+            .depthWriteEnable = key.depth_write,
+            .depthCompareOp = key.depth_compare_op,
+            .depthBoundsTestEnable = vk::False,
+            .stencilTestEnable = vk::False,
+        };
+        
+        vk::PipelineColorBlendAttachmentState color_blend_attachment_state
+        {
+            .colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG
+                            | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA,
+            .blendEnable = vk::False,
+            .srcColorBlendFactor = vk::BlendFactor::eOne,
+            .dstColorBlendFactor = vk::BlendFactor::eZero,
+            .colorBlendOp = vk::BlendOp::eAdd,
+            .srcAlphaBlendFactor = vk::BlendFactor::eOne,
+            .dstAlphaBlendFactor = vk::BlendFactor::eZero,
+            .alphaBlendOp = vk::BlendOp::eAdd,
+        };
+        
+        switch (key.blend_mode)
+        {
+            case BlendMode::Opaque:
+                break;
+            case BlendMode::Alpha:
+                color_blend_attachment_state.blendEnable = vk::True;
+                color_blend_attachment_state.srcColorBlendFactor = vk::BlendFactor::eSrcAlpha;
+                color_blend_attachment_state.dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+                color_blend_attachment_state.dstAlphaBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+                break;
+            case BlendMode::Additive:
+                color_blend_attachment_state.blendEnable = vk::True;
+                color_blend_attachment_state.srcColorBlendFactor = vk::BlendFactor::eSrcAlpha;
+                color_blend_attachment_state.dstColorBlendFactor = vk::BlendFactor::eOne;
+                color_blend_attachment_state.dstAlphaBlendFactor = vk::BlendFactor::eOne;
+                break;
+        }
+        
+        const vk::PipelineColorBlendStateCreateInfo color_blend_state_create_info
+        {
+            .logicOpEnable = vk::False,
+            .logicOp = vk::LogicOp::eCopy,
+            .attachmentCount = 1,
+            .pAttachments = &color_blend_attachment_state,
+            .blendConstants = {},
+        };
+        
+        const vk::PipelineRenderingCreateInfo pipeline_rendering_create_info
+        {
+            .colorAttachmentCount = 1,
+            .pColorAttachmentFormats = &key.color_attachment_format,
+            .depthAttachmentFormat = key.depth_attachment_format,
+        };
+        
+        const vk::GraphicsPipelineCreateInfo graphics_pipeline_create_info
+        {
+            .pNext = &pipeline_rendering_create_info,
+            .stageCount = 2,
+            .pStages = shader_stages,
+            .pVertexInputState = &vertex_input_state_create_info,
+            .pInputAssemblyState = &input_assembly_state_create_info,
+            .pViewportState = &viewport_state_create_info,
+            .pRasterizationState = &rasterization_state_create_info,
+            .pMultisampleState = &multisample_state_create_info,
+            .pDepthStencilState = &depth_stencil_state_create_info,
+            .pColorBlendState = &color_blend_state_create_info,
+            .pDynamicState = &dynamic_state_create_info,
+            .layout = layout,
+            .renderPass = nullptr,
+            .subpass = 0,
+            .basePipelineHandle = nullptr,
+            .basePipelineIndex = -1,
+        };
+        
+        return m_device_ptr->create_graphics_pipeline(graphics_pipeline_create_info);
+    }
+}
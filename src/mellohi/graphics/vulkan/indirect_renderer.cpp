@@ -0,0 +1,241 @@
+#include "mellohi/graphics/vulkan/indirect_renderer.hpp"
+
+#include "mellohi/core/assets/asset_manager.hpp"
+
+namespace mellohi
+{
+    // Matches the push constants of the culling shader.
+    struct CullConstants
+    {
+        // Normalized, pointing inwards: left, right, bottom, top, near and far.
+        std::array<fvec4, 6> frustum_planes;
+        u32 chunk_buffer_index;
+        u32 draw_command_buffer_index;
+        u32 draw_count_buffer_index;
+        u32 chunk_count;
+    };
+    
+    // Gribb and Hartmann's method, for a clip space with depth in [0, 1].
+    static std::array<fvec4, 6> extract_frustum_planes(const fmat4x4 &view_projection)
+    {
+        std::array<fvec4, 4> rows;
+        for (i32 row = 0; row < 4; ++row)
+        {
+            rows[row] = fvec4(view_projection[0][row], view_projection[1][row], view_projection[2][row],
+                              view_projection[3][row]);
+        }
+        
+        std::array planes
+        {
+            rows[3] + rows[0],
+            rows[3] - rows[0],
+            rows[3] + rows[1],
+            rows[3] - rows[1],
+            rows[2],
+            rows[3] - rows[2],
+        };
+        
+        for (auto &plane : planes)
+        {
+            plane /= glm::length(fvec3(plane));
+        }
+        
+        return planes;
+    }
+    
+    static void record_memory_barrier(const vk::CommandBuffer command_buffer,
+                                      const vk::PipelineStageFlags2 src_stage_mask,
+                                      const vk::AccessFlags2 src_access_mask,
+                                      const vk::PipelineStageFlags2 dst_stage_mask,
+                                      const vk::AccessFlags2 dst_access_mask)
+    {
+        const vk::MemoryBarrier2 memory_barrier
+        {
+            .srcStageMask = src_stage_mask,
+            .srcAccessMask = src_access_mask,
+            .dstStageMask = dst_stage_mask,
+            .dstAccessMask = dst_access_mask,
+        };
+        
+        const vk::DependencyInfo dependency_info
+        {
+            .memoryBarrierCount = 1,
+            .pMemoryBarriers = &memory_barrier,
+        };
+        
+        command_buffer.pipelineBarrier2(dependency_info);
+    }
+    
+    IndirectRenderer::IndirectRenderer(const std::shared_ptr<AssetManager> asset_manager_ptr,
+                                       const std::shared_ptr<Device> device_ptr,
+                                       const std::shared_ptr<RenderPass> render_pass_ptr,
+                                       const std::shared_ptr<UploadScheduler> upload_scheduler_ptr,
+                                       const std::shared_ptr<BindlessDescriptors> bindless_descriptors_ptr)
+        : m_device_ptr(device_ptr), m_render_pass_ptr(render_pass_ptr), m_upload_scheduler_ptr(upload_scheduler_ptr),
+          m_bindless_descriptors_ptr(bindless_descriptors_ptr)
+    {
+        MH_ASSERT(m_device_ptr->supports_draw_indirect_count(),
+                  "Indirect rendering requires a device that supports indirect draw counts.");
+        
+        m_cull_shader_ptr = asset_manager_ptr->load<VulkanShader>(AssetId("mellohi:shaders/cull_chunks.comp"),
+                                                                  m_device_ptr);
+        update_cull_pipeline();
+    }
+    
+    IndirectRenderer::~IndirectRenderer()
+    {
+        retire_buffers();
+        m_device_ptr->push_to_deletion_queue(m_cull_pipeline);
+    }
+    
+    void IndirectRenderer::set_chunks(const std::span<const ChunkDraw> chunks)
+    {
+        retire_buffers();
+        
+        m_chunk_count = static_cast<u32>(chunks.size());
+        if (chunks.empty())
+        {
+            return;
+        }
+        
+        const auto create_buffer = [this](const vk::DeviceSize size, const vk::BufferUsageFlags usage)
+        {
+            const vk::BufferCreateInfo buffer_create_info
+            {
+                .size = size,
+                .usage = vk::BufferUsageFlagBits::eStorageBuffer | usage,
+                .sharingMode = vk::SharingMode::eExclusive,
+            };
+            
+            return m_device_ptr->create_buffer(buffer_create_info, { .usage = MemoryUsage::GpuOnly });
+        };
+        
+        m_chunk_buffer = create_buffer(chunks.size_bytes(), vk::BufferUsageFlagBits::eTransferDst);
+        m_draw_command_buffer = create_buffer(chunks.size() * sizeof(vk::DrawIndexedIndirectCommand),
+                                              vk::BufferUsageFlagBits::eIndirectBuffer);
+        // Cleared with a transfer before every cull.
+        m_draw_count_buffer = create_buffer(sizeof(u32), vk::BufferUsageFlagBits::eIndirectBuffer
+                                                         | vk::BufferUsageFlagBits::eTransferDst);
+        
+        m_chunk_buffer_handle = m_bindless_descriptors_ptr->add_buffer(m_chunk_buffer);
+        m_draw_command_buffer_handle = m_bindless_descriptors_ptr->add_buffer(m_draw_command_buffer);
+        m_draw_count_buffer_handle = m_bindless_descriptors_ptr->add_buffer(m_draw_count_buffer);
+        
+        m_upload_scheduler_ptr->upload_to_buffer(m_chunk_buffer, std::as_bytes(chunks));
+    }
+    
+    void IndirectRenderer::cull(const vk::CommandBuffer command_buffer, const fmat4x4 &view_projection)
+    {
+        if (m_chunk_count == 0)
+        {
+            return;
+        }
+        
+        update_cull_pipeline();
+        
+        // The previous frame's draw may still be reading the commands and count this overwrites.
+        record_memory_barrier(command_buffer,
+                              vk::PipelineStageFlagBits2::eDrawIndirect,
+                              vk::AccessFlagBits2::eIndirectCommandRead,
+                              vk::PipelineStageFlagBits2::eClear | vk::PipelineStageFlagBits2::eComputeShader,
+                              vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eShaderStorageWrite);
+        
+        command_buffer.fillBuffer(m_draw_count_buffer.buffer, 0, sizeof(u32), 0);
+        
+        record_memory_barrier(command_buffer,
+                              vk::PipelineStageFlagBits2::eClear,
+                              vk::AccessFlagBits2::eTransferWrite,
+                              vk::PipelineStageFlagBits2::eComputeShader,
+                              vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+        
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_cull_pipeline);
+        m_render_pass_ptr->push_constants(command_buffer, CullConstants
+        {
+            .frustum_planes = extract_frustum_planes(view_projection),
+            .chunk_buffer_index = m_chunk_buffer_handle.index,
+            .draw_command_buffer_index = m_draw_command_buffer_handle.index,
+            .draw_count_buffer_index = m_draw_count_buffer_handle.index,
+            .chunk_count = m_chunk_count,
+        });
+        command_buffer.dispatch((m_chunk_count + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+        
+        record_memory_barrier(command_buffer,
+                              vk::PipelineStageFlagBits2::eComputeShader,
+                              vk::AccessFlagBits2::eShaderStorageWrite,
+                              vk::PipelineStageFlagBits2::eDrawIndirect,
+                              vk::AccessFlagBits2::eIndirectCommandRead);
+    }
+    
+    void IndirectRenderer::draw(const vk::CommandBuffer command_buffer, const vk::Buffer index_buffer) const
+    {
+        if (m_chunk_count == 0)
+        {
+            return;
+        }
+        
+        // Every chunk is an upper bound on the count the culling shader wrote.
+        command_buffer.bindIndexBuffer(index_buffer, 0, vk::IndexType::eUint32);
+        command_buffer.drawIndexedIndirectCount(m_draw_command_buffer.buffer, 0, m_draw_count_buffer.buffer, 0,
+                                                m_chunk_count, sizeof(vk::DrawIndexedIndirectCommand));
+    }
+    
+    BindlessBufferHandle IndirectRenderer::get_chunk_buffer_handle() const
+    {
+        return m_chunk_buffer_handle;
+    }
+    
+    u32 IndirectRenderer::get_chunk_count() const
+    {
+        return m_chunk_count;
+    }
+    
+    void IndirectRenderer::update_cull_pipeline()
+    {
+        if (m_cull_pipeline && m_cull_shader_module_id == m_cull_shader_ptr->get_shader_module_id())
+        {
+            return;
+        }
+        
+        if (m_cull_pipeline)
+        {
+            m_device_ptr->push_to_deletion_queue(m_cull_pipeline);
+        }
+        
+        // Created against the shared layout, so that the descriptor sets bound by the render pass stay valid.
+        const vk::ComputePipelineCreateInfo compute_pipeline_create_info
+        {
+            .stage =
+            {
+                .stage = vk::ShaderStageFlagBits::eCompute,
+                .module = m_cull_shader_ptr->get_shader_module(),
+                .pName = "main",
+            },
+            .layout = m_render_pass_ptr->get_pipeline_layout(),
+        };
+        
+        m_cull_pipeline = m_device_ptr->create_compute_pipeline(compute_pipeline_create_info);
+        m_cull_shader_module_id = m_cull_shader_ptr->get_shader_module_id();
+    }
+    
+    // The GPU may still be culling or drawing with the buffers, so they are only destroyed once the frame is done.
+    void IndirectRenderer::retire_buffers()
+    {
+        if (m_chunk_count == 0)
+        {
+            return;
+        }
+        
+        m_bindless_descriptors_ptr->remove(m_chunk_buffer_handle);
+        m_bindless_descriptors_ptr->remove(m_draw_command_buffer_handle);
+        m_bindless_descriptors_ptr->remove(m_draw_count_buffer_handle);
+        
+        m_device_ptr->push_to_deletion_queue(m_chunk_buffer);
+        m_device_ptr->push_to_deletion_queue(m_draw_command_buffer);
+        m_device_ptr->push_to_deletion_queue(m_draw_count_buffer);
+        
+        m_chunk_buffer_handle = {};
+        m_draw_command_buffer_handle = {};
+        m_draw_count_buffer_handle = {};
+        m_chunk_count = 0;
+    }
+}
@@ -0,0 +1,463 @@
+#include "mellohi/graphics/vulkan/memory_allocator.hpp"
+
+#include <algorithm>
+
+namespace mellohi
+{
+    static constexpr vk::DeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+    static constexpr vk::DeviceSize SMALL_HEAP_SIZE = 1024ull * 1024 * 1024;
+    static constexpr f64 BYTES_PER_MIB = 1024.0 * 1024.0;
+    
+    struct MemoryBlock
+    {
+        struct FreeRange
+        {
+            vk::DeviceSize offset;
+            vk::DeviceSize size;
+        };
+        
+        vk::DeviceMemory memory;
+        vk::DeviceSize size;
+        void *mapped_ptr;
+        u32 memory_type_index;
+        AllocationStrategy strategy;
+        usize allocation_count = 0;
+        
+        // Free list strategy; sorted by offset with adjacent ranges merged.
+        std::vector<FreeRange> free_ranges;
+        // Linear strategy.
+        vk::DeviceSize linear_offset = 0;
+    };
+    
+    static vk::DeviceSize align_up(const vk::DeviceSize value, const vk::DeviceSize alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+    
+    MemoryAllocator::MemoryAllocator(const vk::PhysicalDevice physical_device, const vk::Device device,
+                                     const bool memory_budget_supported)
+        : m_physical_device(physical_device), m_device(device), m_memory_budget_supported(memory_budget_supported)
+    {
+        m_memory_properties = physical_device.getMemoryProperties();
+        
+        const auto properties_chain = physical_device.getProperties2<vk::PhysicalDeviceProperties2,
+                                                                     vk::PhysicalDeviceMaintenance3Properties>();
+        const auto &limits = properties_chain.get<vk::PhysicalDeviceProperties2>().properties.limits;
+        m_buffer_image_granularity = limits.bufferImageGranularity;
+        m_max_device_memory_count = limits.maxMemoryAllocationCount;
+        m_max_allocation_size = properties_chain.get<vk::PhysicalDeviceMaintenance3Properties>().maxMemoryAllocationSize;
+    }
+    
+    MemoryAllocator::~MemoryAllocator()
+    {
+        for (const auto &block_pool : m_block_pools)
+        {
+            for (const auto &block_ptr : block_pool)
+            {
+                MH_ASSERT_DEBUG(block_ptr->allocation_count == 0, "{} GPU allocations were never freed.",
+                                block_ptr->allocation_count);
+                free_device_memory(block_ptr->memory, block_ptr->size, block_ptr->memory_type_index);
+            }
+        }
+    }
+    
+    Allocation MemoryAllocator::allocate_for_buffer(const vk::Buffer buffer, const AllocationCreateInfo &create_info)
+    {
+        const vk::BufferMemoryRequirementsInfo2 requirements_info
+        {
+            .buffer = buffer,
+        };
+        const auto requirements_chain = m_device.getBufferMemoryRequirements2<vk::MemoryRequirements2,
+                                                                              vk::MemoryDedicatedRequirements>(
+            requirements_info
+        );
+        const auto &dedicated_requirements = requirements_chain.get<vk::MemoryDedicatedRequirements>();
+        
+        return allocate(requirements_chain.get<vk::MemoryRequirements2>().memoryRequirements, create_info,
+                        vk::MemoryDedicatedAllocateInfo{ .buffer = buffer },
+                        dedicated_requirements.prefersDedicatedAllocation);
+    }
+    
+    Allocation MemoryAllocator::allocate_for_image(const vk::Image image, const AllocationCreateInfo &create_info)
+    {
+        const vk::ImageMemoryRequirementsInfo2 requirements_info
+        {
+            .image = image,
+        };
+        const auto requirements_chain = m_device.getImageMemoryRequirements2<vk::MemoryRequirements2,
+                                                                             vk::MemoryDedicatedRequirements>(
+            requirements_info
+        );
+        const auto &dedicated_requirements = requirements_chain.get<vk::MemoryDedicatedRequirements>();
+        
+        return allocate(requirements_chain.get<vk::MemoryRequirements2>().memoryRequirements, create_info,
+                        vk::MemoryDedicatedAllocateInfo{ .image = image },
+                        dedicated_requirements.prefersDedicatedAllocation);
+    }
+    
+    Allocation MemoryAllocator::allocate(const vk::MemoryRequirements &requirements,
+                                         const AllocationCreateInfo &create_info)
+    {
+        return allocate(requirements, create_info, vk::MemoryDedicatedAllocateInfo{}, false);
+    }
+    
+    void MemoryAllocator::free(const Allocation &allocation)
+    {
+        if (!allocation.memory)
+        {
+            return;
+        }
+        
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        
+        m_heap_allocation_bytes[get_heap_index(allocation.memory_type_index)] -= allocation.size;
+        
+        if (!allocation.block_ptr)
+        {
+            free_device_memory(allocation.memory, allocation.size, allocation.memory_type_index);
+            return;
+        }
+        
+        auto &block = *allocation.block_ptr;
+        free_to_block(block, allocation);
+        
+        // Empty blocks are released, except the last one in a pool so that it doesn't thrash.
+        auto &block_pool = m_block_pools[block.memory_type_index * 2 + static_cast<usize>(block.strategy)];
+        if (block.allocation_count == 0 && block_pool.size() > 1)
+        {
+            free_device_memory(block.memory, block.size, block.memory_type_index);
+            std::erase_if(block_pool, [&block](const auto &block_ptr) { return block_ptr.get() == &block; });
+        }
+    }
+    
+    std::vector<MemoryHeapBudget> MemoryAllocator::get_heap_budgets() const
+    {
+        std::vector<MemoryHeapBudget> heap_budgets(m_memory_properties.memoryHeapCount);
+        
+        vk::PhysicalDeviceMemoryBudgetPropertiesEXT memory_budget_properties;
+        if (m_memory_budget_supported)
+        {
+            const auto memory_properties_chain = m_physical_device.getMemoryProperties2<
+                vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT
+            >();
+            memory_budget_properties = memory_properties_chain.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+        }
+        
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        
+        for (u32 i = 0; i < m_memory_properties.memoryHeapCount; ++i)
+        {
+            auto &heap_budget = heap_budgets[i];
+            heap_budget.flags = m_memory_properties.memoryHeaps[i].flags;
+            heap_budget.block_bytes = m_heap_block_bytes[i];
+            heap_budget.allocation_bytes = m_heap_allocation_bytes[i];
+            
+            if (m_memory_budget_supported)
+            {
+                heap_budget.usage = memory_budget_properties.heapUsage[i];
+                heap_budget.budget = memory_budget_properties.heapBudget[i];
+            }
+            else
+            {
+                heap_budget.usage = m_heap_block_bytes[i];
+                heap_budget.budget = m_memory_properties.memoryHeaps[i].size;
+            }
+        }
+        
+        return heap_budgets;
+    }
+    
+    void MemoryAllocator::log_heap_budgets() const
+    {
+        const auto heap_budgets = get_heap_budgets();
+        for (usize i = 0; i < heap_budgets.size(); ++i)
+        {
+            const auto &heap_budget = heap_budgets[i];
+            MH_INFO("GPU heap {} ({}): {:.1f} MiB allocated in {:.1f} MiB of blocks, {:.1f} / {:.1f} MiB used by process.",
+                    i, heap_budget.flags & vk::MemoryHeapFlagBits::eDeviceLocal ? "device local" : "host",
+                    heap_budget.allocation_bytes / BYTES_PER_MIB, heap_budget.block_bytes / BYTES_PER_MIB,
+                    heap_budget.usage / BYTES_PER_MIB, heap_budget.budget / BYTES_PER_MIB);
+        }
+        
+        MH_INFO("GPU memory objects: {} / {}.", m_device_memory_count, m_max_device_memory_count);
+    }
+    
+    Allocation MemoryAllocator::allocate(const vk::MemoryRequirements &requirements,
+                                         const AllocationCreateInfo &create_info,
+                                         const vk::MemoryDedicatedAllocateInfo &dedicated_allocate_info,
+                                         const bool dedicated)
+    {
+        const auto memory_type_index = find_memory_type_index(requirements.memoryTypeBits, create_info.usage);
+        const auto block_size = get_block_size(memory_type_index);
+        
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        
+        m_heap_allocation_bytes[get_heap_index(memory_type_index)] += requirements.size;
+        
+        if (dedicated || create_info.dedicated || requirements.size > block_size / 2)
+        {
+            const auto [memory, mapped_ptr] = allocate_device_memory(requirements.size, memory_type_index,
+                                                                     &dedicated_allocate_info);
+            return Allocation
+            {
+                .memory = memory,
+                .offset = 0,
+                .size = requirements.size,
+                .mapped_ptr = mapped_ptr,
+                .memory_type_index = memory_type_index,
+                .block_ptr = nullptr,
+            };
+        }
+        
+        // Aligning everything to the granularity lets buffers and optimally tiled images share blocks.
+        const auto alignment = std::max(requirements.alignment, m_buffer_image_granularity);
+        
+        auto &block_pool = m_block_pools[memory_type_index * 2 + static_cast<usize>(create_info.strategy)];
+        for (const auto &block_ptr : block_pool)
+        {
+            if (const auto allocation_opt = allocate_from_block(*block_ptr, requirements.size, alignment))
+            {
+                return allocation_opt.value();
+            }
+        }
+        
+        const auto [memory, mapped_ptr] = allocate_device_memory(block_size, memory_type_index, nullptr);
+        auto &block = *block_pool.emplace_back(std::make_unique<MemoryBlock>(MemoryBlock
+        {
+            .memory = memory,
+            .size = block_size,
+            .mapped_ptr = mapped_ptr,
+            .memory_type_index = memory_type_index,
+            .strategy = create_info.strategy,
+            .free_ranges = {{ .offset = 0, .size = block_size }},
+        }));
+        
+        const auto allocation_opt = allocate_from_block(block, requirements.size, alignment);
+        MH_ASSERT(allocation_opt.has_value(), "Failed to sub-allocate {} bytes from a new GPU memory block.",
+                  requirements.size);
+        return allocation_opt.value();
+    }
+    
+    std::optional<Allocation> MemoryAllocator::allocate_from_block(MemoryBlock &block, const vk::DeviceSize size,
+                                                                   const vk::DeviceSize alignment)
+    {
+        std::optional<vk::DeviceSize> offset_opt;
+        
+        if (block.strategy == AllocationStrategy::Linear)
+        {
+            const auto offset = align_up(block.linear_offset, alignment);
+            if (offset + size <= block.size)
+            {
+                block.linear_offset = offset + size;
+                offset_opt = offset;
+            }
+        }
+        else
+        {
+            for (auto it = block.free_ranges.begin(); it != block.free_ranges.end(); ++it)
+            {
+                const auto offset = align_up(it->offset, alignment);
+                const auto padding = offset - it->offset;
+                if (padding + size > it->size)
+                {
+                    continue;
+                }
+                
+                // The padding before the allocation stays free; so does whatever is left after it.
+                const MemoryBlock::FreeRange remainder
+                {
+                    .offset = offset + size,
+                    .size = it->size - padding - size,
+                };
+                
+                if (padding > 0)
+                {
+                    it->size = padding;
+                    if (remainder.size > 0)
+                    {
+                        block.free_ranges.insert(it + 1, remainder);
+                    }
+                }
+                else if (remainder.size > 0)
+                {
+                    *it = remainder;
+                }
+                else
+                {
+                    block.free_ranges.erase(it);
+                }
+                
+                offset_opt = offset;
+                break;
+            }
+        }
+        
+        if (!offset_opt.has_value())
+        {
+            return std::nullopt;
+        }
+        
+        ++block.allocation_count;
+        
+        return Allocation
+        {
+            .memory = block.memory,
+            .offset = offset_opt.value(),
+            .size = size,
+            .mapped_ptr = block.mapped_ptr ? static_cast<u8 *>(block.mapped_ptr) + offset_opt.value() : nullptr,
+            .memory_type_index = block.memory_type_index,
+            .block_ptr = &block,
+        };
+    }
+    
+    void MemoryAllocator::free_to_block(MemoryBlock &block, const Allocation &allocation)
+    {
+        --block.allocation_count;
+        
+        if (block.strategy == AllocationStrategy::Linear)
+        {
+            if (block.allocation_count == 0)
+            {
+                block.linear_offset = 0;
+            }
+            
+            return;
+        }
+        
+        auto &free_ranges = block.free_ranges;
+        const auto next_it = std::ranges::upper_bound(free_ranges, allocation.offset, {},
+                                                      &MemoryBlock::FreeRange::offset);
+        auto it = free_ranges.insert(next_it, { .offset = allocation.offset, .size = allocation.size });
+        
+        if (it + 1 != free_ranges.end() && it->offset + it->size == (it + 1)->offset)
+        {
+            it->size += (it + 1)->size;
+            free_ranges.erase(it + 1);
+        }
+        
+        if (it != free_ranges.begin() && (it - 1)->offset + (it - 1)->size == it->offset)
+        {
+            (it - 1)->size += it->size;
+            free_ranges.erase(it);
+        }
+    }
+    
+    std::pair<vk::DeviceMemory, void *> MemoryAllocator::allocate_device_memory(const vk::DeviceSize size,
+                                                                                 const u32 memory_type_index,
+                                                                                 const void *next_ptr)
+    {
+        MH_ASSERT(m_device_memory_count < m_max_device_memory_count,
+                  "Reached the driver's limit of {} GPU memory allocations.", m_max_device_memory_count);
+        MH_ASSERT(size <= m_max_allocation_size, "GPU memory allocation of {} bytes exceeds the driver's limit of {}.",
+                  size, m_max_allocation_size);
+        
+        const auto heap_index = get_heap_index(memory_type_index);
+        if (m_memory_budget_supported)
+        {
+            const auto memory_properties_chain = m_physical_device.getMemoryProperties2<
+                vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT
+            >();
+            const auto &memory_budget_properties =
+                memory_properties_chain.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+            
+            if (memory_budget_properties.heapUsage[heap_index] + size > memory_budget_properties.heapBudget[heap_index])
+            {
+                MH_WARN("GPU heap {} is over budget ({:.1f} MiB of {:.1f} MiB) after allocating {:.1f} MiB.",
+                        heap_index, memory_budget_properties.heapUsage[heap_index] / BYTES_PER_MIB,
+                        memory_budget_properties.heapBudget[heap_index] / BYTES_PER_MIB, size / BYTES_PER_MIB);
+            }
+        }
+        
+        const vk::MemoryAllocateInfo memory_allocate_info
+        {
+            .pNext = next_ptr,
+            .allocationSize = size,
+            .memoryTypeIndex = memory_type_index,
+        };
+        
+        const auto memory_resval = m_device.allocateMemory(memory_allocate_info);
+        MH_ASSERT_VK(memory_resval.result, "Failed to allocate {} bytes of GPU memory.", size);
+        
+        void *mapped_ptr = nullptr;
+        if (is_host_visible(memory_type_index))
+        {
+            const auto mapped_resval = m_device.mapMemory(memory_resval.value, 0, vk::WholeSize);
+            MH_ASSERT_VK(mapped_resval.result, "Failed to map GPU memory.");
+            mapped_ptr = mapped_resval.value;
+        }
+        
+        ++m_device_memory_count;
+        m_heap_block_bytes[heap_index] += size;
+        
+        return {memory_resval.value, mapped_ptr};
+    }
+    
+    void MemoryAllocator::free_device_memory(const vk::DeviceMemory memory, const vk::DeviceSize size,
+                                             const u32 memory_type_index)
+    {
+        // Freeing memory implicitly unmaps it.
+        m_device.freeMemory(memory);
+        
+        --m_device_memory_count;
+        m_heap_block_bytes[get_heap_index(memory_type_index)] -= size;
+    }
+    
+    u32 MemoryAllocator::find_memory_type_index(const u32 memory_type_bits, const MemoryUsage usage) const
+    {
+        vk::MemoryPropertyFlags required_flags, preferred_flags;
+        switch (usage)
+        {
+            case MemoryUsage::GpuOnly:
+                required_flags = vk::MemoryPropertyFlagBits::eDeviceLocal;
+                break;
+            case MemoryUsage::CpuToGpu:
+                required_flags = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+                break;
+            case MemoryUsage::GpuToCpu:
+                required_flags = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+                preferred_flags = vk::MemoryPropertyFlagBits::eHostCached;
+                break;
+        }
+        
+        std::optional<u32> memory_type_index_opt;
+        for (u32 i = 0; i < m_memory_properties.memoryTypeCount; ++i)
+        {
+            const auto flags = m_memory_properties.memoryTypes[i].propertyFlags;
+            if (!(memory_type_bits & (1u << i)) || (flags & required_flags) != required_flags)
+            {
+                continue;
+            }
+            
+            if ((flags & preferred_flags) == preferred_flags)
+            {
+                return i;
+            }
+            
+            if (!memory_type_index_opt.has_value())
+            {
+                memory_type_index_opt = i;
+            }
+        }
+        
+        MH_ASSERT(memory_type_index_opt.has_value(), "Failed to find a suitable GPU memory type.");
+        return memory_type_index_opt.value();
+    }
+    
+    // Blocks on small heaps (e.g. integrated GPUs or the BAR window) are kept to an eighth of the heap.
+    vk::DeviceSize MemoryAllocator::get_block_size(const u32 memory_type_index) const
+    {
+        const auto heap_size = m_memory_properties.memoryHeaps[get_heap_index(memory_type_index)].size;
+        return heap_size <= SMALL_HEAP_SIZE ? heap_size / 8 : DEFAULT_BLOCK_SIZE;
+    }
+    
+    bool MemoryAllocator::is_host_visible(const u32 memory_type_index) const
+    {
+        return static_cast<bool>(m_memory_properties.memoryTypes[memory_type_index].propertyFlags
+                                 & vk::MemoryPropertyFlagBits::eHostVisible);
+    }
+    
+    u32 MemoryAllocator::get_heap_index(const u32 memory_type_index) const
+    {
+        return m_memory_properties.memoryTypes[memory_type_index].heapIndex;
+    }
+}
@@ -0,0 +1,839 @@
+#include "mellohi/graphics/vulkan/render_graph.hpp"
+
+#include <algorithm>
+
+namespace mellohi
+{
+    struct AccessInfo
+    {
+        vk::PipelineStageFlags2 stage_mask;
+        vk::AccessFlags2 access_mask;
+        vk::ImageLayout layout;
+        vk::ImageUsageFlags usage;
+        bool is_write;
+        bool is_attachment;
+    };
+    
+    static AccessInfo get_access_info(const RenderGraphAccess access)
+    {
+        constexpr auto fragment_tests_stage_mask = vk::PipelineStageFlagBits2::eEarlyFragmentTests
+                                                   | vk::PipelineStageFlagBits2::eLateFragmentTests;
+        
+        switch (access)
+        {
+            case RenderGraphAccess::ColorAttachmentWrite:
+                // Blending reads the attachment too.
+                return {
+                    .stage_mask = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+                    .access_mask = vk::AccessFlagBits2::eColorAttachmentRead
+                                   | vk::AccessFlagBits2::eColorAttachmentWrite,
+                    .layout = vk::ImageLayout::eColorAttachmentOptimal,
+                    .usage = vk::ImageUsageFlagBits::eColorAttachment,
+                    .is_write = true,
+                    .is_attachment = true,
+                };
+            case RenderGraphAccess::DepthAttachmentWrite:
+                return {
+                    .stage_mask = fragment_tests_stage_mask,
+                    .access_mask = vk::AccessFlagBits2::eDepthStencilAttachmentRead
+                                   | vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+                    .layout = vk::ImageLayout::eDepthAttachmentOptimal,
+                    .usage = vk::ImageUsageFlagBits::eDepthStencilAttachment,
+                    .is_write = true,
+                    .is_attachment = true,
+                };
+            case RenderGraphAccess::DepthAttachmentRead:
+                return {
+                    .stage_mask = fragment_tests_stage_mask,
+                    .access_mask = vk::AccessFlagBits2::eDepthStencilAttachmentRead,
+                    .layout = vk::ImageLayout::eDepthReadOnlyOptimal,
+                    .usage = vk::ImageUsageFlagBits::eDepthStencilAttachment,
+                    .is_write = false,
+                    .is_attachment = true,
+                };
+            case RenderGraphAccess::FragmentShaderRead:
+                return {
+                    .stage_mask = vk::PipelineStageFlagBits2::eFragmentShader,
+                    .access_mask = vk::AccessFlagBits2::eShaderSampledRead,
+                    .layout = vk::ImageLayout::eShaderReadOnlyOptimal,
+                    .usage = vk::ImageUsageFlagBits::eSampled,
+                    .is_write = false,
+                    .is_attachment = false,
+                };
+            case RenderGraphAccess::ComputeShaderRead:
+                return {
+                    .stage_mask = vk::PipelineStageFlagBits2::eComputeShader,
+                    .access_mask = vk::AccessFlagBits2::eShaderSampledRead,
+                    .layout = vk::ImageLayout::eShaderReadOnlyOptimal,
+                    .usage = vk::ImageUsageFlagBits::eSampled,
+                    .is_write = false,
+                    .is_attachment = false,
+                };
+            case RenderGraphAccess::ComputeShaderWrite:
+                return {
+                    .stage_mask = vk::PipelineStageFlagBits2::eComputeShader,
+                    .access_mask = vk::AccessFlagBits2::eShaderStorageRead
+                                   | vk::AccessFlagBits2::eShaderStorageWrite,
+                    .layout = vk::ImageLayout::eGeneral,
+                    .usage = vk::ImageUsageFlagBits::eStorage,
+                    .is_write = true,
+                    .is_attachment = false,
+                };
+            case RenderGraphAccess::TransferRead:
+                return {
+                    .stage_mask = vk::PipelineStageFlagBits2::eAllTransfer,
+                    .access_mask = vk::AccessFlagBits2::eTransferRead,
+                    .layout = vk::ImageLayout::eTransferSrcOptimal,
+                    .usage = vk::ImageUsageFlagBits::eTransferSrc,
+                    .is_write = false,
+                    .is_attachment = false,
+                };
+            case RenderGraphAccess::TransferWrite:
+                return {
+                    .stage_mask = vk::PipelineStageFlagBits2::eAllTransfer,
+                    .access_mask = vk::AccessFlagBits2::eTransferWrite,
+                    .layout = vk::ImageLayout::eTransferDstOptimal,
+                    .usage = vk::ImageUsageFlagBits::eTransferDst,
+                    .is_write = true,
+                    .is_attachment = false,
+                };
+        }
+        
+        MH_ASSERT(false, "Unknown render graph access {}.", static_cast<i32>(access));
+        return {};
+    }
+    
+    static vk::ImageAspectFlags get_aspect_mask(const vk::Format format)
+    {
+        switch (format)
+        {
+            case vk::Format::eD16Unorm:
+            case vk::Format::eX8D24UnormPack32:
+            case vk::Format::eD32Sfloat:
+                return vk::ImageAspectFlagBits::eDepth;
+            case vk::Format::eD16UnormS8Uint:
+            case vk::Format::eD24UnormS8Uint:
+            case vk::Format::eD32SfloatS8Uint:
+                return vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+            case vk::Format::eS8Uint:
+                return vk::ImageAspectFlagBits::eStencil;
+            default:
+                return vk::ImageAspectFlagBits::eColor;
+        }
+    }
+    
+    // Clearing or not caring about an attachment's previous contents means earlier writes to it are not needed.
+    static bool discards_contents(const AccessInfo &access_info, const vk::AttachmentLoadOp load_op)
+    {
+        return access_info.is_attachment && access_info.is_write && load_op != vk::AttachmentLoadOp::eLoad;
+    }
+    
+    RenderGraphPassBuilder::RenderGraphPassBuilder(RenderGraph &render_graph, const usize pass_index)
+        : m_render_graph(render_graph), m_pass_index(pass_index)
+    {
+        
+    }
+    
+    void RenderGraphPassBuilder::write_color_attachment(const std::string_view name,
+                                                        const vk::AttachmentLoadOp load_op)
+    {
+        use(name, RenderGraphAccess::ColorAttachmentWrite, load_op);
+    }
+    
+    void RenderGraphPassBuilder::write_depth_attachment(const std::string_view name,
+                                                        const vk::AttachmentLoadOp load_op)
+    {
+        use(name, RenderGraphAccess::DepthAttachmentWrite, load_op);
+    }
+    
+    void RenderGraphPassBuilder::read_depth_attachment(const std::string_view name)
+    {
+        use(name, RenderGraphAccess::DepthAttachmentRead, vk::AttachmentLoadOp::eLoad);
+    }
+    
+    void RenderGraphPassBuilder::read(const std::string_view name, const RenderGraphAccess access)
+    {
+        const auto access_info = get_access_info(access);
+        MH_ASSERT(!access_info.is_write && !access_info.is_attachment,
+                  "Render graph pass {} must read {} through a shader or transfer access.",
+                  m_render_graph.m_passes[m_pass_index].name, name);
+        
+        use(name, access, vk::AttachmentLoadOp::eLoad);
+    }
+    
+    void RenderGraphPassBuilder::write(const std::string_view name, const RenderGraphAccess access)
+    {
+        const auto access_info = get_access_info(access);
+        MH_ASSERT(access_info.is_write && !access_info.is_attachment,
+                  "Render graph pass {} must write {} through a shader or transfer access.",
+                  m_render_graph.m_passes[m_pass_index].name, name);
+        
+        use(name, access, vk::AttachmentLoadOp::eLoad);
+    }
+    
+    void RenderGraphPassBuilder::set_side_effects()
+    {
+        m_render_graph.m_passes[m_pass_index].has_side_effects = true;
+    }
+    
+    void RenderGraphPassBuilder::use(const std::string_view name, const RenderGraphAccess access,
+                                     const vk::AttachmentLoadOp load_op)
+    {
+        auto &pass = m_render_graph.m_passes[m_pass_index];
+        const auto resource_index = m_render_graph.get_resource_index(name);
+        
+        MH_ASSERT(std::ranges::none_of(pass.uses, [resource_index](const auto &resource_use)
+                  {
+                      return resource_use.resource_index == resource_index;
+                  }),
+                  "Render graph pass {} uses {} more than once.", pass.name, name);
+        
+        pass.uses.push_back({
+            .resource_index = resource_index,
+            .access = access,
+            .load_op = load_op,
+        });
+    }
+    
+    RenderGraph::RenderGraph(const std::shared_ptr<Device> device_ptr, const std::shared_ptr<Swapchain> swapchain_ptr,
+                             const std::shared_ptr<RenderPass> render_pass_ptr)
+        : m_device_ptr(device_ptr), m_swapchain_ptr(swapchain_ptr), m_render_pass_ptr(render_pass_ptr)
+    {
+        
+    }
+    
+    RenderGraph::~RenderGraph()
+    {
+        retire_transient_images();
+    }
+    
+    void RenderGraph::create_image(std::string name, const RenderGraphImageInfo &info)
+    {
+        MH_ASSERT(!m_resource_indices.contains(name), "Render graph already has a resource named {}.", name);
+        
+        m_resource_indices.emplace(name, m_resources.size());
+        m_resources.push_back({
+            .name = std::move(name),
+            .info = info,
+        });
+        
+        m_is_compiled = false;
+    }
+    
+    void RenderGraph::import_swapchain_image(std::string name)
+    {
+        MH_ASSERT(!m_resource_indices.contains(name), "Render graph already has a resource named {}.", name);
+        MH_ASSERT(std::ranges::none_of(m_resources, &Resource::is_swapchain_image),
+                  "Render graph can only import the swapchain image once.");
+        
+        m_resource_indices.emplace(name, m_resources.size());
+        m_resources.push_back({
+            .name = std::move(name),
+            .info = RenderGraphImageInfo
+            {
+                .format = m_device_ptr->get_preferred_surface_format().format,
+                .extent_opt = std::nullopt,
+            },
+            .is_swapchain_image = true,
+        });
+        
+        m_is_compiled = false;
+    }
+    
+    void RenderGraph::add_pass(std::string name, const std::function<void(RenderGraphPassBuilder &)> &setup,
+                               ExecuteFunction execute)
+    {
+        m_passes.push_back({
+            .name = std::move(name),
+            .execute = std::move(execute),
+        });
+        
+        RenderGraphPassBuilder builder(*this, m_passes.size() - 1);
+        setup(builder);
+        
+        m_is_compiled = false;
+    }
+    
+    void RenderGraph::compile()
+    {
+        MH_ASSERT(std::ranges::any_of(m_resources, &Resource::is_swapchain_image),
+                  "Render graph must import the swapchain image.");
+        
+        cull_passes();
+        compute_lifetimes();
+        plan_attachments();
+        
+        retire_transient_images();
+        create_transient_images();
+        plan_barriers();
+        
+        m_is_compiled = true;
+    }
+    
+    void RenderGraph::execute()
+    {
+        MH_ASSERT(m_is_compiled, "Render graph must be compiled before it is executed.");
+        
+        // Transient images sized like the swapchain follow it when it is rebuilt. Their memory may then be aliased
+        // differently, which changes the barriers between them.
+        if (m_swapchain_ptr->get_extent() != m_compiled_extent)
+        {
+            retire_transient_images();
+            create_transient_images();
+            plan_barriers();
+        }
+        
+        const auto command_buffer = m_render_pass_ptr->get_current_command_buffer();
+        
+        for (auto &pass : m_passes)
+        {
+            if (pass.is_culled)
+            {
+                continue;
+            }
+            
+            record_image_barriers(command_buffer, pass.image_barriers, pass.image_barrier_resource_indices);
+            
+            if (!pass.attachments_opt.has_value())
+            {
+                pass.execute(command_buffer);
+                continue;
+            }
+            
+            // Image views change whenever the swapchain image does, so they are patched in every frame.
+            auto &attachments = pass.attachments_opt.value();
+            auto resource_index_it = pass.attachment_resource_indices.begin();
+            for (auto &color_attachment : attachments.color_attachments)
+            {
+                color_attachment.image_view = get_resource_image_view(m_resources[*resource_index_it++]);
+            }
+            if (attachments.depth_attachment_opt.has_value())
+            {
+                attachments.depth_attachment_opt->image_view = get_resource_image_view(m_resources[*resource_index_it]);
+            }
+            attachments.extent = get_resource_extent(m_resources[pass.attachment_resource_indices.front()]);
+            
+            m_render_pass_ptr->begin_rendering(attachments);
+            pass.execute(command_buffer);
+            m_render_pass_ptr->end_rendering();
+        }
+        
+        record_image_barriers(command_buffer, m_final_image_barriers, m_final_image_barrier_resource_indices);
+    }
+    
+    vk::Image RenderGraph::get_image(const std::string_view name) const
+    {
+        return get_resource_image(m_resources[get_resource_index(name)]);
+    }
+    
+    vk::ImageView RenderGraph::get_image_view(const std::string_view name) const
+    {
+        return get_resource_image_view(m_resources[get_resource_index(name)]);
+    }
+    
+    vk::Extent2D RenderGraph::get_extent(const std::string_view name) const
+    {
+        return get_resource_extent(m_resources[get_resource_index(name)]);
+    }
+    
+    usize RenderGraph::get_resource_index(const std::string_view name) const
+    {
+        const auto resource_index_it = m_resource_indices.find(std::string(name));
+        MH_ASSERT(resource_index_it != m_resource_indices.end(), "Render graph has no resource named {}.", name);
+        return resource_index_it->second;
+    }
+    
+    vk::Image RenderGraph::get_resource_image(const Resource &resource) const
+    {
+        if (resource.is_swapchain_image)
+        {
+            return m_swapchain_ptr->get_image(m_render_pass_ptr->get_current_image_index());
+        }
+        
+        MH_ASSERT(resource.image.image, "Render graph image {} is not used by any pass.", resource.name);
+        return resource.image.image;
+    }
+    
+    vk::ImageView RenderGraph::get_resource_image_view(const Resource &resource) const
+    {
+        if (resource.is_swapchain_image)
+        {
+            return m_swapchain_ptr->get_image_view(m_render_pass_ptr->get_current_image_index());
+        }
+        
+        MH_ASSERT(resource.image_view, "Render graph image {} is not used by any pass.", resource.name);
+        return resource.image_view;
+    }
+    
+    vk::Extent2D RenderGraph::get_resource_extent(const Resource &resource) const
+    {
+        return resource.info.extent_opt.value_or(m_swapchain_ptr->get_extent());
+    }
+    
+    // Walks the passes backwards, keeping those that write something a later kept pass (or the presentation engine)
+    // needs. What a kept pass reads is then needed from the passes before it.
+    void RenderGraph::cull_passes()
+    {
+        std::vector<bool> is_resource_needed(m_resources.size());
+        for (usize resource_index = 0; resource_index < m_resources.size(); ++resource_index)
+        {
+            is_resource_needed[resource_index] = m_resources[resource_index].is_swapchain_image;
+        }
+        
+        for (auto pass_it = m_passes.rbegin(); pass_it != m_passes.rend(); ++pass_it)
+        {
+            auto &pass = *pass_it;
+            
+            pass.is_culled = !pass.has_side_effects && std::ranges::none_of(pass.uses,
+                [&is_resource_needed](const ResourceUse &resource_use)
+                {
+                    return get_access_info(resource_use.access).is_write
+                           && is_resource_needed[resource_use.resource_index];
+                });
+            
+            if (pass.is_culled)
+            {
+                MH_INFO("Render graph culled pass {}, since nothing reads what it writes.", pass.name);
+                continue;
+            }
+            
+            for (const auto &resource_use : pass.uses)
+            {
+                const auto access_info = get_access_info(resource_use.access);
+                is_resource_needed[resource_use.resource_index] = !discards_contents(access_info,
+                                                                                     resource_use.load_op);
+            }
+        }
+    }
+    
+    void RenderGraph::compute_lifetimes()
+    {
+        for (auto &resource : m_resources)
+        {
+            resource.usage = {};
+            resource.first_pass_index_opt = std::nullopt;
+            resource.last_pass_index = 0;
+        }
+        
+        for (usize pass_index = 0; pass_index < m_passes.size(); ++pass_index)
+        {
+            const auto &pass = m_passes[pass_index];
+            if (pass.is_culled)
+            {
+                continue;
+            }
+            
+            for (const auto &resource_use : pass.uses)
+            {
+                auto &resource = m_resources[resource_use.resource_index];
+                const auto access_info = get_access_info(resource_use.access);
+                
+                MH_ASSERT(resource.first_pass_index_opt.has_value() || resource.is_swapchain_image
+                          || access_info.is_write,
+                          "Render graph pass {} reads {} before any pass writes it.", pass.name, resource.name);
+                
+                resource.usage |= access_info.usage;
+                resource.first_pass_index_opt = resource.first_pass_index_opt.value_or(pass_index);
+                resource.last_pass_index = pass_index;
+            }
+        }
+        
+        const auto swapchain_image_it = std::ranges::find_if(m_resources, &Resource::is_swapchain_image);
+        MH_ASSERT(swapchain_image_it->first_pass_index_opt.has_value(),
+                  "Render graph has no pass that writes {}.", swapchain_image_it->name);
+    }
+    
+    void RenderGraph::plan_barriers()
+    {
+        // The first run leaves each alias slot in the state the frame ends in, which is what the next frame starts
+        // from. The second one records the barriers with that in mind.
+        std::vector<ResourceState> alias_slot_states(m_alias_slots.size());
+        simulate_barriers(alias_slot_states, false);
+        simulate_barriers(alias_slot_states, true);
+    }
+    
+    void RenderGraph::simulate_barriers(std::vector<ResourceState> &alias_slot_states, const bool record)
+    {
+        std::vector<ResourceState> states(m_resources.size());
+        std::vector<bool> is_first_use(m_resources.size(), true);
+        
+        const auto make_barrier = [](const ResourceState &state, const AccessInfo &access_info,
+                                     const vk::ImageLayout old_layout, const vk::Format format)
+        {
+            return vk::ImageMemoryBarrier2
+            {
+                .srcStageMask = state.write_stage_mask | state.read_stage_mask,
+                .srcAccessMask = state.write_access_mask,
+                .dstStageMask = access_info.stage_mask,
+                .dstAccessMask = access_info.access_mask,
+                .oldLayout = old_layout,
+                .newLayout = access_info.layout,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .subresourceRange = vk::ImageSubresourceRange
+                {
+                    .aspectMask = get_aspect_mask(format),
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+            };
+        };
+        
+        for (auto &pass : m_passes)
+        {
+            if (record)
+            {
+                pass.image_barriers.clear();
+                pass.image_barrier_resource_indices.clear();
+            }
+            
+            if (pass.is_culled)
+            {
+                continue;
+            }
+            
+            for (const auto &resource_use : pass.uses)
+            {
+                const auto resource_index = resource_use.resource_index;
+                const auto &resource = m_resources[resource_index];
+                const auto access_info = get_access_info(resource_use.access);
+                auto &state = states[resource_index];
+                
+                if (is_first_use[resource_index])
+                {
+                    is_first_use[resource_index] = false;
+                    
+                    // The swapchain image is acquired at the color attachment output stage, and transient images
+                    // follow whatever last used their memory.
+                    if (resource.is_swapchain_image)
+                    {
+                        state.write_stage_mask = vk::PipelineStageFlagBits2::eColorAttachmentOutput;
+                    }
+                    else
+                    {
+                        const auto &alias_slot_state = alias_slot_states[resource.alias_slot_index_opt.value()];
+                        state.write_stage_mask = alias_slot_state.write_stage_mask
+                                                 | alias_slot_state.read_stage_mask;
+                        state.write_access_mask = alias_slot_state.write_access_mask;
+                    }
+                }
+                
+                const auto old_layout = discards_contents(access_info, resource_use.load_op)
+                                        ? vk::ImageLayout::eUndefined : state.layout;
+                const auto changes_layout = state.layout != access_info.layout;
+                
+                std::optional<vk::ImageMemoryBarrier2> barrier_opt;
+                if (access_info.is_write || changes_layout)
+                {
+                    // Writes and layout transitions wait for every earlier access, not just the last write.
+                    if (changes_layout || state.write_stage_mask || state.read_stage_mask)
+                    {
+                        barrier_opt = make_barrier(state, access_info, old_layout, resource.info.format);
+                    }
+                    
+                    state.layout = access_info.layout;
+                    state.write_stage_mask = access_info.stage_mask;
+                    state.write_access_mask = access_info.is_write ? access_info.access_mask : vk::AccessFlags2{};
+                    state.read_stage_mask = access_info.is_write ? vk::PipelineStageFlags2{} : access_info.stage_mask;
+                    state.read_access_mask = access_info.is_write ? vk::AccessFlags2{} : access_info.access_mask;
+                }
+                else if ((access_info.stage_mask & ~state.read_stage_mask)
+                         || (access_info.access_mask & ~state.read_access_mask))
+                {
+                    // Reads only need the last write made visible to them, once per stage.
+                    auto read_state = state;
+                    read_state.read_stage_mask = {};
+                    barrier_opt = make_barrier(read_state, access_info, state.layout, resource.info.format);
+                    
+                    state.read_stage_mask |= access_info.stage_mask;
+                    state.read_access_mask |= access_info.access_mask;
+                }
+                
+                if (record && barrier_opt.has_value())
+                {
+                    pass.image_barriers.push_back(barrier_opt.value());
+                    pass.image_barrier_resource_indices.push_back(resource_index);
+                }
+                
+                if (resource.alias_slot_index_opt.has_value())
+                {
+                    alias_slot_states[resource.alias_slot_index_opt.value()] = state;
+                }
+            }
+        }
+        
+        if (!record)
+        {
+            return;
+        }
+        
+        m_final_image_barriers.clear();
+        m_final_image_barrier_resource_indices.clear();
+        
+        for (usize resource_index = 0; resource_index < m_resources.size(); ++resource_index)
+        {
+            const auto &resource = m_resources[resource_index];
+            if (!resource.is_swapchain_image)
+            {
+                continue;
+            }
+            
+            const AccessInfo present_access_info
+            {
+                .stage_mask = vk::PipelineStageFlagBits2::eNone,
+                .access_mask = vk::AccessFlagBits2::eNone,
+                .layout = vk::ImageLayout::ePresentSrcKHR,
+            };
+            
+            const auto &state = states[resource_index];
+            m_final_image_barriers.push_back(make_barrier(state, present_access_info, state.layout,
+                                                          resource.info.format));
+            m_final_image_barrier_resource_indices.push_back(resource_index);
+        }
+    }
+    
+    void RenderGraph::plan_attachments()
+    {
+        for (usize pass_index = 0; pass_index < m_passes.size(); ++pass_index)
+        {
+            auto &pass = m_passes[pass_index];
+            pass.attachments_opt = std::nullopt;
+            pass.attachment_resource_indices.clear();
+            
+            if (pass.is_culled)
+            {
+                continue;
+            }
+            
+            RenderingAttachments attachments;
+            std::optional<usize> depth_resource_index_opt;
+            
+            for (const auto &resource_use : pass.uses)
+            {
+                const auto access_info = get_access_info(resource_use.access);
+                if (!access_info.is_attachment)
+                {
+                    continue;
+                }
+                
+                const auto &resource = m_resources[resource_use.resource_index];
+                
+                // Contents nothing reads later don't need to be written back to memory.
+                const auto is_last_use = !resource.is_swapchain_image && resource.last_pass_index == pass_index;
+                const auto store_op = !access_info.is_write ? vk::AttachmentStoreOp::eNone
+                                      : is_last_use ? vk::AttachmentStoreOp::eDontCare
+                                      : vk::AttachmentStoreOp::eStore;
+                
+                const RenderingAttachment attachment
+                {
+                    .format = resource.info.format,
+                    .layout = access_info.layout,
+                    .load_op = resource_use.load_op,
+                    .store_op = store_op,
+                };
+                
+                if (resource_use.access == RenderGraphAccess::ColorAttachmentWrite)
+                {
+                    attachments.color_attachments.push_back(attachment);
+                    pass.attachment_resource_indices.push_back(resource_use.resource_index);
+                }
+                else
+                {
+                    MH_ASSERT(!attachments.depth_attachment_opt.has_value(),
+                              "Render graph pass {} has more than one depth attachment.", pass.name);
+                    attachments.depth_attachment_opt = attachment;
+                    depth_resource_index_opt = resource_use.resource_index;
+                }
+            }
+            
+            // Depth comes after the color attachments, matching the order they are patched in when executing.
+            if (depth_resource_index_opt.has_value())
+            {
+                pass.attachment_resource_indices.push_back(depth_resource_index_opt.value());
+            }
+            
+            if (!pass.attachment_resource_indices.empty())
+            {
+                pass.attachments_opt = std::move(attachments);
+            }
+        }
+    }
+    
+    // Transient images are sorted from largest to smallest and placed in the first alias slot whose images are all
+    // used by other passes. The slot's memory is sized for its first, largest image.
+    void RenderGraph::create_transient_images()
+    {
+        m_compiled_extent = m_swapchain_ptr->get_extent();
+        m_alias_slots.clear();
+        
+        std::vector<vk::ImageCreateInfo> create_infos(m_resources.size());
+        std::vector<vk::MemoryRequirements> requirements(m_resources.size());
+        std::vector<usize> transient_resource_indices;
+        
+        for (usize resource_index = 0; resource_index < m_resources.size(); ++resource_index)
+        {
+            auto &resource = m_resources[resource_index];
+            resource.alias_slot_index_opt = std::nullopt;
+            
+            if (resource.is_swapchain_image || !resource.first_pass_index_opt.has_value())
+            {
+                continue;
+            }
+            
+            const auto extent = get_resource_extent(resource);
+            create_infos[resource_index] = vk::ImageCreateInfo
+            {
+                .imageType = vk::ImageType::e2D,
+                .format = resource.info.format,
+                .extent = vk::Extent3D
+                {
+                    .width = extent.width,
+                    .height = extent.height,
+                    .depth = 1,
+                },
+                .mipLevels = 1,
+                .arrayLayers = 1,
+                .samples = vk::SampleCountFlagBits::e1,
+                .tiling = vk::ImageTiling::eOptimal,
+                .usage = resource.usage,
+                .sharingMode = vk::SharingMode::eExclusive,
+                .initialLayout = vk::ImageLayout::eUndefined,
+            };
+            requirements[resource_index] = m_device_ptr->get_image_memory_requirements(create_infos[resource_index]);
+            
+            transient_resource_indices.push_back(resource_index);
+        }
+        
+        std::ranges::stable_sort(transient_resource_indices, std::ranges::greater{},
+                                 [&requirements](const usize resource_index)
+                                 {
+                                     return requirements[resource_index].size;
+                                 });
+        
+        const auto lifetimes_overlap = [this](const usize resource_index, const usize other_resource_index)
+        {
+            const auto &resource = m_resources[resource_index];
+            const auto &other_resource = m_resources[other_resource_index];
+            return resource.first_pass_index_opt.value() <= other_resource.last_pass_index
+                   && other_resource.first_pass_index_opt.value() <= resource.last_pass_index;
+        };
+        
+        for (const auto resource_index : transient_resource_indices)
+        {
+            const auto &resource_requirements = requirements[resource_index];
+            
+            auto alias_slot_it = std::ranges::find_if(m_alias_slots, [&](const AliasSlot &alias_slot)
+            {
+                return (alias_slot.requirements.memoryTypeBits & resource_requirements.memoryTypeBits) != 0
+                       && std::ranges::none_of(alias_slot.resource_indices, [&](const usize other_resource_index)
+                          {
+                              return lifetimes_overlap(resource_index, other_resource_index);
+                          });
+            });
+            
+            if (alias_slot_it == m_alias_slots.end())
+            {
+                m_alias_slots.push_back({ .requirements = resource_requirements });
+                alias_slot_it = std::prev(m_alias_slots.end());
+            }
+            
+            alias_slot_it->resource_indices.push_back(resource_index);
+            alias_slot_it->requirements.size = std::max(alias_slot_it->requirements.size,
+                                                        resource_requirements.size);
+            alias_slot_it->requirements.alignment = std::max(alias_slot_it->requirements.alignment,
+                                                             resource_requirements.alignment);
+            alias_slot_it->requirements.memoryTypeBits &= resource_requirements.memoryTypeBits;
+            
+            m_resources[resource_index].alias_slot_index_opt = static_cast<usize>(
+                std::distance(m_alias_slots.begin(), alias_slot_it)
+            );
+        }
+        
+        std::vector<vk::ImageCreateInfo> alias_slot_create_infos;
+        for (const auto &alias_slot : m_alias_slots)
+        {
+            alias_slot_create_infos.clear();
+            for (const auto resource_index : alias_slot.resource_indices)
+            {
+                alias_slot_create_infos.push_back(create_infos[resource_index]);
+            }
+            
+            const auto images = m_device_ptr->create_aliased_images(alias_slot_create_infos, {
+                .usage = MemoryUsage::GpuOnly,
+                .strategy = AllocationStrategy::FreeList,
+                .dedicated = false,
+            });
+            
+            for (usize image_index = 0; image_index < images.size(); ++image_index)
+            {
+                auto &resource = m_resources[alias_slot.resource_indices[image_index]];
+                resource.image = images[image_index];
+                
+                const vk::ImageViewCreateInfo image_view_create_info
+                {
+                    .image = resource.image.image,
+                    .viewType = vk::ImageViewType::e2D,
+                    .format = resource.info.format,
+                    .subresourceRange = vk::ImageSubresourceRange
+                    {
+                        .aspectMask = get_aspect_mask(resource.info.format),
+                        .baseMipLevel = 0,
+                        .levelCount = 1,
+                        .baseArrayLayer = 0,
+                        .layerCount = 1,
+                    },
+                };
+                resource.image_view = m_device_ptr->create_image_view(image_view_create_info);
+            }
+        }
+        
+        MH_INFO("Render graph placed {} transient images in {} allocations.", transient_resource_indices.size(),
+                m_alias_slots.size());
+    }
+    
+    // Frames in flight may still be using the images. The first image in each slot owns the memory, so it is
+    // retired first and destroyed last.
+    void RenderGraph::retire_transient_images()
+    {
+        for (const auto &alias_slot : m_alias_slots)
+        {
+            for (const auto resource_index : alias_slot.resource_indices)
+            {
+                auto &resource = m_resources[resource_index];
+                
+                m_device_ptr->push_to_deletion_queue(resource.image);
+                m_device_ptr->push_to_deletion_queue(resource.image_view);
+                
+                resource.image = {};
+                resource.image_view = nullptr;
+            }
+        }
+        
+        m_alias_slots.clear();
+    }
+    
+    void RenderGraph::record_image_barriers(const vk::CommandBuffer command_buffer,
+                                            std::vector<vk::ImageMemoryBarrier2> &barriers,
+                                            const std::span<const usize> resource_indices) const
+    {
+        if (barriers.empty())
+        {
+            return;
+        }
+        
+        for (usize barrier_index = 0; barrier_index < barriers.size(); ++barrier_index)
+        {
+            barriers[barrier_index].image = get_resource_image(m_resources[resource_indices[barrier_index]]);
+        }
+        
+        const vk::DependencyInfo dependency_info
+        {
+            .imageMemoryBarrierCount = static_cast<u32>(barriers.size()),
+            .pImageMemoryBarriers = barriers.data(),
+        };
+        
+        command_buffer.pipelineBarrier2(dependency_info);
+    }
+}
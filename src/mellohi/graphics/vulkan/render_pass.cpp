@@ -1,15 +1,50 @@
 #include "mellohi/graphics/vulkan/render_pass.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <latch>
+
 namespace mellohi
 {
+    // Fewer items than this per range cost more in command buffer overhead than parallel recording saves.
+    static constexpr usize MIN_ITEMS_PER_RECORDING_RANGE = 64;
+    
+    // Rendering is split into suspended instances so that record_parallel() can execute secondary command buffers
+    // part way through it. Together they form one render pass instance, so attachments are only loaded when it begins
+    // and stored when it ends.
+    static constexpr vk::RenderingFlags INLINE_RENDERING_FLAGS = vk::RenderingFlagBits::eSuspending;
+    static constexpr vk::RenderingFlags RESUMED_RENDERING_FLAGS = vk::RenderingFlagBits::eResuming
+                                                                  | vk::RenderingFlagBits::eSuspending;
+    
     RenderPass::RenderPass(const std::shared_ptr<EngineConfigAsset> engine_config_ptr,
-                           const std::shared_ptr<Device> device_ptr, const std::shared_ptr<Swapchain> swapchain_ptr)
-        : m_engine_config_ptr(engine_config_ptr), m_device_ptr(device_ptr), m_swapchain_ptr(swapchain_ptr)
+                           const std::shared_ptr<Device> device_ptr, const std::shared_ptr<Swapchain> swapchain_ptr,
+                           const std::shared_ptr<UploadScheduler> upload_scheduler_ptr,
+                           const std::shared_ptr<BindlessDescriptors> bindless_descriptors_ptr,
+                           const std::shared_ptr<GraphicsPipelineCache> graphics_pipeline_cache_ptr)
+        : m_engine_config_ptr(engine_config_ptr), m_device_ptr(device_ptr), m_swapchain_ptr(swapchain_ptr),
+          m_upload_scheduler_ptr(upload_scheduler_ptr), m_bindless_descriptors_ptr(bindless_descriptors_ptr),
+          m_uniform_ring(device_ptr)
     {
-        create_render_pass();
-        swapchain_ptr->init_with_render_pass(m_render_pass);
+        m_pipeline_layout_key = PipelineLayoutKey
+        {
+            .descriptor_set_layouts = {
+                m_bindless_descriptors_ptr->get_descriptor_set_layout(),
+                m_uniform_ring.get_descriptor_set_layout(),
+            },
+            .push_constant_ranges = {
+                vk::PushConstantRange
+                {
+                    .stageFlags = vk::ShaderStageFlagBits::eAll,
+                    .offset = 0,
+                    .size = PUSH_CONSTANT_SIZE,
+                },
+            },
+        };
+        m_pipeline_layout = graphics_pipeline_cache_ptr->get_or_create_layout(m_pipeline_layout_key);
+        
         create_command_pool();
         create_command_buffers();
+        create_secondary_command_pools();
     }
     
     RenderPass::~RenderPass()
@@ -17,11 +52,20 @@ namespace mellohi
         m_device_ptr->wait_idle();
         
         m_device_ptr->destroy_command_pool(m_command_pool);
-        m_device_ptr->destroy_render_pass(m_render_pass);
+        for (const auto &frame_secondary_command_pools : m_secondary_command_pools)
+        {
+            for (const auto &secondary_command_pool : frame_secondary_command_pools)
+            {
+                m_device_ptr->destroy_command_pool(secondary_command_pool.command_pool);
+            }
+        }
     }
     
     bool RenderPass::begin()
     {
+        // Uploads made since the last frame start copying now, while the CPU records this one.
+        m_upload_scheduler_ptr->flush();
+        
         m_current_image_index_opt = m_swapchain_ptr->acquire_next_image_index();
         
         if (!m_current_image_index_opt.has_value())
@@ -29,6 +73,23 @@ namespace mellohi
             return false;
         }
         
+        // The swapchain may have been rebuilt with a different number of frames in flight.
+        if (m_command_buffers.size() != m_swapchain_ptr->get_frames_in_flight())
+        {
+            m_device_ptr->free_command_buffers(m_command_pool, m_command_buffers);
+            create_command_buffers();
+            
+            retire_secondary_command_pools();
+            create_secondary_command_pools();
+        }
+        
+        // The swapchain has waited for the GPU to finish the frame that last used these.
+        for (auto &secondary_command_pool : m_secondary_command_pools[m_swapchain_ptr->get_current_frame_index()])
+        {
+            m_device_ptr->reset_command_pool(secondary_command_pool.command_pool);
+            secondary_command_pool.used_count = 0;
+        }
+        
         const auto command_buffer = get_current_command_buffer();
         
         command_buffer.reset();
@@ -42,50 +103,30 @@ namespace mellohi
         const auto result = command_buffer.begin(command_buffer_begin_info);
         MH_ASSERT_VK(result, "Failed to begin recording Vulkan command buffer.");
         
-        const vk::ClearValue clear_value
-        {
-            .color = vk::ClearColorValue
-            {
-                .float32 = m_engine_config_ptr->get_window_clear_color().srgb_to_linear().as_array()
-            },
-        };
+        // The swapchain has also waited for the frame that last used this region of the uniform ring.
+        m_frame_uniform_offset = m_uniform_ring.begin_frame();
+        bind_descriptor_sets(command_buffer, vk::PipelineBindPoint::eGraphics, m_frame_uniform_offset);
+        bind_descriptor_sets(command_buffer, vk::PipelineBindPoint::eCompute, m_frame_uniform_offset);
         
-        const auto swapchain_extent = m_swapchain_ptr->get_extent();
-        
-        const vk::RenderPassBeginInfo render_pass_begin_info
+        m_wait_semaphore_infos.clear();
+        if (const auto upload_wait_semaphore_info_opt = m_upload_scheduler_ptr->record_acquire_barriers(command_buffer))
         {
-            .renderPass = m_render_pass,
-            .framebuffer = m_swapchain_ptr->get_framebuffer(m_current_image_index_opt.value()),
-            .renderArea = vk::Rect2D
-            {
-                .offset = {0, 0},
-                .extent = swapchain_extent,
-            },
-            .clearValueCount = 1,
-            .pClearValues = &clear_value,
-        };
-        
-        command_buffer.beginRenderPass(render_pass_begin_info, vk::SubpassContents::eInline);
+            m_wait_semaphore_infos.push_back(upload_wait_semaphore_info_opt.value());
+        }
         
-        const vk::Viewport viewport
-        {
-            .x = 0.0f,
-            .y = 0.0f,
-            .width = static_cast<float>(swapchain_extent.width),
-            .height = static_cast<float>(swapchain_extent.height),
-            .minDepth = 0.0f,
-            .maxDepth = 1.0f,
-        };
-        command_buffer.setViewport(0, 1, &viewport);
+        return true;
+    }
+    
+    void RenderPass::begin_rendering(const RenderingAttachments &attachments)
+    {
+        MH_ASSERT(m_current_image_index_opt.has_value(), "Render Pass must have begun to begin rendering.");
+        MH_ASSERT(!m_is_rendering, "Render Pass must end rendering before beginning it again.");
         
-        const vk::Rect2D scissor
-        {
-            .offset = {0, 0},
-            .extent = swapchain_extent,
-        };
-        command_buffer.setScissor(0, 1, &scissor);
+        m_rendering_attachments = attachments;
+        m_is_rendering = true;
         
-        return true;
+        record_begin_rendering(INLINE_RENDERING_FLAGS);
+        set_viewport_and_scissor(get_current_command_buffer());
     }
     
     void RenderPass::bind_graphics_pipeline(const vk::Pipeline graphics_pipeline)
@@ -93,24 +134,166 @@ namespace mellohi
         get_current_command_buffer().bindPipeline(vk::PipelineBindPoint::eGraphics, graphics_pipeline);
     }
     
+    void RenderPass::set_frame_uniforms(const std::span<const std::byte> data)
+    {
+        MH_ASSERT(m_current_image_index_opt.has_value(), "Render Pass must have begun to set frame uniforms.");
+        MH_ASSERT_DEBUG(data.size() <= UniformRing::MAX_UNIFORM_SIZE,
+                        "Frame uniforms of {} bytes are over the {} allowed.", data.size(),
+                        UniformRing::MAX_UNIFORM_SIZE);
+        
+        const auto allocation = m_uniform_ring.allocate(data.size());
+        std::memcpy(allocation.mapped_ptr, data.data(), data.size());
+        m_frame_uniform_offset = allocation.offset;
+        
+        const auto command_buffer = get_current_command_buffer();
+        bind_descriptor_sets(command_buffer, vk::PipelineBindPoint::eGraphics, m_frame_uniform_offset);
+        bind_descriptor_sets(command_buffer, vk::PipelineBindPoint::eCompute, m_frame_uniform_offset);
+    }
+    
+    void RenderPass::set_draw_uniforms(const vk::CommandBuffer command_buffer,
+                                       const std::span<const std::byte> data)
+    {
+        std::memcpy(allocate_draw_uniforms(command_buffer, data.size()).data(), data.data(), data.size());
+    }
+    
+    // Only the dynamic offsets change between draws; the descriptor set itself is never written again.
+    std::span<std::byte> RenderPass::allocate_draw_uniforms(const vk::CommandBuffer command_buffer, const usize size)
+    {
+        MH_ASSERT_DEBUG(size <= UniformRing::MAX_UNIFORM_SIZE, "Draw uniforms of {} bytes are over the {} allowed.",
+                        size, UniformRing::MAX_UNIFORM_SIZE);
+        
+        const auto allocation = m_uniform_ring.allocate(size);
+        
+        const std::array dynamic_offsets{m_frame_uniform_offset, allocation.offset};
+        const auto descriptor_set = m_uniform_ring.get_descriptor_set();
+        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipeline_layout, 1, 1, &descriptor_set,
+                                          static_cast<u32>(dynamic_offsets.size()), dynamic_offsets.data());
+        
+        return {allocation.mapped_ptr, size};
+    }
+    
+    void RenderPass::push_constants(const vk::CommandBuffer command_buffer, const std::span<const std::byte> data,
+                                    const u32 offset) const
+    {
+        MH_ASSERT_DEBUG(offset + data.size() <= PUSH_CONSTANT_SIZE, "Push constants must fit in {} bytes.",
+                        PUSH_CONSTANT_SIZE);
+        
+        command_buffer.pushConstants(m_pipeline_layout, vk::ShaderStageFlagBits::eAll, offset,
+                                     static_cast<u32>(data.size()), data.data());
+    }
+    
     void RenderPass::draw(const u32 vertex_count, const u32 instance_count,
                           const u32 first_vertex, const u32 first_instance)
     {
         get_current_command_buffer().draw(vertex_count, instance_count, first_vertex, first_instance);
     }
     
+    void RenderPass::draw_indirect(const vk::CommandBuffer command_buffer,
+                                   const std::span<const vk::DrawIndirectCommand> commands)
+    {
+        if (!m_device_ptr->supports_multi_draw_indirect())
+        {
+            for (const auto &command : commands)
+            {
+                command_buffer.draw(command.vertexCount, command.instanceCount, command.firstVertex,
+                                    command.firstInstance);
+            }
+            
+            return;
+        }
+        
+        const auto size = commands.size_bytes();
+        const auto allocation = m_uniform_ring.allocate(size);
+        std::memcpy(allocation.mapped_ptr, commands.data(), size);
+        
+        command_buffer.drawIndirect(m_uniform_ring.get_buffer(), allocation.offset, static_cast<u32>(commands.size()),
+                                    sizeof(vk::DrawIndirectCommand));
+    }
+    
+    void RenderPass::record_parallel(const usize count,
+                                     const std::function<void(vk::CommandBuffer, usize, usize)> &record)
+    {
+        MH_ASSERT(m_is_rendering, "Render Pass must be rendering to record into it.");
+        
+        if (count == 0)
+        {
+            return;
+        }
+        
+        auto &secondary_command_pools = m_secondary_command_pools[m_swapchain_ptr->get_current_frame_index()];
+        const auto range_count = std::clamp<usize>(count / MIN_ITEMS_PER_RECORDING_RANGE, 1,
+                                                   secondary_command_pools.size());
+        
+        std::vector<vk::CommandBuffer> secondary_command_buffers(range_count);
+        const auto record_range = [&](const usize range_index)
+        {
+            const auto secondary_command_buffer = begin_secondary_command_buffer(secondary_command_pools[range_index]);
+            record(secondary_command_buffer, count * range_index / range_count,
+                   count * (range_index + 1) / range_count);
+            
+            const auto result = secondary_command_buffer.end();
+            MH_ASSERT_VK(result, "Failed to end recording Vulkan secondary command buffer.");
+            
+            secondary_command_buffers[range_index] = secondary_command_buffer;
+        };
+        
+        // The first range is left for the calling thread so that it does not sit idle.
+        std::latch ranges_recorded(static_cast<std::ptrdiff_t>(range_count - 1));
+        for (usize range_index = 1; range_index < range_count; ++range_index)
+        {
+            m_recording_thread_pool.submit([&record_range, &ranges_recorded, range_index]
+            {
+                record_range(range_index);
+                ranges_recorded.count_down();
+            });
+        }
+        
+        record_range(0);
+        ranges_recorded.wait();
+        
+        // Secondary command buffers can only be executed in a rendering instance of their own, which resumes the
+        // suspended inline one and is suspended in turn.
+        const auto command_buffer = get_current_command_buffer();
+        command_buffer.endRendering();
+        
+        record_begin_rendering(RESUMED_RENDERING_FLAGS | vk::RenderingFlagBits::eContentsSecondaryCommandBuffers);
+        command_buffer.executeCommands(static_cast<u32>(secondary_command_buffers.size()),
+                                       secondary_command_buffers.data());
+        command_buffer.endRendering();
+        
+        record_begin_rendering(RESUMED_RENDERING_FLAGS);
+        set_viewport_and_scissor(command_buffer);
+        
+        // Executing secondary command buffers leaves the primary's bound state undefined.
+        bind_descriptor_sets(command_buffer, vk::PipelineBindPoint::eGraphics, m_frame_uniform_offset);
+        bind_descriptor_sets(command_buffer, vk::PipelineBindPoint::eCompute, m_frame_uniform_offset);
+    }
+    
+    void RenderPass::end_rendering()
+    {
+        MH_ASSERT(m_is_rendering, "Render Pass must be rendering to end rendering.");
+        
+        // The inline instance is always suspended, since record_parallel() may have needed it to be. An empty instance
+        // resumes it to end the render pass instance.
+        const auto command_buffer = get_current_command_buffer();
+        command_buffer.endRendering();
+        record_begin_rendering(vk::RenderingFlagBits::eResuming);
+        command_buffer.endRendering();
+        
+        m_is_rendering = false;
+    }
+    
     void RenderPass::end()
     {
         MH_ASSERT(m_current_image_index_opt.has_value(), "Render Pass must have begun to end it.");
+        MH_ASSERT(!m_is_rendering, "Render Pass must end rendering before ending it.");
         
         const auto command_buffer = get_current_command_buffer();
         
-        command_buffer.endRenderPass();
-        
         const auto result = command_buffer.end();
         MH_ASSERT_VK(result, "Failed to end recording Vulkan command buffer.");
         
-        m_swapchain_ptr->present(m_current_image_index_opt.value(), command_buffer);
+        m_swapchain_ptr->present(m_current_image_index_opt.value(), command_buffer, m_wait_semaphore_infos);
         
         m_current_image_index_opt = std::nullopt;
     }
@@ -120,83 +303,239 @@ namespace mellohi
         return m_command_buffers[m_swapchain_ptr->get_current_frame_index()];
     }
     
-    vk::RenderPass RenderPass::get_render_pass() const
+    u32 RenderPass::get_current_image_index() const
+    {
+        MH_ASSERT(m_current_image_index_opt.has_value(), "Render Pass must have begun to have a current image.");
+        return m_current_image_index_opt.value();
+    }
+    
+    vk::Format RenderPass::get_color_attachment_format() const
+    {
+        return m_device_ptr->get_preferred_surface_format().format;
+    }
+    
+    const PipelineLayoutKey & RenderPass::get_pipeline_layout_key() const
+    {
+        return m_pipeline_layout_key;
+    }
+    
+    vk::PipelineLayout RenderPass::get_pipeline_layout() const
     {
-        return m_render_pass;
+        return m_pipeline_layout;
     }
     
-    void RenderPass::create_render_pass()
+    void RenderPass::create_command_pool()
     {
-        const auto preferred_surface_format = m_device_ptr->get_preferred_surface_format();
+        const vk::CommandPoolCreateInfo command_pool_create_info
+        {
+            .flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+            .queueFamilyIndex = m_device_ptr->get_queue_family_index(QueueCapability::Graphics),
+        };
         
-        const vk::AttachmentDescription color_attachment
+        m_command_pool = m_device_ptr->create_command_pool(command_pool_create_info);
+    }
+    
+    void RenderPass::create_command_buffers()
+    {
+        const vk::CommandBufferAllocateInfo command_buffer_allocate_info
         {
-            .format = preferred_surface_format.format,
-            .samples = vk::SampleCountFlagBits::e1,
-            .loadOp = vk::AttachmentLoadOp::eClear,
-            .storeOp = vk::AttachmentStoreOp::eStore,
-            .stencilLoadOp = vk::AttachmentLoadOp::eDontCare,
-            .stencilStoreOp = vk::AttachmentStoreOp::eDontCare,
-            .initialLayout = vk::ImageLayout::eUndefined,
-            .finalLayout = vk::ImageLayout::ePresentSrcKHR,
+            .commandPool = m_command_pool,
+            .level = vk::CommandBufferLevel::ePrimary,
+            .commandBufferCount = m_swapchain_ptr->get_frames_in_flight(),
         };
         
-        const vk::AttachmentReference color_attachment_ref
+        m_command_buffers = m_device_ptr->allocate_command_buffers(command_buffer_allocate_info);
+    }
+    
+    void RenderPass::create_secondary_command_pools()
+    {
+        const vk::CommandPoolCreateInfo command_pool_create_info
         {
-            .attachment = 0,
-            .layout = vk::ImageLayout::eColorAttachmentOptimal,
+            .flags = vk::CommandPoolCreateFlagBits::eTransient,
+            .queueFamilyIndex = m_device_ptr->get_queue_family_index(QueueCapability::Graphics),
         };
         
-        const vk::SubpassDescription subpass_description
+        // One range per worker, plus one for the calling thread.
+        m_secondary_command_pools.resize(m_swapchain_ptr->get_frames_in_flight());
+        for (auto &frame_secondary_command_pools : m_secondary_command_pools)
         {
-            .pipelineBindPoint = vk::PipelineBindPoint::eGraphics,
-            .colorAttachmentCount = 1,
-            .pColorAttachments = &color_attachment_ref,
+            frame_secondary_command_pools.resize(m_recording_thread_pool.get_thread_count() + 1);
+            for (auto &secondary_command_pool : frame_secondary_command_pools)
+            {
+                secondary_command_pool.command_pool = m_device_ptr->create_command_pool(command_pool_create_info);
+            }
+        }
+    }
+    
+    // Earlier frames may still be executing buffers from these pools.
+    void RenderPass::retire_secondary_command_pools()
+    {
+        for (const auto &frame_secondary_command_pools : m_secondary_command_pools)
+        {
+            for (const auto &secondary_command_pool : frame_secondary_command_pools)
+            {
+                m_device_ptr->push_to_deletion_queue(secondary_command_pool.command_pool);
+            }
+        }
+        
+        m_secondary_command_pools.clear();
+    }
+    
+    void RenderPass::bind_descriptor_sets(const vk::CommandBuffer command_buffer,
+                                          const vk::PipelineBindPoint pipeline_bind_point,
+                                          const u32 draw_uniform_offset) const
+    {
+        const std::array descriptor_sets
+        {
+            m_bindless_descriptors_ptr->get_descriptor_set(),
+            m_uniform_ring.get_descriptor_set(),
+        };
+        const std::array dynamic_offsets{m_frame_uniform_offset, draw_uniform_offset};
+        
+        command_buffer.bindDescriptorSets(pipeline_bind_point, m_pipeline_layout, 0,
+                                          static_cast<u32>(descriptor_sets.size()), descriptor_sets.data(),
+                                          static_cast<u32>(dynamic_offsets.size()), dynamic_offsets.data());
+    }
+    
+    void RenderPass::record_begin_rendering(const vk::RenderingFlags flags)
+    {
+        const auto make_attachment_info = [](const RenderingAttachment &attachment, const vk::ClearValue &clear_value)
+        {
+            return vk::RenderingAttachmentInfo
+            {
+                .imageView = attachment.image_view,
+                .imageLayout = attachment.layout,
+                .loadOp = attachment.load_op,
+                .storeOp = attachment.store_op,
+                .clearValue = clear_value,
+            };
+        };
+        
+        const vk::ClearValue color_clear_value
+        {
+            .color = vk::ClearColorValue
+            {
+                .float32 = m_engine_config_ptr->get_window_clear_color().srgb_to_linear().as_array()
+            },
         };
         
-        const vk::SubpassDependency subpass_dependency
+        m_color_attachment_infos.clear();
+        for (const auto &color_attachment : m_rendering_attachments.color_attachments)
+        {
+            m_color_attachment_infos.push_back(make_attachment_info(color_attachment, color_clear_value));
+        }
+        
+        const vk::ClearValue depth_clear_value
         {
-            .srcSubpass = VK_SUBPASS_EXTERNAL,
-            .dstSubpass = 0,
-            .srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput,
-            .srcAccessMask = {},
-            .dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput,
-            .dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
+            .depthStencil = vk::ClearDepthStencilValue
+            {
+                .depth = 1.0f,
+                .stencil = 0,
+            },
         };
         
-        const vk::RenderPassCreateInfo render_pass_create_info
+        std::optional<vk::RenderingAttachmentInfo> depth_attachment_info_opt;
+        if (m_rendering_attachments.depth_attachment_opt.has_value())
+        {
+            depth_attachment_info_opt = make_attachment_info(m_rendering_attachments.depth_attachment_opt.value(),
+                                                             depth_clear_value);
+        }
+        
+        const vk::RenderingInfo rendering_info
         {
-            .attachmentCount = 1,
-            .pAttachments = &color_attachment,
-            .subpassCount = 1,
-            .pSubpasses = &subpass_description,
-            .dependencyCount = 1,
-            .pDependencies = &subpass_dependency,
+            .flags = flags,
+            .renderArea = vk::Rect2D
+            {
+                .offset = {0, 0},
+                .extent = m_rendering_attachments.extent,
+            },
+            .layerCount = 1,
+            .colorAttachmentCount = static_cast<u32>(m_color_attachment_infos.size()),
+            .pColorAttachments = m_color_attachment_infos.data(),
+            .pDepthAttachment = depth_attachment_info_opt ? &depth_attachment_info_opt.value() : nullptr,
         };
         
-        m_render_pass = m_device_ptr->create_render_pass(render_pass_create_info);
+        get_current_command_buffer().beginRendering(rendering_info);
     }
     
-    void RenderPass::create_command_pool()
+    void RenderPass::set_viewport_and_scissor(const vk::CommandBuffer command_buffer) const
     {
-        const vk::CommandPoolCreateInfo command_pool_create_info
+        const auto extent = m_rendering_attachments.extent;
+        
+        const vk::Viewport viewport
         {
-            .flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
-            .queueFamilyIndex = m_device_ptr->get_queue_family_index(QueueCapability::Graphics),
+            .x = 0.0f,
+            .y = 0.0f,
+            .width = static_cast<float>(extent.width),
+            .height = static_cast<float>(extent.height),
+            .minDepth = 0.0f,
+            .maxDepth = 1.0f,
         };
+        command_buffer.setViewport(0, 1, &viewport);
         
-        m_command_pool = m_device_ptr->create_command_pool(command_pool_create_info);
+        const vk::Rect2D scissor
+        {
+            .offset = {0, 0},
+            .extent = extent,
+        };
+        command_buffer.setScissor(0, 1, &scissor);
     }
     
-    void RenderPass::create_command_buffers()
+    // Neither bound descriptor sets nor dynamic state are inherited from the primary command buffer, so they are set
+    // again.
+    vk::CommandBuffer RenderPass::begin_secondary_command_buffer(SecondaryCommandPool &secondary_command_pool)
     {
-        const vk::CommandBufferAllocateInfo command_buffer_allocate_info
+        if (secondary_command_pool.used_count == secondary_command_pool.command_buffers.size())
         {
-            .commandPool = m_command_pool,
-            .level = vk::CommandBufferLevel::ePrimary,
-            .commandBufferCount = static_cast<u32>(Swapchain::MAX_FRAMES_IN_FLIGHT),
+            const vk::CommandBufferAllocateInfo command_buffer_allocate_info
+            {
+                .commandPool = secondary_command_pool.command_pool,
+                .level = vk::CommandBufferLevel::eSecondary,
+                .commandBufferCount = 1,
+            };
+            
+            const auto command_buffers = m_device_ptr->allocate_command_buffers(command_buffer_allocate_info);
+            secondary_command_pool.command_buffers.push_back(command_buffers.front());
+        }
+        
+        const auto command_buffer = secondary_command_pool.command_buffers[secondary_command_pool.used_count++];
+        
+        // Secondary command buffers are recorded by several threads at once, so the formats are gathered locally.
+        std::vector<vk::Format> color_attachment_formats;
+        for (const auto &color_attachment : m_rendering_attachments.color_attachments)
+        {
+            color_attachment_formats.push_back(color_attachment.format);
+        }
+        
+        const auto &depth_attachment_opt = m_rendering_attachments.depth_attachment_opt;
+        // Matches the instance the buffer is executed in, besides its contents flag.
+        const vk::CommandBufferInheritanceRenderingInfo inheritance_rendering_info
+        {
+            .flags = RESUMED_RENDERING_FLAGS,
+            .colorAttachmentCount = static_cast<u32>(color_attachment_formats.size()),
+            .pColorAttachmentFormats = color_attachment_formats.data(),
+            .depthAttachmentFormat = depth_attachment_opt ? depth_attachment_opt->format : vk::Format::eUndefined,
+            .rasterizationSamples = vk::SampleCountFlagBits::e1,
         };
         
-        m_command_buffers = m_device_ptr->allocate_command_buffers(command_buffer_allocate_info);
+        const vk::CommandBufferInheritanceInfo inheritance_info
+        {
+            .pNext = &inheritance_rendering_info,
+        };
+        
+        const vk::CommandBufferBeginInfo command_buffer_begin_info
+        {
+            .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit
+                     | vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+            .pInheritanceInfo = &inheritance_info,
+        };
+        
+        const auto result = command_buffer.begin(command_buffer_begin_info);
+        MH_ASSERT_VK(result, "Failed to begin recording Vulkan secondary command buffer.");
+        
+        bind_descriptor_sets(command_buffer, vk::PipelineBindPoint::eGraphics, m_frame_uniform_offset);
+        set_viewport_and_scissor(command_buffer);
+        
+        return command_buffer;
     }
 }
@@ -0,0 +1,198 @@
+#include "mellohi/graphics/vulkan/shader_cache.hpp"
+
+#include <fstream>
+#include <latch>
+#include <thread>
+
+#include <shaderc/shaderc.hpp>
+
+#include "mellohi/core/assets/asset_manager.hpp"
+
+namespace mellohi
+{
+    // Bump whenever the compile options below change.
+    static constexpr u32 SHADER_CACHE_VERSION = 1;
+    static constexpr auto SHADER_OPTIMIZATION_LEVEL = shaderc_optimization_level_performance;
+    static constexpr u32 SPIRV_MAGIC_NUMBER = 0x07230203;
+    
+    // The stage is inferred from the file extension.
+    static std::optional<shaderc_shader_kind> shader_kind_from_extension(const std::string_view extension)
+    {
+        if (extension == ".vert")
+        {
+            return shaderc_vertex_shader;
+        }
+        else if (extension == ".frag")
+        {
+            return shaderc_fragment_shader;
+        }
+        else if (extension == ".comp")
+        {
+            return shaderc_compute_shader;
+        }
+        
+        return std::nullopt;
+    }
+    
+    ShaderCache & ShaderCache::get()
+    {
+        static ShaderCache shader_cache(std::filesystem::path(MH_CACHE_DIR) / "shaders");
+        return shader_cache;
+    }
+    
+    ShaderCache::ShaderCache(std::filesystem::path cache_dir) : m_cache_dir(std::move(cache_dir))
+    {
+        std::error_code error_code;
+        std::filesystem::create_directories(m_cache_dir, error_code);
+        if (error_code)
+        {
+            MH_WARN("Failed to create shader cache dir {}: {}", m_cache_dir.string(), error_code.message());
+        }
+        
+        // The SPIR-V version only changes with the SPIR-V target, not with shaderc itself, so compiler upgrades are
+        // told apart by the version the build passes in.
+        u32 spirv_version = 0, spirv_revision = 0;
+        shaderc_get_spv_version(&spirv_version, &spirv_revision);
+        
+        m_compiler_hash = fnv1a_64_value(SHADER_CACHE_VERSION);
+        m_compiler_hash = fnv1a_64(MH_SHADER_COMPILER_VERSION, m_compiler_hash);
+        m_compiler_hash = fnv1a_64_value(static_cast<u32>(SHADER_OPTIMIZATION_LEVEL), m_compiler_hash);
+        m_compiler_hash = fnv1a_64_value(spirv_version, m_compiler_hash);
+        m_compiler_hash = fnv1a_64_value(spirv_revision, m_compiler_hash);
+    }
+    
+    std::vector<u32> ShaderCache::get_spirv_code(const AssetId &shader_id)
+    {
+        const auto source_code = shader_id.read_file_as_string();
+        
+        const auto extension = std::filesystem::path(shader_id.get_fully_qualified_path()).extension().string();
+        const auto shader_kind_opt = shader_kind_from_extension(extension);
+        MH_ASSERT(shader_kind_opt.has_value(), "Shader {} has unknown extension {}.", shader_id, extension);
+        
+        auto key = fnv1a_64_value(static_cast<u32>(shader_kind_opt.value()), m_compiler_hash);
+        key = fnv1a_64(source_code, key);
+        
+        const auto entry_path = m_cache_dir / std::format("{:016x}.spv", key);
+        
+        if (auto spirv_code_opt = read_entry(entry_path))
+        {
+            ++m_hit_count;
+            MH_TRACE("Shader {} loaded from cache.", shader_id);
+            return std::move(spirv_code_opt.value());
+        }
+        
+        ++m_miss_count;
+        
+        auto spirv_code = compile(shader_id, source_code, shader_kind_opt.value());
+        write_entry(entry_path, spirv_code);
+        return spirv_code;
+    }
+    
+    void ShaderCache::prewarm(AssetManager &asset_manager, const std::vector<AssetId> &shader_ids)
+    {
+        if (shader_ids.empty())
+        {
+            return;
+        }
+        
+        // The first shader is left for the calling thread so that it does not sit idle.
+        std::latch compiles_remaining(static_cast<std::ptrdiff_t>(shader_ids.size() - 1));
+        for (usize i = 1; i < shader_ids.size(); ++i)
+        {
+            asset_manager.submit_background_task([this, &shader_id = shader_ids[i], &compiles_remaining]
+            {
+                const auto _ = get_spirv_code(shader_id);
+                compiles_remaining.count_down();
+            });
+        }
+        
+        const auto _ = get_spirv_code(shader_ids.front());
+        compiles_remaining.wait();
+    }
+    
+    usize ShaderCache::get_hit_count() const
+    {
+        return m_hit_count;
+    }
+    
+    usize ShaderCache::get_miss_count() const
+    {
+        return m_miss_count;
+    }
+    
+    std::optional<std::vector<u32>> ShaderCache::read_entry(const std::filesystem::path &entry_path) const
+    {
+        std::ifstream ifs(entry_path, std::ios::binary | std::ios::ate);
+        if (!ifs)
+        {
+            return std::nullopt;
+        }
+        
+        const auto size = static_cast<usize>(ifs.tellg());
+        if (size == 0 || size % sizeof(u32) != 0)
+        {
+            return std::nullopt;
+        }
+        
+        ifs.seekg(0, std::ios::beg);
+        std::vector<u32> spirv_code(size / sizeof(u32));
+        ifs.read(reinterpret_cast<char *>(spirv_code.data()), size);
+        
+        if (!ifs || spirv_code[0] != SPIRV_MAGIC_NUMBER)
+        {
+            MH_WARN("Ignoring corrupt shader cache entry {}.", entry_path.string());
+            return std::nullopt;
+        }
+        
+        return spirv_code;
+    }
+    
+    void ShaderCache::write_entry(const std::filesystem::path &entry_path, const std::vector<u32> &spirv_code) const
+    {
+        // Written to a temporary file first so that a crash or a concurrent reader never sees a partial entry.
+        auto temp_path = entry_path;
+        temp_path += std::format(".{}.tmp", std::hash<std::thread::id>{}(std::this_thread::get_id()));
+        
+        {
+            std::ofstream ofs(temp_path, std::ios::binary | std::ios::trunc);
+            ofs.write(reinterpret_cast<const char *>(spirv_code.data()), spirv_code.size() * sizeof(u32));
+            
+            if (!ofs)
+            {
+                MH_WARN("Failed to write shader cache entry {}.", entry_path.string());
+                return;
+            }
+        }
+        
+        std::error_code error_code;
+        std::filesystem::rename(temp_path, entry_path, error_code);
+        if (error_code)
+        {
+            MH_WARN("Failed to write shader cache entry {}: {}", entry_path.string(), error_code.message());
+            std::filesystem::remove(temp_path, error_code);
+        }
+    }
+    
+    std::vector<u32> ShaderCache::compile(const AssetId &shader_id, const std::string_view source_code,
+                                          const shaderc_shader_kind shader_kind)
+    {
+        // Compilers are not safe to share between threads, so each worker keeps its own rather than creating one per
+        // shader.
+        thread_local const shaderc::Compiler compiler;
+        shaderc::CompileOptions options;
+        
+        options.SetOptimizationLevel(SHADER_OPTIMIZATION_LEVEL);
+        
+        const auto result = compiler.CompileGlslToSpv(source_code.data(), source_code.size(),
+                                                      shader_kind,
+                                                      shader_id.get_fully_qualified_path().c_str(),
+                                                      options);
+        
+        MH_ASSERT(result.GetCompilationStatus() == shaderc_compilation_status_success,
+                  "Shader {} compilation failed: {}", shader_id, result.GetErrorMessage());
+        
+        MH_DEBUG("Shader {} compiled.", shader_id);
+        
+        return {result.cbegin(), result.cend()};
+    }
+}
@@ -0,0 +1,106 @@
+#include "mellohi/graphics/vulkan/staging_ring.hpp"
+
+namespace mellohi
+{
+    StagingRing::StagingRing(const std::shared_ptr<Device> device_ptr, const vk::DeviceSize size)
+        : m_device_ptr(device_ptr)
+    {
+        const vk::BufferCreateInfo buffer_create_info
+        {
+            .size = size,
+            .usage = vk::BufferUsageFlagBits::eTransferSrc,
+            .sharingMode = vk::SharingMode::eExclusive,
+        };
+        
+        m_buffer = m_device_ptr->create_buffer(buffer_create_info, {
+            .usage = MemoryUsage::CpuToGpu,
+            .dedicated = true,
+        });
+        
+        MH_ASSERT(m_buffer.allocation.mapped_ptr, "Staging buffer memory is not host visible.");
+    }
+    
+    StagingRing::~StagingRing()
+    {
+        m_device_ptr->push_to_deletion_queue(m_buffer);
+    }
+    
+    std::optional<vk::DeviceSize> StagingRing::allocate(const vk::DeviceSize size, const vk::DeviceSize alignment)
+    {
+        if (is_empty())
+        {
+            m_head = 0;
+            m_tail = 0;
+        }
+        
+        auto offset = (m_head + alignment - 1) / alignment * alignment;
+        
+        if (m_head >= m_tail)
+        {
+            if (offset + size > get_size())
+            {
+                // Wrap around. The skipped bytes at the end are reclaimed together with the current batch.
+                offset = 0;
+                if (size >= m_tail)
+                {
+                    return std::nullopt;
+                }
+            }
+        }
+        else if (offset + size >= m_tail)
+        {
+            return std::nullopt;
+        }
+        
+        m_head = offset + size;
+        return offset;
+    }
+    
+    void StagingRing::close_batch(const u64 batch)
+    {
+        const auto batch_start = m_batch_regions.empty() ? m_tail : m_batch_regions.back().end;
+        if (m_head != batch_start)
+        {
+            m_batch_regions.push_back({ .batch = batch, .end = m_head });
+        }
+    }
+    
+    void StagingRing::release_batches_before(const u64 batch)
+    {
+        while (!m_batch_regions.empty() && m_batch_regions.front().batch < batch)
+        {
+            m_tail = m_batch_regions.front().end;
+            m_batch_regions.pop_front();
+        }
+    }
+    
+    bool StagingRing::is_empty() const
+    {
+        return m_head == m_tail && m_batch_regions.empty();
+    }
+    
+    std::optional<u64> StagingRing::get_oldest_batch_opt() const
+    {
+        if (m_batch_regions.empty())
+        {
+            return std::nullopt;
+        }
+        
+        return m_batch_regions.front().batch;
+    }
+    
+    vk::Buffer StagingRing::get_buffer() const
+    {
+        return m_buffer.buffer;
+    }
+    
+    vk::DeviceSize StagingRing::get_size() const
+    {
+        return m_buffer.size;
+    }
+    
+    std::byte * StagingRing::get_mapped_ptr(const vk::DeviceSize offset) const
+    {
+        return static_cast<std::byte *>(m_buffer.allocation.mapped_ptr) + offset;
+    }
+}
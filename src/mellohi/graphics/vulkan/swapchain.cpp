@@ -10,6 +10,8 @@ namespace mellohi
             std::bind(&Swapchain::on_engine_config_reloaded, this)
         );
         
+        m_presentation_settings = get_configured_presentation_settings();
+        
         create_swapchain();
         create_image_views();
         create_sync_objects();
@@ -20,25 +22,19 @@ namespace mellohi
         m_engine_config_ptr->deregister_reload_callback(m_engine_config_reloaded_callback_id);
         
         destroy();
-        
-        for (auto i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
-        {
-            m_device_ptr->destroy_fence(m_in_flight_fences[i]);
-            m_device_ptr->destroy_semaphore(m_render_finished_semaphores[i]);
-            m_device_ptr->destroy_semaphore(m_image_available_semaphores[i]);
-        }
-    }
-    
-    void Swapchain::init_with_render_pass(const vk::RenderPass render_pass)
-    {
-        m_render_pass = render_pass;
-        
-        create_framebuffers();
     }
     
     std::optional<u32> Swapchain::acquire_next_image_index()
     {
-        m_device_ptr->wait_for_fence(m_in_flight_fences[m_current_frame_index]);
+        // The frame frames_in_flight ago used this frame's semaphores and command buffer.
+        const auto frame = m_device_ptr->get_frame();
+        if (frame >= m_presentation_settings.frames_in_flight)
+        {
+            m_device_ptr->wait_for_frame(frame - m_presentation_settings.frames_in_flight);
+        }
+        
+        m_device_ptr->flush_deletion_queue();
+        destroy_finished_presentation_objects();
         
         u32 image_index;
         auto result = m_device_ptr->get_device()
@@ -55,44 +51,77 @@ namespace mellohi
             MH_ASSERT(false, "Failed to acquire Vulkan swapchain image.");
         }
         
-        m_device_ptr->reset_fence(m_in_flight_fences[m_current_frame_index]);
-        
         return image_index;
     }
     
-    void Swapchain::present(const u32 image_index, const vk::CommandBuffer command_buffer)
+    void Swapchain::present(const u32 image_index, const vk::CommandBuffer command_buffer,
+                            const std::span<const vk::SemaphoreSubmitInfo> wait_semaphore_infos)
     {
-        const vk::Semaphore wait_semaphores[] = {m_image_available_semaphores[m_current_frame_index]};
-        const vk::PipelineStageFlags wait_stages[] = {vk::PipelineStageFlagBits::eColorAttachmentOutput};
-        const vk::Semaphore signal_semaphores[] = {m_render_finished_semaphores[m_current_frame_index]};
+        std::vector<vk::SemaphoreSubmitInfo> all_wait_semaphore_infos(wait_semaphore_infos.begin(),
+                                                                      wait_semaphore_infos.end());
+        all_wait_semaphore_infos.push_back(vk::SemaphoreSubmitInfo
+        {
+            .semaphore = m_image_available_semaphores[m_current_frame_index],
+            .stageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+        });
         
-        const vk::SubmitInfo submit_info
+        // Values for binary semaphores are ignored.
+        const vk::SemaphoreSubmitInfo signal_semaphore_infos[] =
         {
-            .waitSemaphoreCount = 1,
-            .pWaitSemaphores = wait_semaphores,
-            .pWaitDstStageMask = wait_stages,
-            .commandBufferCount = 1,
-            .pCommandBuffers = &command_buffer,
-            .signalSemaphoreCount = 1,
-            .pSignalSemaphores = signal_semaphores,
+            {
+                .semaphore = m_render_finished_semaphores[m_current_frame_index],
+                .stageMask = vk::PipelineStageFlagBits2::eAllCommands,
+            },
+            {
+                .semaphore = m_device_ptr->get_frame_timeline_semaphore(),
+                .value = m_device_ptr->get_frame() + 1,
+                .stageMask = vk::PipelineStageFlagBits2::eAllCommands,
+            },
         };
         
-        const auto graphics_queue = m_device_ptr->get_queue(QueueCapability::Graphics);
+        m_device_ptr->submit(QueueCapability::Graphics, {&command_buffer, 1}, all_wait_semaphore_infos,
+                             signal_semaphore_infos);
+        m_device_ptr->advance_frame();
         
-        auto result = graphics_queue.submit(1, &submit_info, m_in_flight_fences[m_current_frame_index]);
-        MH_ASSERT_VK(result, "Failed to submit Vulkan queue.");
+        vk::Fence present_fence;
+        if (m_device_ptr->supports_present_fences())
+        {
+            if (m_free_present_fences.empty())
+            {
+                present_fence = m_device_ptr->create_fence({});
+            }
+            else
+            {
+                present_fence = m_free_present_fences.back();
+                m_free_present_fences.pop_back();
+            }
+        }
+        
+        const vk::SwapchainPresentFenceInfoEXT present_fence_info
+        {
+            .swapchainCount = 1,
+            .pFences = &present_fence,
+        };
         
         const vk::PresentInfoKHR present_info
         {
+            .pNext = present_fence ? &present_fence_info : nullptr,
             .waitSemaphoreCount = 1,
-            .pWaitSemaphores = signal_semaphores,
+            .pWaitSemaphores = &m_render_finished_semaphores[m_current_frame_index],
             .swapchainCount = 1,
             .pSwapchains = &m_swapchain,
             .pImageIndices = &image_index,
             .pResults = nullptr,
         };
         
-        result = graphics_queue.presentKHR(present_info);
+        // Presents that fail with an out of date swapchain still count as queued, so their fences are signaled too.
+        const auto result = m_device_ptr->present(present_info);
+        ++m_present_count;
+        if (present_fence)
+        {
+            m_pending_present_fences.push_back(present_fence);
+        }
+        
         if (m_should_be_recreated || result == vk::Result::eErrorOutOfDateKHR || result == vk::Result::eSuboptimalKHR)
         {
             recreate();
@@ -102,7 +131,7 @@ namespace mellohi
             MH_ASSERT(false, "Failed to present Vulkan swapchain image.");
         }
         
-        m_current_frame_index = (m_current_frame_index + 1) % MAX_FRAMES_IN_FLIGHT;
+        m_current_frame_index = (m_current_frame_index + 1) % m_presentation_settings.frames_in_flight;
     }
     
     usize Swapchain::get_current_frame_index() const
@@ -110,6 +139,11 @@ namespace mellohi
         return m_current_frame_index;
     }
 
+    u32 Swapchain::get_frames_in_flight() const
+    {
+        return m_presentation_settings.frames_in_flight;
+    }
+
     vk::Extent2D Swapchain::get_extent() const
     {
         return m_extent;
@@ -120,29 +154,19 @@ namespace mellohi
         return m_swapchain;
     }
 
-    const std::vector<vk::ImageView> & Swapchain::get_image_views() const
+    vk::Image Swapchain::get_image(const u32 image_index) const
     {
-        return m_image_views;
+        return m_images[image_index];
     }
     
-    vk::Framebuffer Swapchain::get_framebuffer(const u32 image_index) const
+    vk::ImageView Swapchain::get_image_view(const u32 image_index) const
     {
-        return m_framebuffers[image_index];
+        return m_image_views[image_index];
     }
     
     void Swapchain::create_swapchain()
     {
-        const auto available_present_modes = m_device_ptr->get_surface_present_modes();
-        auto present_mode = vk::PresentModeKHR::eFifo;
-        for (const auto &available_present_mode : available_present_modes)
-        {
-            if (m_engine_config_ptr->get_window_vsync() && available_present_mode == vk::PresentModeKHR::eMailbox
-                || !m_engine_config_ptr->get_window_vsync() && available_present_mode == vk::PresentModeKHR::eImmediate)
-            {
-                present_mode = available_present_mode;
-                break;
-            }
-        }
+        const auto present_mode = choose_present_mode();
         
         const auto surface_capabilities = m_device_ptr->get_surface_capabilities();
         m_extent = surface_capabilities.currentExtent;
@@ -157,11 +181,7 @@ namespace mellohi
                                          surface_capabilities.maxImageExtent.height);
         }
         
-        auto image_count = surface_capabilities.minImageCount + 1;
-        if (surface_capabilities.maxImageCount > 0 && image_count > surface_capabilities.maxImageCount)
-        {
-            image_count = surface_capabilities.maxImageCount;
-        }
+        const auto image_count = choose_image_count(surface_capabilities);
         
         const auto surface_format = m_device_ptr->get_preferred_surface_format();
         
@@ -178,14 +198,20 @@ namespace mellohi
             .compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque,
             .presentMode = present_mode,
             .clipped = vk::True,
+            .oldSwapchain = m_swapchain,
         };
         
-        const auto unique_queue_families = m_device_ptr->get_unique_queue_family_indices();
-        if (unique_queue_families.size() > 1)
+        // Swapchain images are only rendered to and presented.
+        const u32 queue_family_indices[] =
+        {
+            m_device_ptr->get_queue_family_index(QueueCapability::Graphics),
+            m_device_ptr->get_queue_family_index(QueueCapability::Present),
+        };
+        if (!m_device_ptr->shares_queue_family(QueueCapability::Graphics, QueueCapability::Present))
         {
             swapchain_create_info.imageSharingMode = vk::SharingMode::eConcurrent;
-            swapchain_create_info.queueFamilyIndexCount = unique_queue_families.size();
-            swapchain_create_info.pQueueFamilyIndices = unique_queue_families.data();
+            swapchain_create_info.queueFamilyIndexCount = 2;
+            swapchain_create_info.pQueueFamilyIndices = queue_family_indices;
         }
         else
         {
@@ -197,10 +223,10 @@ namespace mellohi
     
     void Swapchain::create_image_views()
     {
-        const auto swapchain_images = m_device_ptr->get_swapchain_images(m_swapchain);
+        m_images = m_device_ptr->get_swapchain_images(m_swapchain);
         const auto surface_format = m_device_ptr->get_preferred_surface_format();
         
-        for (const auto &swapchain_image : swapchain_images)
+        for (const auto &swapchain_image : m_images)
         {
             const vk::ImageViewCreateInfo image_view_create_info
             {
@@ -228,58 +254,218 @@ namespace mellohi
         }
     }
     
-    void Swapchain::create_framebuffers()
+    void Swapchain::create_sync_objects()
     {
-        for (const auto &image_view : m_image_views)
+        for (auto i = 0; i < m_presentation_settings.frames_in_flight; ++i)
         {
-            const vk::FramebufferCreateInfo framebuffer_create_info
-            {
-                .renderPass = m_render_pass,
-                .attachmentCount = 1,
-                .pAttachments = &image_view,
-                .width = m_extent.width,
-                .height = m_extent.height,
-                .layers = 1,
-            };
-            
-            m_framebuffers.push_back(m_device_ptr->create_framebuffer(framebuffer_create_info));
+            m_image_available_semaphores.push_back(m_device_ptr->create_semaphore({}));
+            m_render_finished_semaphores.push_back(m_device_ptr->create_semaphore({}));
         }
     }
     
-    void Swapchain::create_sync_objects()
+    void Swapchain::retire_sync_objects()
     {
-        const vk::FenceCreateInfo fence_create_info
+        RetiredPresentationObjects presentation_objects
         {
-            .flags = vk::FenceCreateFlagBits::eSignaled,
+            .present_count = m_present_count,
         };
+        presentation_objects.semaphores.insert(presentation_objects.semaphores.end(),
+                                               m_image_available_semaphores.begin(),
+                                               m_image_available_semaphores.end());
+        presentation_objects.semaphores.insert(presentation_objects.semaphores.end(),
+                                               m_render_finished_semaphores.begin(),
+                                               m_render_finished_semaphores.end());
+        m_retired_presentation_objects.push_back(std::move(presentation_objects));
         
-        for (auto i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        m_render_finished_semaphores.clear();
+        m_image_available_semaphores.clear();
+    }
+    
+    void Swapchain::destroy_finished_presentation_objects()
+    {
+        while (!m_pending_present_fences.empty() && m_device_ptr->is_fence_signaled(m_pending_present_fences.front()))
         {
-            m_image_available_semaphores.push_back(m_device_ptr->create_semaphore({}));
-            m_render_finished_semaphores.push_back(m_device_ptr->create_semaphore({}));
-            m_in_flight_fences.push_back(m_device_ptr->create_fence(fence_create_info));
+            m_device_ptr->reset_fence(m_pending_present_fences.front());
+            m_free_present_fences.push_back(m_pending_present_fences.front());
+            m_pending_present_fences.pop_front();
+            ++m_finished_present_count;
+        }
+        
+        while (!m_retired_presentation_objects.empty()
+               && m_retired_presentation_objects.front().present_count <= m_finished_present_count)
+        {
+            destroy_presentation_objects(m_retired_presentation_objects.front());
+            m_retired_presentation_objects.pop_front();
         }
     }
     
+    void Swapchain::destroy_presentation_objects(const RetiredPresentationObjects &presentation_objects) const
+    {
+        if (presentation_objects.swapchain)
+        {
+            m_device_ptr->destroy_swapchain(presentation_objects.swapchain);
+        }
+        
+        for (const auto &semaphore : presentation_objects.semaphores)
+        {
+            m_device_ptr->destroy_semaphore(semaphore);
+        }
+    }
+    
+    Swapchain::PresentationSettings Swapchain::get_configured_presentation_settings() const
+    {
+        const PresentationSettings presentation_settings
+        {
+            .vsync = m_engine_config_ptr->get_window_vsync(),
+            .frames_in_flight = m_engine_config_ptr->get_graphics_frames_in_flight(),
+            .latency_mode = m_engine_config_ptr->get_graphics_latency_mode(),
+        };
+        
+        MH_ASSERT(presentation_settings.frames_in_flight >= 1
+                  && presentation_settings.frames_in_flight <= MAX_FRAMES_IN_FLIGHT,
+                  "graphics.frames_in_flight must be between 1 and {}, not {}.", MAX_FRAMES_IN_FLIGHT,
+                  presentation_settings.frames_in_flight);
+        
+        return presentation_settings;
+    }
+    
+    // Takes the first supported mode in order of preference. FIFO is always supported.
+    vk::PresentModeKHR Swapchain::choose_present_mode() const
+    {
+        const auto vsync = m_presentation_settings.vsync;
+        
+        std::vector<vk::PresentModeKHR> preferred_present_modes;
+        switch (m_presentation_settings.latency_mode)
+        {
+            case LatencyMode::LowLatency:
+                // Mailbox replaces queued images, so the newest frame is always the next one shown.
+                preferred_present_modes = vsync
+                    ? std::vector{vk::PresentModeKHR::eMailbox}
+                    : std::vector{vk::PresentModeKHR::eImmediate, vk::PresentModeKHR::eMailbox};
+                break;
+            case LatencyMode::Balanced:
+                preferred_present_modes = vsync
+                    ? std::vector{vk::PresentModeKHR::eMailbox}
+                    : std::vector{vk::PresentModeKHR::eImmediate};
+                break;
+            case LatencyMode::Throughput:
+                // FIFO never discards a rendered frame, letting the queue of images absorb spikes.
+                preferred_present_modes = vsync
+                    ? std::vector{vk::PresentModeKHR::eFifo}
+                    : std::vector{vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eImmediate};
+                break;
+        }
+        
+        const auto available_present_modes = m_device_ptr->get_surface_present_modes();
+        for (const auto preferred_present_mode : preferred_present_modes)
+        {
+            if (std::ranges::find(available_present_modes, preferred_present_mode) != available_present_modes.end())
+            {
+                return preferred_present_mode;
+            }
+        }
+        
+        return vk::PresentModeKHR::eFifo;
+    }
+    
+    // One image per frame in flight, plus extra images queued for presentation depending on the latency mode.
+    u32 Swapchain::choose_image_count(const vk::SurfaceCapabilitiesKHR &surface_capabilities) const
+    {
+        u32 queued_image_count = 0;
+        switch (m_presentation_settings.latency_mode)
+        {
+            case LatencyMode::LowLatency:
+                queued_image_count = 0;
+                break;
+            case LatencyMode::Balanced:
+                queued_image_count = 1;
+                break;
+            case LatencyMode::Throughput:
+                queued_image_count = 2;
+                break;
+        }
+        
+        auto image_count = std::max(m_presentation_settings.frames_in_flight + queued_image_count,
+                                    surface_capabilities.minImageCount);
+        if (surface_capabilities.maxImageCount > 0 && image_count > surface_capabilities.maxImageCount)
+        {
+            image_count = surface_capabilities.maxImageCount;
+        }
+        
+        return image_count;
+    }
+    
+    // Frames already in flight keep using the old swapchain's resources, which are retired rather than destroyed.
     void Swapchain::recreate()
     {
-        destroy();
+        const auto presentation_settings = get_configured_presentation_settings();
+        const bool frames_in_flight_changed =
+            presentation_settings.frames_in_flight != m_presentation_settings.frames_in_flight;
+        m_presentation_settings = presentation_settings;
+        
+        // Without present fences nothing tells when presentation has finished with the old swapchain and semaphores,
+        // so the device is idled instead. Recreation only follows resizes and config changes.
+        if (!m_device_ptr->supports_present_fences())
+        {
+            m_device_ptr->wait_idle();
+            m_finished_present_count = m_present_count;
+        }
+        
+        // Per-frame objects are indexed by frame slot, so changing how many there are needs every submitted frame to
+        // have finished. Only a config change can do this, never a resize.
+        if (frames_in_flight_changed)
+        {
+            const auto frame = m_device_ptr->get_frame();
+            if (frame > 0)
+            {
+                m_device_ptr->wait_for_frame(frame - 1);
+            }
+            
+            retire_sync_objects();
+            m_current_frame_index = 0;
+            create_sync_objects();
+        }
+        
+        retire();
         create_swapchain();
         create_image_views();
-        create_framebuffers();
         
         m_should_be_recreated = false;
     }
     
+    void Swapchain::retire()
+    {
+        for (const auto &image_view : m_image_views)
+        {
+            m_device_ptr->push_to_deletion_queue(image_view);
+        }
+        m_image_views.clear();
+        
+        // The handle is kept until the new swapchain has been created from it, which happens before any presentation
+        // objects are destroyed.
+        m_retired_presentation_objects.push_back({
+            .present_count = m_present_count,
+            .swapchain = m_swapchain,
+        });
+    }
+    
     void Swapchain::destroy()
     {
         m_device_ptr->wait_idle();
         
-        for (const auto &framebuffer : m_framebuffers)
+        // Idling the device does not cover presentation, which signals the fences once it has finished.
+        for (const auto &present_fence : m_pending_present_fences)
+        {
+            m_device_ptr->wait_for_fence(present_fence);
+            m_device_ptr->destroy_fence(present_fence);
+        }
+        m_pending_present_fences.clear();
+        
+        for (const auto &present_fence : m_free_present_fences)
         {
-            m_device_ptr->destroy_framebuffer(framebuffer);
+            m_device_ptr->destroy_fence(present_fence);
         }
-        m_framebuffers.clear();
+        m_free_present_fences.clear();
         
         for (const auto &image_view : m_image_views)
         {
@@ -287,12 +473,22 @@ namespace mellohi
         }
         m_image_views.clear();
         
-        m_device_ptr->destroy_swapchain(m_swapchain);
+        retire();
+        retire_sync_objects();
+        for (const auto &presentation_objects : m_retired_presentation_objects)
+        {
+            destroy_presentation_objects(presentation_objects);
+        }
+        m_retired_presentation_objects.clear();
         m_swapchain = nullptr;
     }
     
     void Swapchain::on_engine_config_reloaded()
     {
-        m_should_be_recreated = true;
+        // Most config changes (e.g. the clear color) don't affect presentation.
+        if (get_configured_presentation_settings() != m_presentation_settings)
+        {
+            m_should_be_recreated = true;
+        }
     }
 }
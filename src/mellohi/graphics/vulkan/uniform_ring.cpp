@@ -0,0 +1,142 @@
+#include "mellohi/graphics/vulkan/uniform_ring.hpp"
+
+namespace mellohi
+{
+    UniformRing::UniformRing(const std::shared_ptr<Device> device_ptr)
+        : m_device_ptr(device_ptr)
+    {
+        m_alignment = m_device_ptr->get_physical_device_properties().limits.minUniformBufferOffsetAlignment;
+        MH_ASSERT(FRAME_REGION_SIZE % m_alignment == 0, "Uniform buffer offset alignment of {} is not supported.",
+                  m_alignment);
+        
+        // Regions are indexed by frame rather than by frame in flight, which stays correct when the number of frames
+        // in flight changes. The padding keeps the range of an allocation at the end of the last region in the buffer.
+        const vk::BufferCreateInfo buffer_create_info
+        {
+            .size = Swapchain::MAX_FRAMES_IN_FLIGHT * FRAME_REGION_SIZE + MAX_UNIFORM_SIZE,
+            .usage = vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+            .sharingMode = vk::SharingMode::eExclusive,
+        };
+        
+        m_buffer = m_device_ptr->create_buffer(buffer_create_info, {
+            .usage = MemoryUsage::CpuToGpu,
+            .dedicated = true,
+        });
+        
+        MH_ASSERT(m_buffer.allocation.mapped_ptr, "Uniform buffer memory is not host visible.");
+        
+        create_descriptor_set();
+    }
+    
+    UniformRing::~UniformRing()
+    {
+        m_device_ptr->push_to_deletion_queue(m_descriptor_pool);
+        m_device_ptr->push_to_deletion_queue(m_descriptor_set_layout);
+        m_device_ptr->push_to_deletion_queue(m_buffer);
+    }
+    
+    u32 UniformRing::begin_frame()
+    {
+        m_region_offset = m_device_ptr->get_frame() % Swapchain::MAX_FRAMES_IN_FLIGHT * FRAME_REGION_SIZE;
+        m_head = 0;
+        
+        return static_cast<u32>(m_region_offset);
+    }
+    
+    UniformRingAllocation UniformRing::allocate(const vk::DeviceSize size)
+    {
+        const auto aligned_size = (size + m_alignment - 1) / m_alignment * m_alignment;
+        const auto offset = m_region_offset + m_head.fetch_add(aligned_size, std::memory_order_relaxed);
+        MH_ASSERT(offset + aligned_size <= m_region_offset + FRAME_REGION_SIZE,
+                  "Uniform ring is out of space for this frame.");
+        
+        return {
+            .offset = static_cast<u32>(offset),
+            .mapped_ptr = static_cast<std::byte *>(m_buffer.allocation.mapped_ptr) + offset,
+        };
+    }
+    
+    vk::Buffer UniformRing::get_buffer() const
+    {
+        return m_buffer.buffer;
+    }
+    
+    vk::DescriptorSetLayout UniformRing::get_descriptor_set_layout() const
+    {
+        return m_descriptor_set_layout;
+    }
+    
+    vk::DescriptorSet UniformRing::get_descriptor_set() const
+    {
+        return m_descriptor_set;
+    }
+    
+    void UniformRing::create_descriptor_set()
+    {
+        // Binding 0 holds per-frame data and binding 1 per-draw data.
+        std::array<vk::DescriptorSetLayoutBinding, 2> bindings;
+        std::array<vk::DescriptorBufferInfo, 2> buffer_infos;
+        std::array<vk::WriteDescriptorSet, 2> descriptor_writes;
+        
+        for (u32 binding = 0; binding < bindings.size(); ++binding)
+        {
+            bindings[binding] = vk::DescriptorSetLayoutBinding
+            {
+                .binding = binding,
+                .descriptorType = vk::DescriptorType::eUniformBufferDynamic,
+                .descriptorCount = 1,
+                .stageFlags = vk::ShaderStageFlagBits::eAll,
+            };
+            
+            buffer_infos[binding] = vk::DescriptorBufferInfo
+            {
+                .buffer = m_buffer.buffer,
+                .offset = 0,
+                .range = MAX_UNIFORM_SIZE,
+            };
+        }
+        
+        const vk::DescriptorSetLayoutCreateInfo descriptor_set_layout_create_info
+        {
+            .bindingCount = static_cast<u32>(bindings.size()),
+            .pBindings = bindings.data(),
+        };
+        m_descriptor_set_layout = m_device_ptr->create_descriptor_set_layout(descriptor_set_layout_create_info);
+        
+        const vk::DescriptorPoolSize pool_size
+        {
+            .type = vk::DescriptorType::eUniformBufferDynamic,
+            .descriptorCount = static_cast<u32>(bindings.size()),
+        };
+        
+        const vk::DescriptorPoolCreateInfo descriptor_pool_create_info
+        {
+            .maxSets = 1,
+            .poolSizeCount = 1,
+            .pPoolSizes = &pool_size,
+        };
+        m_descriptor_pool = m_device_ptr->create_descriptor_pool(descriptor_pool_create_info);
+        
+        const vk::DescriptorSetAllocateInfo descriptor_set_allocate_info
+        {
+            .descriptorPool = m_descriptor_pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &m_descriptor_set_layout,
+        };
+        m_descriptor_set = m_device_ptr->allocate_descriptor_sets(descriptor_set_allocate_info).front();
+        
+        for (u32 binding = 0; binding < descriptor_writes.size(); ++binding)
+        {
+            descriptor_writes[binding] = vk::WriteDescriptorSet
+            {
+                .dstSet = m_descriptor_set,
+                .dstBinding = binding,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = vk::DescriptorType::eUniformBufferDynamic,
+                .pBufferInfo = &buffer_infos[binding],
+            };
+        }
+        m_device_ptr->update_descriptor_sets(descriptor_writes);
+    }
+}
@@ -0,0 +1,353 @@
+#include "mellohi/graphics/vulkan/upload_scheduler.hpp"
+
+#include <cstring>
+#include <numeric>
+
+namespace mellohi
+{
+    // Staging alignment of buffer uploads. Image uploads compute theirs from the format.
+    static constexpr vk::DeviceSize BUFFER_STAGING_ALIGNMENT = 16;
+    
+    // Stages of the graphics queue that read uploaded resources.
+    static constexpr vk::PipelineStageFlags2 CONSUMER_STAGE_MASK = vk::PipelineStageFlagBits2::eVertexInput
+                                                                   | vk::PipelineStageFlagBits2::eVertexShader
+                                                                   | vk::PipelineStageFlagBits2::eFragmentShader
+                                                                   | vk::PipelineStageFlagBits2::eComputeShader;
+    
+    UploadScheduler::UploadScheduler(const std::shared_ptr<Device> device_ptr)
+        : m_device_ptr(device_ptr),
+          m_optimal_buffer_copy_offset_alignment(
+              device_ptr->get_physical_device_properties().limits.optimalBufferCopyOffsetAlignment),
+          m_staging_ring(device_ptr, STAGING_RING_SIZE)
+    {
+        create_command_pool();
+        m_timeline_semaphore = m_device_ptr->create_timeline_semaphore();
+    }
+    
+    UploadScheduler::~UploadScheduler()
+    {
+        m_device_ptr->wait_for_semaphore(m_timeline_semaphore, m_last_flushed_batch);
+        
+        m_device_ptr->destroy_semaphore(m_timeline_semaphore);
+        m_device_ptr->destroy_command_pool(m_command_pool);
+    }
+    
+    u64 UploadScheduler::upload_to_buffer(const Buffer &buffer, const std::span<const std::byte> data,
+                                          const vk::DeviceSize buffer_offset)
+    {
+        MH_ASSERT(buffer_offset + data.size() <= buffer.size, "Upload of {} bytes at offset {} overflows buffer.",
+                  data.size(), buffer_offset);
+        
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        
+        const auto staging_offset = allocate_staging(data.size(), BUFFER_STAGING_ALIGNMENT);
+        std::memcpy(m_staging_ring.get_mapped_ptr(staging_offset), data.data(), data.size());
+        
+        const auto command_buffer = begin_recording();
+        
+        const vk::BufferCopy buffer_copy
+        {
+            .srcOffset = staging_offset,
+            .dstOffset = buffer_offset,
+            .size = data.size(),
+        };
+        command_buffer.copyBuffer(m_staging_ring.get_buffer(), buffer.buffer, 1, &buffer_copy);
+        
+        const auto ownership_transfer = m_device_ptr->make_ownership_transfer(
+            QueueCapability::Transfer, QueueCapability::Graphics, vk::BufferMemoryBarrier2
+            {
+                .srcStageMask = vk::PipelineStageFlagBits2::eCopy,
+                .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+                .dstStageMask = CONSUMER_STAGE_MASK,
+                .dstAccessMask = vk::AccessFlagBits2::eMemoryRead,
+                .buffer = buffer.buffer,
+                .offset = buffer_offset,
+                .size = data.size(),
+            }
+        );
+        
+        // Without an ownership transfer the semaphore wait of the consuming submission is barrier enough.
+        if (ownership_transfer.acquire_opt.has_value())
+        {
+            command_buffer.pipelineBarrier2({
+                .bufferMemoryBarrierCount = 1,
+                .pBufferMemoryBarriers = &ownership_transfer.release,
+            });
+            
+            m_recording_buffer_acquires.push_back(ownership_transfer.acquire_opt.value());
+        }
+        
+        return m_batch;
+    }
+    
+    u64 UploadScheduler::upload_to_image(const Image &image, const std::span<const std::byte> data,
+                                         const vk::ImageLayout final_layout)
+    {
+        // The copy reads the whole first mip level, whose size in bytes the format's blocks decide.
+        const auto block_extent = vk::blockExtent(image.format);
+        const vk::DeviceSize image_size = vk::blockSize(image.format)
+                                          * ((image.extent.width + block_extent[0] - 1) / block_extent[0])
+                                          * ((image.extent.height + block_extent[1] - 1) / block_extent[1])
+                                          * ((image.extent.depth + block_extent[2] - 1) / block_extent[2]);
+        MH_ASSERT(data.size() == image_size, "Upload of {} bytes does not match the {} bytes of a {}x{}x{} {} image.",
+                  data.size(), image_size, image.extent.width, image.extent.height, image.extent.depth,
+                  vk::to_string(image.format));
+        
+        // Buffer to image copies need offsets that are a multiple of both the texel block size and 4. Blocks of
+        // three-component formats are not powers of two, so no single constant covers every format.
+        const vk::DeviceSize block_size = vk::blockSize(image.format);
+        const auto staging_alignment = std::lcm(std::lcm(block_size, vk::DeviceSize{4}),
+                                                m_optimal_buffer_copy_offset_alignment);
+        
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        
+        const auto staging_offset = allocate_staging(data.size(), staging_alignment);
+        std::memcpy(m_staging_ring.get_mapped_ptr(staging_offset), data.data(), data.size());
+        
+        const auto command_buffer = begin_recording();
+        
+        const vk::ImageSubresourceRange subresource_range
+        {
+            .aspectMask = vk::ImageAspectFlagBits::eColor,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        };
+        
+        // The whole image is overwritten, so its previous contents can be discarded.
+        const vk::ImageMemoryBarrier2 transfer_dst_barrier
+        {
+            .srcStageMask = vk::PipelineStageFlagBits2::eNone,
+            .srcAccessMask = vk::AccessFlagBits2::eNone,
+            .dstStageMask = vk::PipelineStageFlagBits2::eCopy,
+            .dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
+            .oldLayout = vk::ImageLayout::eUndefined,
+            .newLayout = vk::ImageLayout::eTransferDstOptimal,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image.image,
+            .subresourceRange = subresource_range,
+        };
+        
+        command_buffer.pipelineBarrier2({
+            .imageMemoryBarrierCount = 1,
+            .pImageMemoryBarriers = &transfer_dst_barrier,
+        });
+        
+        const vk::BufferImageCopy buffer_image_copy
+        {
+            .bufferOffset = staging_offset,
+            .bufferRowLength = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource = vk::ImageSubresourceLayers
+            {
+                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                .mipLevel = 0,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+            .imageOffset = {0, 0, 0},
+            .imageExtent = image.extent,
+        };
+        command_buffer.copyBufferToImage(m_staging_ring.get_buffer(), image.image,
+                                         vk::ImageLayout::eTransferDstOptimal, 1, &buffer_image_copy);
+        
+        // The layout transition is part of both halves of an ownership transfer, and is always recorded.
+        const auto ownership_transfer = m_device_ptr->make_ownership_transfer(
+            QueueCapability::Transfer, QueueCapability::Graphics, vk::ImageMemoryBarrier2
+            {
+                .srcStageMask = vk::PipelineStageFlagBits2::eCopy,
+                .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+                .dstStageMask = CONSUMER_STAGE_MASK,
+                .dstAccessMask = vk::AccessFlagBits2::eMemoryRead,
+                .oldLayout = vk::ImageLayout::eTransferDstOptimal,
+                .newLayout = final_layout,
+                .image = image.image,
+                .subresourceRange = subresource_range,
+            }
+        );
+        
+        command_buffer.pipelineBarrier2({
+            .imageMemoryBarrierCount = 1,
+            .pImageMemoryBarriers = &ownership_transfer.release,
+        });
+        
+        if (ownership_transfer.acquire_opt.has_value())
+        {
+            m_recording_image_acquires.push_back(ownership_transfer.acquire_opt.value());
+        }
+        
+        return m_batch;
+    }
+    
+    void UploadScheduler::flush()
+    {
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        flush_locked();
+    }
+    
+    std::optional<vk::SemaphoreSubmitInfo> UploadScheduler::record_acquire_barriers(
+        const vk::CommandBuffer command_buffer)
+    {
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        
+        if (m_last_acquired_batch == m_last_flushed_batch)
+        {
+            return std::nullopt;
+        }
+        
+        if (!m_pending_buffer_acquires.empty() || !m_pending_image_acquires.empty())
+        {
+            command_buffer.pipelineBarrier2({
+                .bufferMemoryBarrierCount = static_cast<u32>(m_pending_buffer_acquires.size()),
+                .pBufferMemoryBarriers = m_pending_buffer_acquires.data(),
+                .imageMemoryBarrierCount = static_cast<u32>(m_pending_image_acquires.size()),
+                .pImageMemoryBarriers = m_pending_image_acquires.data(),
+            });
+            
+            m_pending_buffer_acquires.clear();
+            m_pending_image_acquires.clear();
+        }
+        
+        m_last_acquired_batch = m_last_flushed_batch;
+        
+        return vk::SemaphoreSubmitInfo
+        {
+            .semaphore = m_timeline_semaphore,
+            .value = m_last_flushed_batch,
+            .stageMask = CONSUMER_STAGE_MASK,
+        };
+    }
+    
+    bool UploadScheduler::is_batch_complete(const u64 batch) const
+    {
+        return m_device_ptr->get_semaphore_counter_value(m_timeline_semaphore) >= batch;
+    }
+    
+    void UploadScheduler::wait_for_batch(const u64 batch)
+    {
+        {
+            const std::lock_guard<std::mutex> lock(m_mutex);
+            if (batch > m_last_flushed_batch)
+            {
+                flush_locked();
+            }
+        }
+        
+        m_device_ptr->wait_for_semaphore(m_timeline_semaphore, batch);
+    }
+    
+    void UploadScheduler::create_command_pool()
+    {
+        const vk::CommandPoolCreateInfo command_pool_create_info
+        {
+            .flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer | vk::CommandPoolCreateFlagBits::eTransient,
+            .queueFamilyIndex = m_device_ptr->get_queue_family_index(QueueCapability::Transfer),
+        };
+        
+        m_command_pool = m_device_ptr->create_command_pool(command_pool_create_info);
+    }
+    
+    // Waits for older batches to release their staging space when the ring is full, flushing the batch being recorded
+    // first if it is the one filling it.
+    vk::DeviceSize UploadScheduler::allocate_staging(const vk::DeviceSize size, const vk::DeviceSize alignment)
+    {
+        MH_ASSERT(size < m_staging_ring.get_size(), "Upload of {} bytes does not fit in the staging ring.", size);
+        
+        while (true)
+        {
+            const auto completed_batch_count = m_device_ptr->get_semaphore_counter_value(m_timeline_semaphore);
+            m_staging_ring.release_batches_before(completed_batch_count + 1);
+            
+            if (const auto offset_opt = m_staging_ring.allocate(size, alignment))
+            {
+                return offset_opt.value();
+            }
+            
+            if (!m_staging_ring.get_oldest_batch_opt().has_value())
+            {
+                flush_locked();
+            }
+            
+            m_device_ptr->wait_for_semaphore(m_timeline_semaphore, m_staging_ring.get_oldest_batch_opt().value());
+        }
+    }
+    
+    vk::CommandBuffer UploadScheduler::begin_recording()
+    {
+        if (m_recording_command_buffer)
+        {
+            return m_recording_command_buffer;
+        }
+        
+        const auto completed_batch_count = m_device_ptr->get_semaphore_counter_value(m_timeline_semaphore);
+        while (!m_submitted_batches.empty() && m_submitted_batches.front().batch <= completed_batch_count)
+        {
+            m_free_command_buffers.push_back(m_submitted_batches.front().command_buffer);
+            m_submitted_batches.pop_front();
+        }
+        
+        if (m_free_command_buffers.empty())
+        {
+            const vk::CommandBufferAllocateInfo command_buffer_allocate_info
+            {
+                .commandPool = m_command_pool,
+                .level = vk::CommandBufferLevel::ePrimary,
+                .commandBufferCount = 1,
+            };
+            
+            m_free_command_buffers = m_device_ptr->allocate_command_buffers(command_buffer_allocate_info);
+        }
+        
+        m_recording_command_buffer = m_free_command_buffers.back();
+        m_free_command_buffers.pop_back();
+        
+        m_recording_command_buffer.reset();
+        
+        const vk::CommandBufferBeginInfo command_buffer_begin_info
+        {
+            .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+        };
+        
+        const auto result = m_recording_command_buffer.begin(command_buffer_begin_info);
+        MH_ASSERT_VK(result, "Failed to begin recording Vulkan upload command buffer.");
+        
+        return m_recording_command_buffer;
+    }
+    
+    void UploadScheduler::flush_locked()
+    {
+        if (!m_recording_command_buffer)
+        {
+            return;
+        }
+        
+        const auto result = m_recording_command_buffer.end();
+        MH_ASSERT_VK(result, "Failed to end recording Vulkan upload command buffer.");
+        
+        const vk::SemaphoreSubmitInfo signal_semaphore_info
+        {
+            .semaphore = m_timeline_semaphore,
+            .value = m_batch,
+            .stageMask = vk::PipelineStageFlagBits2::eAllCommands,
+        };
+        
+        m_device_ptr->submit(QueueCapability::Transfer, {&m_recording_command_buffer, 1}, {},
+                             {&signal_semaphore_info, 1});
+        
+        m_staging_ring.close_batch(m_batch);
+        m_submitted_batches.push_back({ .batch = m_batch, .command_buffer = m_recording_command_buffer });
+        
+        m_pending_buffer_acquires.insert(m_pending_buffer_acquires.end(), m_recording_buffer_acquires.begin(),
+                                         m_recording_buffer_acquires.end());
+        m_pending_image_acquires.insert(m_pending_image_acquires.end(), m_recording_image_acquires.begin(),
+                                        m_recording_image_acquires.end());
+        m_recording_buffer_acquires.clear();
+        m_recording_image_acquires.clear();
+        
+        m_last_flushed_batch = m_batch;
+        ++m_batch;
+        m_recording_command_buffer = nullptr;
+    }
+}
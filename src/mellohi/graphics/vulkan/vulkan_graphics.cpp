@@ -1,36 +1,213 @@
 #include "mellohi/graphics/vulkan/vulkan_graphics.hpp"
 
+#include "mellohi/graphics/vulkan/shader_cache.hpp"
+
 namespace mellohi
 {
+    // Matches FrameUniforms in the shaders.
+    struct FrameUniforms
+    {
+        fmat4x4 view_projection;
+        f32 time;
+    };
+    
     VulkanGraphics::VulkanGraphics(const std::shared_ptr<AssetManager> asset_manager_ptr,
                                    const std::shared_ptr<Platform> platform_ptr)
-        : m_asset_manager_ptr(asset_manager_ptr)
+        : m_asset_manager_ptr(asset_manager_ptr), m_start_time(std::chrono::steady_clock::now())
     {
         const auto engine_config_ptr = asset_manager_ptr->load<EngineConfigAsset>(AssetId(":engine.toml"));
         
         m_device_ptr = std::make_shared<Device>(*engine_config_ptr, *platform_ptr);
         m_swapchain_ptr = std::make_shared<Swapchain>(engine_config_ptr, platform_ptr, m_device_ptr);
-        m_render_pass_ptr = std::make_shared<RenderPass>(engine_config_ptr, m_device_ptr, m_swapchain_ptr);
+        m_upload_scheduler_ptr = std::make_shared<UploadScheduler>(m_device_ptr);
+        m_graphics_pipeline_cache_ptr = std::make_shared<GraphicsPipelineCache>(m_device_ptr);
+        m_bindless_descriptors_ptr = std::make_shared<BindlessDescriptors>(m_device_ptr);
+        m_render_pass_ptr = std::make_shared<RenderPass>(engine_config_ptr, m_device_ptr, m_swapchain_ptr,
+                                                         m_upload_scheduler_ptr, m_bindless_descriptors_ptr,
+                                                         m_graphics_pipeline_cache_ptr);
+        m_draw_queue_ptr = std::make_unique<DrawQueue>(m_render_pass_ptr);
+        
+        // The shaders of the materials and culling below are compiled up front in parallel, so that loading them hits
+        // the cache.
+        ShaderCache::get().prewarm(*asset_manager_ptr, {
+            AssetId("sandbox:shaders/triangle.vert"),
+            AssetId("sandbox:shaders/triangle.frag"),
+            AssetId("sandbox:shaders/chunks.vert"),
+            AssetId("mellohi:shaders/cull_chunks.comp"),
+        });
         
         m_triangle_material_ptr = asset_manager_ptr->load<VulkanMaterial>(
-            AssetId("sandbox:materials/triangle.toml"), m_device_ptr, m_render_pass_ptr
+            AssetId("sandbox:materials/triangle.toml"), m_device_ptr, m_render_pass_ptr, m_graphics_pipeline_cache_ptr
         );
+        
+        if (m_device_ptr->supports_draw_indirect_count())
+        {
+            create_chunks();
+        }
+        else
+        {
+            MH_WARN("Device does not support indirect draw counts, so chunks are not drawn.");
+        }
+        
+        create_render_graph();
     }
     
     VulkanGraphics::~VulkanGraphics()
     {
+        if (m_indirect_renderer_ptr)
+        {
+            m_device_ptr->push_to_deletion_queue(m_chunk_index_buffer);
+        }
+        
+        const auto &shader_cache = ShaderCache::get();
+        MH_INFO("Shader cache hits: {}, misses: {}.", shader_cache.get_hit_count(), shader_cache.get_miss_count());
+        MH_INFO("Graphics pipeline cache hits: {}, misses: {}.", m_graphics_pipeline_cache_ptr->get_hit_count(),
+                m_graphics_pipeline_cache_ptr->get_miss_count());
         
+        m_device_ptr->get_memory_allocator().log_heap_budgets();
     }
     
     void VulkanGraphics::draw_frame()
     {
         if (m_render_pass_ptr->begin())
         {
-            m_triangle_material_ptr->bind();
-            m_render_pass_ptr->draw(3, 1, 0, 0);
+            m_render_pass_ptr->set_frame_uniforms(FrameUniforms
+            {
+                .view_projection = get_view_projection(),
+                .time = get_time(),
+            });
             
+            m_render_graph_ptr->execute();
             m_render_pass_ptr->end();
-            m_device_ptr->flush_deletion_queue();
         }
     }
+    
+    void VulkanGraphics::create_chunks()
+    {
+        m_indirect_renderer_ptr = std::make_unique<IndirectRenderer>(m_asset_manager_ptr, m_device_ptr,
+                                                                     m_render_pass_ptr, m_upload_scheduler_ptr,
+                                                                     m_bindless_descriptors_ptr);
+        
+        m_chunk_material_ptr = m_asset_manager_ptr->load<VulkanMaterial>(
+            AssetId("sandbox:materials/chunks.toml"), m_device_ptr, m_render_pass_ptr, m_graphics_pipeline_cache_ptr
+        );
+        
+        // Every chunk is a quad, built by the vertex shader from its indices.
+        static constexpr std::array<u32, 6> QUAD_INDICES = {0, 1, 2, 2, 1, 3};
+        
+        const vk::BufferCreateInfo buffer_create_info
+        {
+            .size = sizeof(QUAD_INDICES),
+            .usage = vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst,
+            .sharingMode = vk::SharingMode::eExclusive,
+        };
+        m_chunk_index_buffer = m_device_ptr->create_buffer(buffer_create_info, { .usage = MemoryUsage::GpuOnly });
+        m_upload_scheduler_ptr->upload_to_buffer(m_chunk_index_buffer, std::as_bytes(std::span(QUAD_INDICES)));
+        
+        // A grid much larger than the view, so that most chunks are culled.
+        static constexpr u32 GRID_SIZE = 128;
+        static constexpr f32 GRID_EXTENT = 8.0f;
+        static constexpr f32 CHUNK_SIZE = GRID_EXTENT / GRID_SIZE;
+        
+        std::vector<ChunkDraw> chunks;
+        chunks.reserve(GRID_SIZE * GRID_SIZE);
+        for (u32 y = 0; y < GRID_SIZE; ++y)
+        {
+            for (u32 x = 0; x < GRID_SIZE; ++x)
+            {
+                const auto position = (fvec2(x, y) + 0.5f) * CHUNK_SIZE - 0.5f * GRID_EXTENT;
+                
+                chunks.push_back({
+                    .center = fvec3(position, 0.0f),
+                    .radius = 0.5f * CHUNK_SIZE,
+                    .index_count = static_cast<u32>(QUAD_INDICES.size()),
+                    .first_index = 0,
+                    .vertex_offset = 0,
+                    .user_index = static_cast<u32>(chunks.size()),
+                });
+            }
+        }
+        
+        m_indirect_renderer_ptr->set_chunks(chunks);
+    }
+    
+    void VulkanGraphics::create_render_graph()
+    {
+        m_render_graph_ptr = std::make_unique<RenderGraph>(m_device_ptr, m_swapchain_ptr, m_render_pass_ptr);
+        m_render_graph_ptr->import_swapchain_image("swapchain");
+        
+        if (m_indirect_renderer_ptr)
+        {
+            // Writes the indirect commands that the chunks pass draws, which the graph does not track.
+            m_render_graph_ptr->add_pass("cull_chunks",
+                [](RenderGraphPassBuilder &builder)
+                {
+                    builder.set_side_effects();
+                },
+                [this](const vk::CommandBuffer command_buffer)
+                {
+                    m_indirect_renderer_ptr->cull(command_buffer, get_view_projection());
+                });
+            
+            m_render_graph_ptr->add_pass("chunks",
+                [](RenderGraphPassBuilder &builder)
+                {
+                    builder.write_color_attachment("swapchain", vk::AttachmentLoadOp::eClear);
+                },
+                [this](const vk::CommandBuffer command_buffer)
+                {
+                    m_chunk_material_ptr->update_graphics_pipeline();
+                    m_render_pass_ptr->bind_graphics_pipeline(
+                        m_chunk_material_ptr->get_graphics_pipeline().get_pipeline()
+                    );
+                    m_render_pass_ptr->push_constants(command_buffer,
+                                                      m_indirect_renderer_ptr->get_chunk_buffer_handle().index);
+                    m_indirect_renderer_ptr->draw(command_buffer, m_chunk_index_buffer.buffer);
+                });
+        }
+        
+        // Drawn over the chunks, if there are any.
+        const auto triangle_load_op = m_indirect_renderer_ptr ? vk::AttachmentLoadOp::eLoad
+                                                              : vk::AttachmentLoadOp::eClear;
+        
+        m_render_graph_ptr->add_pass("triangle",
+            [triangle_load_op](RenderGraphPassBuilder &builder)
+            {
+                builder.write_color_attachment("swapchain", triangle_load_op);
+            },
+            [this](const vk::CommandBuffer command_buffer)
+            {
+                // A row of triangles, which the draw queue merges into one instanced draw.
+                const auto time = get_time();
+                for (i32 i = -1; i <= 1; ++i)
+                {
+                    auto model = glm::translate(fmat4x4(1.0f), fvec3(0.6f * static_cast<f32>(i), 0.0f, 0.0f));
+                    model = glm::rotate(model, time, fvec3(0.0f, 0.0f, 1.0f));
+                    model = glm::scale(model, fvec3(0.5f));
+                    
+                    m_draw_queue_ptr->submit({
+                        .material_ptr = m_triangle_material_ptr.get(),
+                        .vertex_count = 3,
+                    }, model);
+                }
+                
+                m_draw_queue_ptr->record(command_buffer);
+            });
+        
+        m_render_graph_ptr->compile();
+    }
+    
+    fmat4x4 VulkanGraphics::get_view_projection() const
+    {
+        // Keeps the aspect ratio of what is drawn independent of the window's.
+        const auto extent = m_swapchain_ptr->get_extent();
+        const auto aspect_ratio = static_cast<f32>(extent.width) / static_cast<f32>(extent.height);
+        
+        return glm::ortho(-aspect_ratio, aspect_ratio, -1.0f, 1.0f);
+    }
+    
+    f32 VulkanGraphics::get_time() const
+    {
+        return std::chrono::duration<f32>(std::chrono::steady_clock::now() - m_start_time).count();
+    }
 }
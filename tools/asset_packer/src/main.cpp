@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <print>
+#include <string>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+
+#include <mellohi/core/assets/asset_archive.hpp>
+#include <mellohi/core/assets/asset_id.hpp>
+
+using namespace mellohi;
+
+struct PackedFile
+{
+    u64 hash;
+    std::string fully_qualified_path;
+    std::filesystem::path file_path;
+    u64 size;
+};
+
+// Must match VirtualFileSystem::to_fully_qualified_path.
+static std::string to_fully_qualified_path(const std::filesystem::path &root_dir, const std::filesystem::path &file_path)
+{
+    const auto relative_path = file_path.lexically_relative(root_dir);
+    
+    const auto first_it = relative_path.begin();
+    if (std::next(first_it) == relative_path.end())
+    {
+        return ":" + relative_path.generic_string();
+    }
+    
+    std::filesystem::path path_in_package;
+    for (auto it = std::next(first_it); it != relative_path.end(); ++it)
+    {
+        path_in_package /= *it;
+    }
+    
+    return first_it->string() + ":" + path_in_package.generic_string();
+}
+
+static u64 align_up(const u64 value, const u64 alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+int main(const int argc, const char **argv)
+{
+    if (argc < 3)
+    {
+        std::println(stderr, "Usage: {} <output archive> <assets dir>...", argv[0]);
+        std::println(stderr, "Earlier asset directories override files with the same path in later ones.");
+        return 1;
+    }
+    
+    const std::filesystem::path output_path = argv[1];
+    
+    std::vector<PackedFile> files;
+    std::unordered_set<std::string> packed_paths;
+    for (auto i = 2; i < argc; ++i)
+    {
+        const std::filesystem::path root_dir = argv[i];
+        
+        std::error_code error_code;
+        for (const auto &entry : std::filesystem::recursive_directory_iterator(root_dir, error_code))
+        {
+            if (!entry.is_regular_file())
+            {
+                continue;
+            }
+            
+            auto fully_qualified_path = to_fully_qualified_path(root_dir, entry.path());
+            if (!packed_paths.insert(fully_qualified_path).second)
+            {
+                continue;
+            }
+            
+            files.push_back(PackedFile
+            {
+                .hash = AssetId::hash_fully_qualified_path(fully_qualified_path),
+                .fully_qualified_path = std::move(fully_qualified_path),
+                .file_path = entry.path(),
+                .size = entry.file_size(),
+            });
+        }
+        
+        if (error_code)
+        {
+            std::println(stderr, "Failed to read assets dir {}: {}", root_dir.string(), error_code.message());
+            return 1;
+        }
+    }
+    
+    std::ranges::sort(files, {}, [](const PackedFile &file)
+    {
+        return std::tie(file.hash, file.fully_qualified_path);
+    });
+    
+    const ArchiveHeader header
+    {
+        .magic = ARCHIVE_MAGIC,
+        .version = ARCHIVE_VERSION,
+        .entry_count = files.size(),
+        .toc_offset = align_up(sizeof(ArchiveHeader), alignof(ArchiveTocEntry)),
+    };
+    
+    std::vector<ArchiveTocEntry> toc;
+    toc.reserve(files.size());
+    
+    u64 offset = header.toc_offset + files.size() * sizeof(ArchiveTocEntry);
+    for (const auto &file : files)
+    {
+        toc.push_back(ArchiveTocEntry
+        {
+            .hash = file.hash,
+            .path_offset = offset,
+            .path_size = file.fully_qualified_path.size(),
+        });
+        offset += file.fully_qualified_path.size();
+    }
+    
+    for (usize i = 0; i < files.size(); ++i)
+    {
+        offset = align_up(offset, ARCHIVE_BLOB_ALIGNMENT);
+        toc[i].data_offset = offset;
+        toc[i].data_size = files[i].size;
+        offset += files[i].size;
+    }
+    
+    std::ofstream ofs(output_path, std::ios::binary | std::ios::trunc);
+    if (!ofs)
+    {
+        std::println(stderr, "Failed to open {} for writing.", output_path.string());
+        return 1;
+    }
+    
+    const auto write_padding_to = [&ofs](const u64 target_offset)
+    {
+        while (static_cast<u64>(ofs.tellp()) < target_offset)
+        {
+            ofs.put('\0');
+        }
+    };
+    
+    ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    write_padding_to(header.toc_offset);
+    ofs.write(reinterpret_cast<const char *>(toc.data()), toc.size() * sizeof(ArchiveTocEntry));
+    
+    for (const auto &file : files)
+    {
+        ofs.write(file.fully_qualified_path.data(), file.fully_qualified_path.size());
+    }
+    
+    for (usize i = 0; i < files.size(); ++i)
+    {
+        write_padding_to(toc[i].data_offset);
+        
+        // Inserting an empty stream buffer would set the failbit on the output.
+        if (files[i].size > 0)
+        {
+            std::ifstream ifs(files[i].file_path, std::ios::binary);
+            ofs << ifs.rdbuf();
+        }
+        
+        if (static_cast<u64>(ofs.tellp()) != toc[i].data_offset + toc[i].data_size)
+        {
+            std::println(stderr, "{} changed while it was being packed.", files[i].file_path.string());
+            return 1;
+        }
+    }
+    
+    std::println("Packed {} files into {}.", files.size(), output_path.string());
+    return 0;
+}